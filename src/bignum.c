@@ -0,0 +1,345 @@
+/** @file
+ * Implementacja dużych współczynników trybu dokładnego
+ *
+ * @author Filip Głębocki <fg429202@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2021
+ */
+
+#include "bignum.h"
+#include "coeff.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <threads.h>
+
+/** To jest liczba 32-bitowych cyfr modułu współczynnika typu poly_coeff_t. */
+#define COEFF_LIMBS ((POLY_COEFF_BITS + 31) / 32)
+
+/**
+ * To jest liczba kawałków puli. Kawałek @f$i@f$ mieści @f$2^i@f$ liczb,
+ * więc indeksy puli nie przekraczają zakresu uchwytów ani typu size_t.
+ */
+#define BIG_CHUNKS (POLY_COEFF_BITS - 2 < 62 ? POLY_COEFF_BITS - 2 : 62)
+
+/** To jest początkowy rozmiar tablicy haszującej puli. */
+#define BIG_INITIAL_TABLE 64
+
+/** To jest podstawa, przy której cyfry dziesiętne są wypisywane grupami. */
+#define BIG_DECIMAL_BASE 1000000000
+
+/**
+ * To jest struktura przechowująca liczbę dowolnej precyzji. Moduł jest
+ * zapisany w systemie o podstawie @f$2^{32}@f$, od najmniej znaczącej
+ * cyfry, bez zer wiodących.
+ */
+typedef struct BigNum {
+  size_t hash; ///< skrót liczby, wyliczany przy dodaniu do puli
+  size_t length; ///< liczba cyfr modułu
+  bool negative; ///< czy liczba jest ujemna
+  uint32_t limbs[]; ///< cyfry modułu
+} BigNum;
+
+/**
+ * To jest struktura opisująca argument działania: liczbę z puli albo mały
+ * współczynnik rozpisany na cyfry w tablicy @p small.
+ */
+typedef struct BigView {
+  const uint32_t *limbs; ///< cyfry modułu
+  size_t length; ///< liczba cyfr modułu
+  bool negative; ///< czy liczba jest ujemna
+  uint32_t small[COEFF_LIMBS]; ///< cyfry modułu liczby spoza puli
+} BigView;
+
+/** To są kawałki puli; kawałki nie są przenoszone, gdy pula rośnie. */
+static BigNum **bigChunks[BIG_CHUNKS];
+/** To jest liczba liczb w puli. */
+static size_t bigCount = 0;
+/** To jest tablica haszująca indeksów puli powiększonych o 1; 0 to puste pole. */
+static size_t *bigTable = NULL;
+/** To jest rozmiar tablicy haszującej, potęga dwójki. */
+static size_t bigTableSize = 0;
+/** To jest zamek puli, bo liczby mogą tworzyć wątki funkcji PolyMulMany. */
+static mtx_t bigLock;
+/** To jest znacznik jednokrotnej inicjalizacji zamka puli. */
+static once_flag bigLockOnce = ONCE_FLAG_INIT;
+
+/** Inicjalizuje zamek puli. */
+static void BigLockInit(void) {
+  mtx_init(&bigLock, mtx_plain);
+}
+
+/**
+ * Daje liczbę z puli. Liczby nie są zmieniane po dodaniu do puli,
+ * więc odczyt nie wymaga zamka.
+ * @param[in] index : indeks liczby
+ * @return liczba
+ */
+static const BigNum *BigGet(size_t index) {
+  unsigned chunk = 63 - __builtin_clzll((unsigned long long) index + 1);
+  return bigChunks[chunk][index + 1 - ((size_t) 1 << chunk)];
+}
+
+/**
+ * Rozpisuje współczynnik na cyfry.
+ * @param[out] v : argument działania
+ * @param[in] a : współczynnik
+ * @param[in] handle : czy @p a jest uchwytem liczby z puli
+ */
+static void BigViewInit(BigView *v, poly_coeff_t a, bool handle) {
+  if (handle) {
+    const BigNum *n = BigGet((size_t) (a - POLY_COEFF_MIN));
+    *v = (BigView) {.limbs = n->limbs, .length = n->length,
+                    .negative = n->negative};
+    return;
+  }
+
+  coeff_acc_t magnitude = a < 0 ? (coeff_acc_t) 0 - (coeff_acc_t) a
+                                : (coeff_acc_t) a;
+  v->negative = a < 0;
+  v->length = 0;
+  while (magnitude != 0) {
+    v->small[v->length++] = (uint32_t) magnitude;
+    magnitude >>= 32;
+  }
+  v->limbs = v->small;
+}
+
+/**
+ * Alokuje liczbę o zadanej liczbie cyfr.
+ * @param[in] length : liczba cyfr
+ * @return liczba o nieokreślonych cyfrach
+ */
+static BigNum *BigAlloc(size_t length) {
+  BigNum *n = malloc(sizeof(BigNum) + length * sizeof(uint32_t));
+  CHECK_PTR(n);
+  n->length = length;
+  return n;
+}
+
+/**
+ * Porównuje moduły dwóch liczb.
+ * @param[in] a : liczba
+ * @param[in] b : liczba
+ * @return liczba ujemna, zero albo dodatnia, gdy @f$|a|@f$ jest
+ * odpowiednio mniejszy, równy albo większy od @f$|b|@f$
+ */
+static int BigCompare(const BigView *a, const BigView *b) {
+  if (a->length != b->length)
+    return a->length < b->length ? -1 : 1;
+  for (size_t i = a->length; i-- > 0;)
+    if (a->limbs[i] != b->limbs[i])
+      return a->limbs[i] < b->limbs[i] ? -1 : 1;
+  return 0;
+}
+
+/**
+ * Liczy skrót liczby.
+ * @param[in] n : liczba
+ * @return skrót
+ */
+static size_t BigHash(const BigNum *n) {
+  uint64_t hash = 14695981039346656037ULL ^ n->negative;
+  for (size_t i = 0; i < n->length; i++)
+    hash = (hash ^ n->limbs[i]) * 1099511628211ULL;
+  return (size_t) hash;
+}
+
+/**
+ * Przenosi tablicę haszującą puli do tablicy dwa razy większej.
+ * Wywoływana z zamkniętym zamkiem puli.
+ */
+static void BigRehash(void) {
+  size_t size = bigTableSize == 0 ? BIG_INITIAL_TABLE : 2 * bigTableSize;
+  size_t *table = calloc(size, sizeof(size_t));
+  CHECK_PTR(table);
+  for (size_t i = 0; i < bigCount; i++) {
+    size_t slot = BigGet(i)->hash & (size - 1);
+    while (table[slot] != 0)
+      slot = (slot + 1) & (size - 1);
+    table[slot] = i + 1;
+  }
+  free(bigTable);
+  bigTable = table;
+  bigTableSize = size;
+}
+
+/**
+ * Daje uchwyt liczby, dodając ją do puli, jeśli jeszcze jej tam nie ma.
+ * Przejmuje na własność liczbę @p n.
+ * @param[in] n : liczba, która nie jest małym współczynnikiem
+ * @return uchwyt liczby
+ */
+static poly_coeff_t BigIntern(BigNum *n) {
+  n->hash = BigHash(n);
+  call_once(&bigLockOnce, BigLockInit);
+  mtx_lock(&bigLock);
+
+  if (2 * (bigCount + 1) > bigTableSize)
+    BigRehash();
+  size_t slot = n->hash & (bigTableSize - 1);
+  while (bigTable[slot] != 0) {
+    size_t index = bigTable[slot] - 1;
+    const BigNum *m = BigGet(index);
+    if (m->hash == n->hash && m->length == n->length &&
+        m->negative == n->negative &&
+        memcmp(m->limbs, n->limbs, n->length * sizeof(uint32_t)) == 0) {
+      mtx_unlock(&bigLock);
+      free(n);
+      return POLY_COEFF_MIN + (poly_coeff_t) index;
+    }
+    slot = (slot + 1) & (bigTableSize - 1);
+  }
+
+  size_t index = bigCount;
+  unsigned chunk = 63 - __builtin_clzll((unsigned long long) index + 1);
+  if (chunk >= BIG_CHUNKS) {
+    fprintf(stderr, "too many big coefficients\n");
+    exit(1);
+  }
+  if (bigChunks[chunk] == NULL) {
+    bigChunks[chunk] = malloc(((size_t) 1 << chunk) * sizeof(BigNum *));
+    CHECK_PTR(bigChunks[chunk]);
+  }
+  bigChunks[chunk][index + 1 - ((size_t) 1 << chunk)] = n;
+  bigTable[slot] = index + 1;
+  bigCount++;
+
+  mtx_unlock(&bigLock);
+  return POLY_COEFF_MIN + (poly_coeff_t) index;
+}
+
+/**
+ * Zamienia wynik działania na współczynnik: mały, jeśli się mieści,
+ * a w przeciwnym razie na uchwyt. Przejmuje na własność liczbę @p n.
+ * @param[in] n : liczba, być może z zerami wiodącymi
+ * @return współczynnik
+ */
+static poly_coeff_t BigFinish(BigNum *n) {
+  while (n->length > 0 && n->limbs[n->length - 1] == 0)
+    n->length--;
+
+  if (n->length <= COEFF_LIMBS) {
+    coeff_acc_t magnitude = 0;
+    for (size_t i = n->length; i-- > 0;)
+      magnitude = (magnitude << 32) | n->limbs[i];
+    if (magnitude < (coeff_acc_t) COEFF_SMALL_LIMIT) {
+      poly_coeff_t value = (poly_coeff_t) magnitude;
+      bool negative = n->negative;
+      free(n);
+      return negative ? -value : value;
+    }
+  }
+
+  return BigIntern(n);
+}
+
+poly_coeff_t CoeffBigAdd(poly_coeff_t a, poly_coeff_t b) {
+  BigView x, y;
+  BigViewInit(&x, a, CoeffIsBig(a));
+  BigViewInit(&y, b, CoeffIsBig(b));
+
+  /* Dla równych znaków dodajemy krótszy moduł do dłuższego, a dla różnych
+   * odejmujemy mniejszy moduł od większego. */
+  int order = x.negative == y.negative ? (x.length >= y.length ? 1 : -1)
+                                       : BigCompare(&x, &y);
+  if (order == 0)
+    return 0;
+  const BigView *large = order > 0 ? &x : &y;
+  const BigView *small = order > 0 ? &y : &x;
+
+  BigNum *n = BigAlloc(large->length + 1);
+  n->negative = large->negative;
+  int64_t carry = 0;
+  for (size_t i = 0; i < large->length; i++) {
+    int64_t term = i < small->length ? small->limbs[i] : 0;
+    carry += large->limbs[i] + (x.negative == y.negative ? term : -term);
+    n->limbs[i] = (uint32_t) carry;
+    carry = carry < 0 ? -1 : carry >> 32;
+  }
+  n->limbs[large->length] = (uint32_t) carry;
+  return BigFinish(n);
+}
+
+poly_coeff_t CoeffBigMul(poly_coeff_t a, poly_coeff_t b) {
+  BigView x, y;
+  BigViewInit(&x, a, CoeffIsBig(a));
+  BigViewInit(&y, b, CoeffIsBig(b));
+  if (x.length == 0 || y.length == 0)
+    return 0;
+
+  BigNum *n = BigAlloc(x.length + y.length);
+  n->negative = x.negative != y.negative;
+  memset(n->limbs, 0, n->length * sizeof(uint32_t));
+  for (size_t i = 0; i < x.length; i++) {
+    uint64_t carry = 0;
+    for (size_t j = 0; j < y.length; j++) {
+      carry += (uint64_t) x.limbs[i] * y.limbs[j] + n->limbs[i + j];
+      n->limbs[i + j] = (uint32_t) carry;
+      carry >>= 32;
+    }
+    n->limbs[i + y.length] = (uint32_t) carry;
+  }
+  return BigFinish(n);
+}
+
+poly_coeff_t CoeffBigBox(poly_coeff_t a) {
+  BigView x;
+  BigViewInit(&x, a, false);
+  BigNum *n = BigAlloc(x.length);
+  n->negative = x.negative;
+  memcpy(n->limbs, x.limbs, x.length * sizeof(uint32_t));
+  return BigFinish(n);
+}
+
+bool PolyCoeffIsBig(poly_coeff_t c) {
+  return CoeffCurrentRing().exact && CoeffIsBig(c);
+}
+
+char *PolyCoeffToString(poly_coeff_t c) {
+  BigView v;
+  BigViewInit(&v, c, PolyCoeffIsBig(c));
+
+  /* Dzielimy kopię modułu przez 10^9, zbierając grupy po 9 cyfr
+   * od najmniej znaczącej. Każde dzielenie skraca moduł o ponad 29 bitów. */
+  uint32_t *limbs = malloc((v.length + 1) * sizeof(uint32_t));
+  uint32_t *groups = malloc((2 * v.length + 1) * sizeof(uint32_t));
+  CHECK_PTR(limbs);
+  CHECK_PTR(groups);
+  memcpy(limbs, v.limbs, v.length * sizeof(uint32_t));
+  size_t length = v.length, count = 0;
+  do {
+    uint64_t rest = 0;
+    for (size_t i = length; i-- > 0;) {
+      rest = (rest << 32) | limbs[i];
+      limbs[i] = (uint32_t) (rest / BIG_DECIMAL_BASE);
+      rest %= BIG_DECIMAL_BASE;
+    }
+    groups[count++] = (uint32_t) rest;
+    while (length > 0 && limbs[length - 1] == 0)
+      length--;
+  } while (length > 0);
+
+  char *str = malloc(9 * count + 2);
+  CHECK_PTR(str);
+  int pos = sprintf(str, "%s%u", v.negative ? "-" : "", groups[count - 1]);
+  for (size_t i = count - 1; i-- > 0;)
+    pos += sprintf(str + pos, "%09u", groups[i]);
+
+  free(limbs);
+  free(groups);
+  return str;
+}
+
+void PolyBigRelease(void) {
+  for (size_t i = 0; i < bigCount; i++)
+    free((BigNum *) BigGet(i));
+  for (size_t i = 0; i < BIG_CHUNKS; i++) {
+    free(bigChunks[i]);
+    bigChunks[i] = NULL;
+  }
+  free(bigTable);
+  bigTable = NULL;
+  bigTableSize = 0;
+  bigCount = 0;
+}
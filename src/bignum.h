@@ -0,0 +1,79 @@
+/** @file
+ * Interfejs dużych współczynników trybu dokładnego
+ *
+ * W trybie dokładnym (patrz PolySetExact) współczynnik, którego moduł
+ * jest mniejszy niż COEFF_SMALL_LIMIT, jest przechowywany bezpośrednio
+ * w polu coeff i działania na nim są zwykłymi działaniami na liczbach
+ * maszynowych. Wynik spoza tego zakresu trafia do puli liczb dowolnej
+ * precyzji, a w polu coeff zapisywany jest uchwyt POLY_COEFF_MIN + i,
+ * gdzie i jest indeksem liczby w puli. Uchwyty leżą poniżej zakresu
+ * małych współczynników, więc jedno porównanie odróżnia oba rodzaje.
+ *
+ * Pula przechowuje każdą wartość co najwyżej raz, więc równe
+ * współczynniki mają równe uchwyty, a porównanie współczynników dalej
+ * jest porównaniem liczb. Liczby w puli nie są zmieniane ani
+ * przenoszone, więc kopiowanie i usuwanie wielomianów nie musi zliczać
+ * odwołań do nich; całą pulę zwalnia funkcja PolyBigRelease.
+ *
+ * @author Filip Głębocki <fg429202@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2021
+ */
+
+#ifndef __BIGNUM_H__
+#define __BIGNUM_H__
+
+#include "poly.h"
+
+/**
+ * To jest granica małych współczynników trybu dokładnego,
+ * @f$2^{k-2}@f$ dla @f$k@f$-bitowego typu poly_coeff_t. Suma dwóch małych
+ * współczynników mieści się w typie poly_coeff_t.
+ */
+#define COEFF_SMALL_LIMIT ((poly_coeff_t) 1 << (POLY_COEFF_BITS - 2))
+
+/**
+ * Sprawdza, czy współczynnik trybu dokładnego jest mały.
+ * @param[in] a : współczynnik
+ * @return czy @f$|a| <@f$ COEFF_SMALL_LIMIT
+ */
+static inline bool CoeffIsSmall(poly_coeff_t a) {
+  return a > -COEFF_SMALL_LIMIT && a < COEFF_SMALL_LIMIT;
+}
+
+/**
+ * Sprawdza, czy współczynnik trybu dokładnego jest uchwytem liczby z puli.
+ * @param[in] a : współczynnik
+ * @return czy @p a jest uchwytem
+ */
+static inline bool CoeffIsBig(poly_coeff_t a) {
+  return a < POLY_COEFF_MIN + COEFF_SMALL_LIMIT;
+}
+
+/**
+ * Dodaje dwa współczynniki trybu dokładnego, z których co najmniej
+ * jeden jest uchwytem albo których suma nie jest mała.
+ * @param[in] a : współczynnik
+ * @param[in] b : współczynnik
+ * @return @f$a + b@f$, mały współczynnik albo uchwyt
+ */
+poly_coeff_t CoeffBigAdd(poly_coeff_t a, poly_coeff_t b);
+
+/**
+ * Mnoży dwa współczynniki trybu dokładnego, z których co najmniej
+ * jeden jest uchwytem albo których iloczyn nie jest mały.
+ * @param[in] a : współczynnik
+ * @param[in] b : współczynnik
+ * @return @f$a \cdot b@f$, mały współczynnik albo uchwyt
+ */
+poly_coeff_t CoeffBigMul(poly_coeff_t a, poly_coeff_t b);
+
+/**
+ * Zamienia liczbę całkowitą, która nie jest małym współczynnikiem,
+ * na uchwyt liczby z puli.
+ * @param[in] a : liczba całkowita
+ * @return uchwyt liczby @p a
+ */
+poly_coeff_t CoeffBigBox(poly_coeff_t a);
+
+#endif /* __BIGNUM_H__ */
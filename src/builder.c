@@ -0,0 +1,284 @@
+/** @file
+ * Implementacja budowniczego wielomianów rzadkich wielu zmiennych
+ *
+ * @author Filip Głębocki <fg429202@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2021
+ */
+
+#include "builder.h"
+#include "node.h"
+#include "coeff.h"
+#include <string.h>
+
+PolyBuilder PolyBuilderInit(void) {
+  size_t *table = calloc(BUILDER_INITIAL_SIZE, sizeof(size_t));
+  CHECK_PTR(table);
+  return (PolyBuilder) {.count = 0, .termsSize = 0, .terms = NULL,
+      .tableSize = BUILDER_INITIAL_SIZE, .table = table,
+      .expsCount = 0, .expsSize = 0, .exps = NULL,
+      .pathSize = 0, .path = NULL};
+}
+
+void PolyBuilderDestroy(PolyBuilder *b) {
+  free(b->terms);
+  free(b->table);
+  free(b->exps);
+  free(b->path);
+  *b = (PolyBuilder) {0};
+}
+
+/**
+ * Oblicza skrót wektora wykładników.
+ * @param[in] n : długość wektora
+ * @param[in] exps : wektor wykładników
+ * @return skrót
+ */
+static size_t HashExps(size_t n, const poly_exp_t exps[]) {
+  size_t hash = 14695981039346656037UL;
+  for (size_t i = 0; i < n; i++) {
+    hash ^= (size_t) exps[i];
+    hash *= 1099511628211UL;
+  }
+  return hash ^ (hash >> 29);
+}
+
+/**
+ * Podwaja pojemność tablicy haszującej i rozmieszcza w niej ponownie
+ * wszystkie składniki.
+ * @param[in] b : budowniczy
+ */
+static void BuilderRehash(PolyBuilder *b) {
+  assert(b->tableSize * 2 > b->tableSize); // przepełnienie
+  free(b->table);
+  b->tableSize *= 2;
+  b->table = calloc(b->tableSize, sizeof(size_t));
+  CHECK_PTR(b->table);
+
+  size_t mask = b->tableSize - 1;
+  for (size_t i = 0; i < b->count; i++) {
+    size_t slot = b->terms[i].hash & mask;
+    while (b->table[slot] != 0)
+      slot = (slot + 1) & mask;
+    b->table[slot] = i + 1;
+  }
+}
+
+/**
+ * Dodaje do budowanego wielomianu składnik o współczynniku zredukowanym
+ * w bieżącym pierścieniu.
+ * @param[in,out] b : budowniczy
+ * @param[in] n : długość wektora wykładników
+ * @param[in] exps : wektor wykładników
+ * @param[in] c : zredukowany współczynnik
+ */
+static void BuilderAddReduced(PolyBuilder *b, size_t n,
+                              const poly_exp_t exps[], poly_coeff_t c) {
+  /* Końcowe zera nie zmieniają jednomianu, więc je pomijamy. */
+  while (n > 0 && exps[n - 1] == 0)
+    n--;
+
+  size_t hash = HashExps(n, exps);
+  size_t mask = b->tableSize - 1;
+  size_t slot = hash & mask;
+
+  /* Szukamy składnika o tym samym wektorze wykładników. */
+  while (b->table[slot] != 0) {
+    BuilderTerm *term = &b->terms[b->table[slot] - 1];
+    if (term->hash == hash && term->length == n && (n == 0 ||
+        memcmp(&b->exps[term->offset], exps, n * sizeof(poly_exp_t)) == 0)) {
+      term->coeff = CoeffAdd(term->coeff, c);
+      return;
+    }
+    slot = (slot + 1) & mask;
+  }
+
+  if (c == 0)
+    return;
+
+  /* Nie znaleźliśmy takiego składnika, więc dodajemy nowy. */
+  if (b->count == b->termsSize) {
+    b->termsSize = b->termsSize == 0 ? BUILDER_INITIAL_SIZE : 2 * b->termsSize;
+    b->terms = realloc(b->terms, b->termsSize * sizeof(BuilderTerm));
+    CHECK_PTR(b->terms);
+  }
+  if (b->expsCount + n > b->expsSize) {
+    while (b->expsCount + n > b->expsSize)
+      b->expsSize = b->expsSize == 0 ? BUILDER_INITIAL_SIZE : 2 * b->expsSize;
+    b->exps = realloc(b->exps, b->expsSize * sizeof(poly_exp_t));
+    CHECK_PTR(b->exps);
+  }
+
+  if (n > 0)
+    memcpy(&b->exps[b->expsCount], exps, n * sizeof(poly_exp_t));
+  b->terms[b->count] = (BuilderTerm) {.offset = b->expsCount, .length = n,
+      .hash = hash, .coeff = c};
+  b->expsCount += n;
+  b->count++;
+  b->table[slot] = b->count;
+
+  /* Utrzymujemy współczynnik zapełnienia tablicy nie większy niż 1/2. */
+  if (2 * b->count > b->tableSize)
+    BuilderRehash(b);
+}
+
+void PolyBuilderAddTerm(PolyBuilder *b, size_t n, const poly_exp_t exps[],
+                        poly_coeff_t c) {
+  BuilderAddReduced(b, n, exps, CoeffReduce(c));
+}
+
+/**
+ * Dodaje wszystkie jednomiany wielomianu @p p pomnożone przez @p c,
+ * poprzedzając ich wektory wykładników pierwszymi @p depth elementami
+ * tablicy @p b->path.
+ * @param[in] b : budowniczy
+ * @param[in] p : wielomian
+ * @param[in] depth : długość bieżącej ścieżki wykładników
+ * @param[in] c : współczynnik
+ */
+static void BuilderAddFlattened(PolyBuilder *b, const Poly *p, size_t depth,
+                                poly_coeff_t c) {
+  if (PolyIsCoeff(p)) {
+    BuilderAddReduced(b, depth, b->path, CoeffMul(p->coeff, c));
+    return;
+  }
+
+  if (depth == b->pathSize) {
+    b->pathSize = b->pathSize == 0 ? BUILDER_INITIAL_SIZE : 2 * b->pathSize;
+    b->path = realloc(b->path, b->pathSize * sizeof(poly_exp_t));
+    CHECK_PTR(b->path);
+  }
+
+  for (size_t i = 0; i < p->size; i++) {
+    b->path[depth] = MonoGetExp(&p->arr[i]);
+    BuilderAddFlattened(b, &p->arr[i].p, depth + 1, c);
+  }
+}
+
+void PolyBuilderAddPoly(PolyBuilder *b, poly_exp_t n, const Poly *p) {
+  if (b->pathSize == 0) {
+    b->pathSize = BUILDER_INITIAL_SIZE;
+    b->path = malloc(b->pathSize * sizeof(poly_exp_t));
+    CHECK_PTR(b->path);
+  }
+  b->path[0] = n;
+  BuilderAddFlattened(b, p, 1, 1);
+}
+
+void PolyBuilderAddScaled(PolyBuilder *b, const Poly *p, poly_coeff_t c) {
+  c = CoeffReduce(c);
+  if (c != 0)
+    BuilderAddFlattened(b, p, 0, c);
+}
+
+/**
+ * To jest struktura opisująca składnik w trakcie budowania wielomianu.
+ */
+typedef struct BuilderItem {
+  const poly_exp_t *exps; ///< wektor wykładników
+  size_t length; ///< długość wektora wykładników
+  poly_coeff_t coeff; ///< współczynnik
+} BuilderItem;
+
+/**
+ * Zwraca wykładnik zmiennej @f$x_{level}@f$ w składniku @p item.
+ * @param[in] item : składnik
+ * @param[in] level : indeks zmiennej
+ * @return wykładnik
+ */
+static inline poly_exp_t ItemExp(const BuilderItem *item, size_t level) {
+  return level < item->length ? item->exps[level] : 0;
+}
+
+/**
+ * Porównuje leksykograficznie wektory wykładników dwóch składników,
+ * traktując brakujące wykładniki jako zera.
+ * @param[in] a : składnik
+ * @param[in] b : składnik
+ * @return wynik porównania w konwencji funkcji qsort
+ */
+static int CompareItems(const void *a, const void *b) {
+  const BuilderItem *itemA = a;
+  const BuilderItem *itemB = b;
+  size_t length = itemA->length > itemB->length ? itemA->length : itemB->length;
+
+  for (size_t i = 0; i < length; i++) {
+    poly_exp_t expA = ItemExp(itemA, i), expB = ItemExp(itemB, i);
+    if (expA != expB)
+      return expA < expB ? -1 : 1;
+  }
+  return 0;
+}
+
+/**
+ * Buduje wielomian zmiennych @f$x_{level}, x_{level+1}, \ldots@f$
+ * z posortowanych składników o parami różnych wektorach wykładników
+ * i niezerowych współczynnikach.
+ * @param[in] items : posortowane składniki
+ * @param[in] count : liczba składników
+ * @param[in] level : indeks zmiennej głównej budowanego wielomianu
+ * @return wielomian w postaci kanonicznej
+ */
+static Poly BuildLevel(const BuilderItem items[], size_t count, size_t level) {
+  if (count == 1 && items[0].length <= level)
+    return PolyFromCoeff(items[0].coeff);
+
+  /* Składniki o równym wykładniku zmiennej x_level tworzą spójne grupy,
+   * więc najpierw liczymy grupy, aby zaalokować tablicę dokładnej wielkości. */
+  size_t groups = 1;
+  for (size_t i = 1; i < count; i++)
+    if (ItemExp(&items[i], level) != ItemExp(&items[i - 1], level))
+      groups++;
+
+  Mono *arr = NodeAlloc(groups);
+
+  size_t begin = 0;
+  for (size_t g = 0; g < groups; g++) {
+    poly_exp_t exp = ItemExp(&items[begin], level);
+    size_t end = begin + 1;
+    while (end < count && ItemExp(&items[end], level) == exp)
+      end++;
+
+    arr[g] = (Mono) {.p = BuildLevel(&items[begin], end - begin, level + 1),
+        .exp = exp};
+    begin = end;
+  }
+
+  /* Nie tworzymy zagłębionych wielomianów stałych. */
+  if (groups == 1 && arr[0].exp == 0 && PolyIsCoeff(&arr[0].p)) {
+    Poly result = arr[0].p;
+    NodeFree(arr);
+    return result;
+  }
+
+  Poly result = (Poly) {.size = groups, .arr = arr};
+  NodeUpdateMeta(&result);
+  return result;
+}
+
+Poly PolyBuilderFinish(PolyBuilder *b) {
+  BuilderItem *items = calloc(b->count == 0 ? 1 : b->count,
+                              sizeof(BuilderItem));
+  CHECK_PTR(items);
+
+  /* Pomijamy składniki, które się zredukowały. */
+  size_t count = 0;
+  for (size_t i = 0; i < b->count; i++) {
+    BuilderTerm *term = &b->terms[i];
+    if (term->coeff != 0) {
+      items[count] = (BuilderItem) {.exps = &b->exps[term->offset],
+          .length = term->length, .coeff = term->coeff};
+      count++;
+    }
+  }
+
+  Poly result = PolyZero();
+  if (count > 0) {
+    qsort(items, count, sizeof(BuilderItem), CompareItems);
+    result = BuildLevel(items, count, 0);
+  }
+
+  free(items);
+  PolyBuilderDestroy(b);
+  return result;
+}
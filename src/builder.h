@@ -0,0 +1,106 @@
+/** @file
+ * Interfejs budowniczego wielomianów rzadkich wielu zmiennych
+ *
+ * @author Filip Głębocki <fg429202@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2021
+ */
+
+#ifndef __BUILDER_H__
+#define __BUILDER_H__
+
+#include "poly.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** To jest początkowa pojemność tablicy haszującej budowniczego. */
+#define BUILDER_INITIAL_SIZE 16
+
+/**
+ * To jest struktura przechowująca pojedynczy składnik budowanego wielomianu,
+ * czyli jednomian wielu zmiennych postaci
+ * @f$c x_0^{e_0} x_1^{e_1} \ldots x_{l-1}^{e_{l-1}}@f$.
+ * Wektor wykładników jest przechowywany bez końcowych zer.
+ */
+typedef struct BuilderTerm {
+  size_t offset; ///< indeks początku wektora wykładników w puli
+  size_t length; ///< długość wektora wykładników
+  size_t hash; ///< skrót wektora wykładników
+  poly_coeff_t coeff; ///< współczynnik
+} BuilderTerm;
+
+/**
+ * To jest struktura przechowująca budowniczego wielomianu.
+ * Składniki mogą być dodawane w dowolnej kolejności; składniki o równych
+ * wektorach wykładników są łączone w tablicy haszującej z adresowaniem
+ * otwartym. Wielomian w postaci kanonicznej powstaje dopiero w funkcji
+ * PolyBuilderFinish.
+ */
+typedef struct PolyBuilder {
+  size_t count; ///< liczba różnych składników
+  size_t termsSize; ///< pojemność tablicy @p terms
+  BuilderTerm *terms; ///< składniki w kolejności wstawiania
+  size_t tableSize; ///< pojemność tablicy haszującej, zawsze postaci @f$2^n@f$
+  size_t *table; ///< indeksy składników powiększone o 1, 0 oznacza puste pole
+  size_t expsCount; ///< liczba zajętych pól puli wykładników
+  size_t expsSize; ///< pojemność puli wykładników
+  poly_exp_t *exps; ///< pula wektorów wykładników
+  size_t pathSize; ///< pojemność tablicy @p path
+  poly_exp_t *path; ///< bieżąca ścieżka wykładników przy spłaszczaniu
+} PolyBuilder;
+
+/**
+ * Inicjuje pustego budowniczego.
+ * @return zainicjowany budowniczy
+ */
+PolyBuilder PolyBuilderInit(void);
+
+/**
+ * Zwalnia pamięć zajmowaną przez budowniczego, porzucając dodane składniki.
+ * @param[in] b : budowniczy
+ */
+void PolyBuilderDestroy(PolyBuilder *b);
+
+/**
+ * Dodaje składnik @f$c x_0^{e_0} x_1^{e_1} \ldots x_{n-1}^{e_{n-1}}@f$.
+ * @param[in] b : budowniczy
+ * @param[in] n : długość wektora wykładników
+ * @param[in] exps : wektor wykładników @f$e@f$
+ * @param[in] c : współczynnik @f$c@f$
+ */
+void PolyBuilderAddTerm(PolyBuilder *b, size_t n, const poly_exp_t exps[],
+                        poly_coeff_t c);
+
+/**
+ * Dodaje wielomian @f$p x_0^n@f$, gdzie zmienne wielomianu @p p są
+ * zmiennymi @f$x_1, x_2, \ldots@f$. Nie przejmuje wielomianu @p p na własność.
+ * @param[in] b : budowniczy
+ * @param[in] n : wykładnik
+ * @param[in] p : wielomian
+ */
+void PolyBuilderAddPoly(PolyBuilder *b, poly_exp_t n, const Poly *p);
+
+/**
+ * Dodaje wielomian @f$c p@f$. Nie przejmuje wielomianu @p p na własność.
+ * @param[in] b : budowniczy
+ * @param[in] p : wielomian
+ * @param[in] c : współczynnik
+ */
+void PolyBuilderAddScaled(PolyBuilder *b, const Poly *p, poly_coeff_t c);
+
+/**
+ * Tworzy wielomian w postaci kanonicznej z dodanych składników,
+ * alokując tablice jednomianów o dokładnie potrzebnych rozmiarach.
+ * Zwalnia pamięć zajmowaną przez budowniczego.
+ * @param[in] b : budowniczy
+ * @return wielomian będący sumą dodanych składników
+ */
+Poly PolyBuilderFinish(PolyBuilder *b);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __BUILDER_H__ */
@@ -6,17 +6,17 @@
  * @date 2021
  */
 
-/** Makro pozwalające nam na użycie funkcji getline. */
-#define _GNU_SOURCE
-
 #include "poly.h"
 #include "stack.h"
 #include "parsing.h"
+#include "config.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <errno.h>
 #include <ctype.h>
+#include <stdint.h>
+#include <limits.h>
 
 /**
  * To jest zmienna wyliczeniowa reprezentująca różne kody wyjścia
@@ -28,12 +28,19 @@
  */
 enum EXECCODE {
   OK, ERR_COMMAND, ERR_DEG_BY, ERR_AT, ERR_NULL_IN_ARG,
-  ERR_STACK_UNDERFLOW, ERR_WRONG_POLY, ERR_COMPOSE
+  ERR_STACK_UNDERFLOW, ERR_WRONG_POLY, ERR_COMPOSE, ERR_ADD_N,
+  ERR_MUL_N, ERR_TRUNC
 };
 
 /** To jest typ reprezentujący kod wyjścia typu exec. */
 typedef int exec_code_t;
 
+/**
+ * To jest ograniczenie stopnia całkowitego iloczynów liczonych poleceniami
+ * MUL i MUL_N, ustawiane poleceniem TRUNC. Ujemne oznacza brak obcinania.
+ */
+static PolyDegBound truncation = {.totalDeg = -1, .vars = 0, .varDeg = NULL};
+
 /**
  * To jest makro sprawdzające, czy stos nie jest pusty.
  * Wywoływane jest przy wykonywaniu poleceń, które wymagają, aby stos
@@ -47,6 +54,34 @@ typedef int exec_code_t;
     }                             \
   } while (0)
 
+/**
+ * To jest najmniejsza liczba węzłów i jednomianów odłożonych do usunięcia,
+ * które są zwalniane po każdej linii wejścia (patrz PolyReclaim).
+ */
+#define RECLAIM_BUDGET 4096
+
+/**
+ * To jest liczba wątków parsujących linie wielomianów, ustawiana
+ * argumentem `--threads`. Dla więcej niż jednego wątku linia wielomianu
+ * jest najpierw wczytywana w całości, a potem parsowana funkcją
+ * ParsePolyParallel.
+ */
+static size_t parseThreads = 1;
+
+/** To jest rozmiar kawałka wejścia wczytywanego jednym wywołaniem fread. */
+#define INPUT_CHUNK_SIZE 65536
+
+/**
+ * To jest struktura przechowująca kawałek wejścia. Linie wielomianów są
+ * przekazywane parserowi przyrostowemu prosto z niej, więc nawet bardzo
+ * długa linia nie jest kopiowana w całości do pamięci.
+ */
+typedef struct Input {
+  char buf[INPUT_CHUNK_SIZE]; ///< wczytany kawałek
+  size_t pos; ///< indeks pierwszego nieprzetworzonego znaku
+  size_t size; ///< liczba znaków w kawałku
+} Input;
+
 /**
  * Wywołuje polecenie ZERO, które wstawia na wierzchołek stosu
  * wielomian tożsamościowo równy zeru.
@@ -134,7 +169,8 @@ static exec_code_t ExecAdd(Stack *s) {
 
 /**
  * Wywołuje polecenie MUL, które mnoży dwa wielomiany z wierzchu stosu,
- * usuwa je i wstawia na wierzchołek stosu ich iloczyn.
+ * usuwa je i wstawia na wierzchołek stosu ich iloczyn, obcięty do stopnia
+ * ustawionego poleceniem TRUNC.
  * @param[in] s : stos
  * @return kod wyjścia typu exec
  */
@@ -144,7 +180,8 @@ static exec_code_t ExecMul(Stack *s) {
 
   Poly p = Pop(s);
   Poly q = Pop(s);
-  Poly pq = PolyMul(&p, &q);
+  Poly pq = truncation.totalDeg >= 0 ? PolyMulTrunc(&p, &q, &truncation)
+                                     : PolyMul(&p, &q);
   Push(s, &pq);
 
   PolyDestroy(&p);
@@ -153,6 +190,29 @@ static exec_code_t ExecMul(Stack *s) {
   return OK;
 }
 
+/**
+ * Wywołuje polecenie FMA, które zdejmuje ze stosu wielomiany @f$p@f$
+ * (z wierzchołka), @f$q@f$ i @f$r@f$, a następnie wstawia na wierzchołek
+ * stosu wielomian @f$r + p \cdot q@f$.
+ * @param[in] s : stos
+ * @return kod wyjścia typu exec
+ */
+static exec_code_t ExecFma(Stack *s) {
+  if (s->top < 3)
+    return ERR_STACK_UNDERFLOW;
+
+  Poly p = Pop(s);
+  Poly q = Pop(s);
+  Poly acc = Pop(s);
+  PolyFmaInPlace(&acc, &p, &q);
+  Push(s, &acc);
+
+  PolyDestroy(&p);
+  PolyDestroy(&q);
+
+  return OK;
+}
+
 /**
  * Wywołuje polecenie NEG, negujące wielomian na wierzchołku stosu.
  * @param[in] s : stos
@@ -269,7 +329,7 @@ static exec_code_t ExecAt(const char *arg, Stack *s) {
 
   char *endPtr = NULL;
   errno = 0;
-  poly_coeff_t x = strtol(arg, &endPtr, 10);
+  poly_coeff_t x = ParseCoeff(arg, &endPtr);
   if (endPtr == NULL || *endPtr != '\0' || errno == ERANGE)
     return ERR_AT;
 
@@ -322,34 +382,242 @@ static exec_code_t ExecCompose(const char *arg, Stack *s) {
   return OK;
 }
 
-static void MonoPrint(Mono *m);
+/**
+ * Zdejmuje z wierzchołka stosu @f$k@f$ wielomianów, gdzie @f$k@f$ jest
+ * argumentem polecenia, i umieszcza na stosie wynik funkcji @p fold
+ * wywołanej dla tablicy tych wielomianów.
+ * @param[in] arg : napis zawierający liczbę zdejmowanych wielomianów
+ * @param[in] s : stos
+ * @param[in] fold : funkcja łącząca tablicę wielomianów
+ * @param[in] err : kod wyjścia typu exec dla błędnego argumentu
+ * @return kod wyjścia typu exec
+ */
+static exec_code_t ExecFold(const char *arg, Stack *s,
+                            Poly (*fold)(size_t, const Poly *[]),
+                            exec_code_t err) {
+  if (arg == NULL || !isdigit(arg[0]) || arg[0] == '-')
+    return err;
+
+  char *endPtr = NULL;
+  errno = 0;
+  size_t k = strtoul(arg, &endPtr, 10);
+  if (endPtr == NULL || *endPtr != '\0' || errno == ERANGE)
+    return err;
+
+  if (s->top < k)
+    return ERR_STACK_UNDERFLOW;
+
+  Poly *q = calloc(k, sizeof(Poly));
+  const Poly **qPtrs = calloc(k, sizeof(Poly *));
+  CHECK_PTR(q);
+  CHECK_PTR(qPtrs);
+  for (size_t i = 0; i < k; i++) {
+    q[k - i - 1] = Pop(s);
+    qPtrs[k - i - 1] = &q[k - i - 1];
+  }
+
+  Poly result = fold(k, qPtrs);
+  Push(s, &result);
+
+  for (size_t i = 0; i < k; i++)
+    PolyDestroy(&q[i]);
+  free(q);
+  free(qPtrs);
+
+  return OK;
+}
 
 /**
- * Wypisuje na standardowe wyjście zadany wielomian.
- * @param[in] p : wielomian
+ * Wywołuje polecenie ADD_N, które zdejmuje z wierzchołka stosu
+ * @f$k@f$ wielomianów i umieszcza na stosie ich sumę.
+ * @param[in] s : stos
+ * @param[in] arg : napis zawierający liczbę sumowanych wielomianów
+ * @return kod wyjścia typu exec
  */
-static void PolyPrint(Poly *p) {
-  if (PolyIsCoeff(p)) {
-    printf("%ld", p->coeff);
-    return;
+static exec_code_t ExecAddN(const char *arg, Stack *s) {
+  return ExecFold(arg, s, PolyAddMany, ERR_ADD_N);
+}
+
+/**
+ * Mnoży tablicę wielomianów, obcinając iloczyny do stopnia ustawionego
+ * poleceniem TRUNC. Obcięte iloczyny pośrednie są małe, więc mnożymy
+ * kolejno; bez obcinania mnożymy w drzewie funkcją PolyMulMany.
+ * @param[in] n : liczba wielomianów
+ * @param[in] ps : tablica wielomianów
+ * @return iloczyn wielomianów
+ */
+static Poly MulManyTrunc(size_t n, const Poly *ps[]) {
+  if (truncation.totalDeg < 0)
+    return PolyMulMany(n, ps);
+
+  Poly result = PolyFromCoeff(1);
+  for (size_t i = 0; i < n; i++) {
+    Poly mem = result;
+    result = PolyMulTrunc(&mem, ps[i], &truncation);
+    PolyDestroy(&mem);
   }
+  return result;
+}
+
+/**
+ * Wywołuje polecenie MUL_N, które zdejmuje z wierzchołka stosu
+ * @f$k@f$ wielomianów i umieszcza na stosie ich iloczyn, obcięty
+ * do stopnia ustawionego poleceniem TRUNC.
+ * @param[in] s : stos
+ * @param[in] arg : napis zawierający liczbę mnożonych wielomianów
+ * @return kod wyjścia typu exec
+ */
+static exec_code_t ExecMulN(const char *arg, Stack *s) {
+  return ExecFold(arg, s, MulManyTrunc, ERR_MUL_N);
+}
+
+/**
+ * Wywołuje polecenie TRUNC, które ustawia ograniczenie stopnia całkowitego
+ * iloczynów liczonych poleceniami MUL i MUL_N.
+ * @param[in] arg : napis zawierający ograniczenie stopnia
+ * @return kod wyjścia typu exec
+ */
+static exec_code_t ExecTrunc(const char *arg) {
+  if (arg == NULL || !isdigit(arg[0]) || arg[0] == '-')
+    return ERR_TRUNC;
+
+  char *endPtr = NULL;
+  errno = 0;
+  unsigned long deg = strtoul(arg, &endPtr, 10);
+  if (endPtr == NULL || *endPtr != '\0' || errno == ERANGE || deg > INT_MAX)
+    return ERR_TRUNC;
+
+  truncation.totalDeg = deg;
+  return OK;
+}
+
+/**
+ * Wywołuje polecenie NO_TRUNC, które wyłącza obcinanie iloczynów.
+ * @return kod wyjścia typu exec
+ */
+static exec_code_t ExecNoTrunc(void) {
+  truncation.totalDeg = -1;
+  return OK;
+}
+
+/**
+ * To jest struktura przechowująca stan wypisywania jednej tablicy
+ * jednomianów.
+ */
+typedef struct PrintFrame {
+  const Mono *arr; ///< wypisywana tablica jednomianów
+  size_t size; ///< liczba jednomianów tablicy
+  size_t i; ///< indeks bieżącego jednomianu
+} PrintFrame;
+
+/** To jest rozmiar bufora wyjścia funkcji PolyPrint. */
+#define PRINT_BUFFER_SIZE 65536
 
-  for (size_t i = 0; i < p->size; i++) {
-    Mono currMono = p->arr[i];
-    MonoPrint(&currMono);
-    if (i != p->size - 1)
-      printf("+");
+/**
+ * To jest największa liczba znaków wypisywanych w jednym kroku funkcji
+ * PolyPrint: nawias, współczynnik, przecinek, wykładnik, nawias i plus.
+ */
+#define PRINT_STEP_CHARS (POLY_COEFF_CHARS + POLY_EXP_CHARS + 4)
+
+/**
+ * To jest struktura przechowująca bufor wyjścia. Wielomian jest zapisywany
+ * do bufora funkcjami FormatCoeff i FormatExp, a bufor jest wypisywany
+ * jednym wywołaniem fwrite, więc printf nie interpretuje formatu
+ * dla każdego jednomianu.
+ */
+typedef struct PrintBuffer {
+  char data[PRINT_BUFFER_SIZE]; ///< zapisane znaki
+  size_t size; ///< liczba zapisanych znaków
+} PrintBuffer;
+
+/**
+ * Wypisuje zawartość bufora na standardowe wyjście i opróżnia go.
+ * @param[in,out] out : bufor
+ */
+static void PrintFlush(PrintBuffer *out) {
+  fwrite(out->data, sizeof(char), out->size, stdout);
+  out->size = 0;
+}
+
+/**
+ * Zapewnia, że w buforze jest miejsce na jeden krok wypisywania.
+ * @param[in,out] out : bufor
+ */
+static void PrintReserve(PrintBuffer *out) {
+  if (out->size + PRINT_STEP_CHARS > PRINT_BUFFER_SIZE)
+    PrintFlush(out);
+}
+
+/**
+ * Zapisuje do bufora współczynnik. Liczby dowolnej precyzji trybu
+ * dokładnego mogą być dłuższe niż bufor, więc są wypisywane osobno,
+ * po opróżnieniu bufora.
+ * @param[in,out] out : bufor z miejscem na jeden krok wypisywania
+ * @param[in] c : współczynnik
+ */
+static void PrintCoeff(PrintBuffer *out, poly_coeff_t c) {
+  if (!PolyCoeffIsBig(c)) {
+    out->size += FormatCoeff(c, out->data + out->size);
+    return;
   }
+  char *str = PolyCoeffToString(c);
+  PrintFlush(out);
+  fputs(str, stdout);
+  free(str);
 }
 
 /**
- * Wypisuje na standardowe wyjście zadany jednomian.
- * @param[in] m : jednomian
+ * Wypisuje na standardowe wyjście zadany wielomian. Wielomian jest
+ * przechodzony iteracyjnie, więc zagłębienie nie jest ograniczone
+ * rozmiarem stosu wywołań.
+ * @param[in] p : wielomian
  */
-static void MonoPrint(Mono *m) {
-  printf("(");
-  PolyPrint(&m->p);
-  printf(",%d)", MonoGetExp(m));
+static void PolyPrint(const Poly *p) {
+  static PrintBuffer out = {.size = 0};
+  if (PolyIsCoeff(p)) {
+    PrintCoeff(&out, p->coeff);
+    PrintFlush(&out);
+    return;
+  }
+
+  PrintFrame *stack = malloc(PolyDepth(p) * sizeof(PrintFrame));
+  CHECK_PTR(stack);
+  size_t top = 0;
+  stack[top++] = (PrintFrame) {.arr = p->arr, .size = p->size, .i = 0};
+
+  while (top > 0) {
+    PrintFrame *frame = &stack[top - 1];
+    PrintReserve(&out);
+    if (frame->i < frame->size) {
+      /* Otwieramy jednomian i schodzimy do jego współczynnika. */
+      const Mono *m = &frame->arr[frame->i];
+      out.data[out.size++] = '(';
+      if (!PolyIsCoeff(&m->p)) {
+        stack[top++] = (PrintFrame) {.arr = m->p.arr, .size = m->p.size,
+                                     .i = 0};
+        continue;
+      }
+      PrintCoeff(&out, m->p.coeff);
+    } else {
+      /* Współczynnik jednomianu z ramki niżej został wypisany. */
+      top--;
+      if (top == 0)
+        break;
+      frame = &stack[top - 1];
+    }
+
+    /* Zamykamy bieżący jednomian ramki frame. */
+    out.data[out.size++] = ',';
+    out.size += FormatExp(MonoGetExp(&frame->arr[frame->i]),
+                          out.data + out.size);
+    out.data[out.size++] = ')';
+    frame->i++;
+    if (frame->i < frame->size)
+      out.data[out.size++] = '+';
+  }
+
+  PrintFlush(&out);
+  free(stack);
 }
 
 /**
@@ -378,7 +646,7 @@ static exec_code_t ExecPop(Stack *s) {
   CHECK_STACK(s);
 
   Poly p = Pop(s);
-  PolyDestroy(&p);
+  PolyDestroyDeferred(&p);
 
   return OK;
 }
@@ -399,10 +667,16 @@ static exec_code_t Execute(const char *command, const char *arg, Stack *s) {
     return ExecAt(arg, s);
   if (strcmp(command, "COMPOSE") == 0)
     return ExecCompose(arg, s);
-
-  /* Jeśli polecenie jest postaci ATcoś, DEG_BYcoś lub COMPOSEcoś,
-   * gdzie coś jest białym znakiem innym niż spacja, to zwracamy
-   * odpowiedni błąd (nie WRONG COMMAND). */
+  if (strcmp(command, "ADD_N") == 0)
+    return ExecAddN(arg, s);
+  if (strcmp(command, "MUL_N") == 0)
+    return ExecMulN(arg, s);
+  if (strcmp(command, "TRUNC") == 0)
+    return ExecTrunc(arg);
+
+  /* Jeśli polecenie jest postaci ATcoś, DEG_BYcoś, COMPOSEcoś, ADD_Ncoś,
+   * MUL_Ncoś lub TRUNCcoś, gdzie coś jest białym znakiem innym niż spacja,
+   * to zwracamy odpowiedni błąd (nie WRONG COMMAND). */
   size_t len = strlen(command);
   if (len >= 7 && strncmp(command, "DEG_BY", 6) == 0 && isblank(command[6]))
     return ERR_DEG_BY;
@@ -410,6 +684,12 @@ static exec_code_t Execute(const char *command, const char *arg, Stack *s) {
     return ERR_AT;
   if (len >= 8 && strncmp(command, "COMPOSE", 7) == 0 && isblank(command[7]))
     return ERR_COMPOSE;
+  if (len >= 6 && strncmp(command, "ADD_N", 5) == 0 && isblank(command[5]))
+    return ERR_ADD_N;
+  if (len >= 6 && strncmp(command, "MUL_N", 5) == 0 && isblank(command[5]))
+    return ERR_MUL_N;
+  if (len >= 6 && strncmp(command, "TRUNC", 5) == 0 && isblank(command[5]))
+    return ERR_TRUNC;
 
   /* Jeśli argument nie jest pusty, to zwracamy ERR_COMMAND,
    * bo wszystkie następne polecenia są bezargumentowe. */
@@ -428,6 +708,8 @@ static exec_code_t Execute(const char *command, const char *arg, Stack *s) {
     return ExecAdd(s);
   if (strcmp(command, "MUL") == 0)
     return ExecMul(s);
+  if (strcmp(command, "FMA") == 0)
+    return ExecFma(s);
   if (strcmp(command, "NEG") == 0)
     return ExecNeg(s);
   if (strcmp(command, "SUB") == 0)
@@ -440,6 +722,8 @@ static exec_code_t Execute(const char *command, const char *arg, Stack *s) {
     return ExecPrint(s);
   if (strcmp(command, "POP") == 0)
     return ExecPop(s);
+  if (strcmp(command, "NO_TRUNC") == 0)
+    return ExecNoTrunc();
   return ERR_COMMAND;
 }
 
@@ -510,6 +794,15 @@ static void PrintErr(exec_code_t execCode, long lineIndex) {
     case ERR_COMPOSE:
       fprintf(stderr, "ERROR %ld COMPOSE WRONG PARAMETER\n", lineIndex);
       break;
+    case ERR_ADD_N:
+      fprintf(stderr, "ERROR %ld ADD_N WRONG PARAMETER\n", lineIndex);
+      break;
+    case ERR_MUL_N:
+      fprintf(stderr, "ERROR %ld MUL_N WRONG PARAMETER\n", lineIndex);
+      break;
+    case ERR_TRUNC:
+      fprintf(stderr, "ERROR %ld TRUNC WRONG PARAMETER\n", lineIndex);
+      break;
     case ERR_STACK_UNDERFLOW:
       fprintf(stderr, "ERROR %ld STACK UNDERFLOW\n", lineIndex);
       break;
@@ -522,8 +815,8 @@ static void PrintErr(exec_code_t execCode, long lineIndex) {
 }
 
 /**
- * Parsuje wczytaną linię, tj. sprawdza istotne warunki i wywołuje
- * Execute albo ParsePoly, zależnie od zawartości napisu.
+ * Parsuje wczytaną linię polecenia, tj. sprawdza istotne warunki
+ * i wywołuje Execute.
  * @param[in] line : wczytana linia
  * @param[in] lineLength : długość linii
  * @param[in] s : stos
@@ -534,33 +827,138 @@ static exec_code_t ParseLine(char *line, size_t lineLength, Stack *s) {
   if (line[0] == '#' || line[0] == '\n')
     return OK;
 
-  /* Linia jest poleceniem, bo pierwszy znak to litera. */
-  if (isalpha(line[0])) {
-    if (HasNoNullChar(line, lineLength) == ERR_COMMAND)
-      return ERR_COMMAND;
-
-    if (HasNoNullChar(line, lineLength) == ERR_NULL_IN_ARG) {
-      if (memcmp(line, "DEG_BY", 6) == 0)
-        return ERR_DEG_BY;
-      if (memcmp(line, "AT", 2) == 0)
-        return ERR_AT;
-      if (memcmp(line, "COMPOSE", 7) == 0)
-        return ERR_COMPOSE;
-      return ERR_COMMAND;
-    }
+  if (HasNoNullChar(line, lineLength) == ERR_COMMAND)
+    return ERR_COMMAND;
 
-    char *command = line;
-    char *arg = GetArg(line, lineLength);
-    if (command[lineLength - 1] == '\n')
-      command[lineLength - 1] = '\0';
+  if (HasNoNullChar(line, lineLength) == ERR_NULL_IN_ARG) {
+    if (memcmp(line, "DEG_BY", 6) == 0)
+      return ERR_DEG_BY;
+    if (memcmp(line, "AT", 2) == 0)
+      return ERR_AT;
+    if (memcmp(line, "COMPOSE", 7) == 0)
+      return ERR_COMPOSE;
+    if (memcmp(line, "ADD_N", 5) == 0)
+      return ERR_ADD_N;
+    if (memcmp(line, "MUL_N", 5) == 0)
+      return ERR_MUL_N;
+    if (memcmp(line, "TRUNC", 5) == 0)
+      return ERR_TRUNC;
+    return ERR_COMMAND;
+  }
 
-    return Execute(command, arg, s);
+  char *command = line;
+  char *arg = GetArg(line, lineLength);
+  if (command[lineLength - 1] == '\n')
+    command[lineLength - 1] = '\0';
+
+  return Execute(command, arg, s);
+}
+
+/**
+ * Zapewnia, że w kawałku wejścia jest nieprzetworzony znak, wczytując
+ * w razie potrzeby kolejny kawałek.
+ * @param[in,out] in : wejście
+ * @return czy wejście się nie skończyło
+ */
+static bool InputFill(Input *in) {
+  if (in->pos == in->size) {
+    in->size = fread(in->buf, sizeof(char), INPUT_CHUNK_SIZE, stdin);
+    in->pos = 0;
   }
+  return in->pos != in->size;
+}
 
-  /* Linia jest wielomianem. */
-  Poly p = ParsePoly(line, lineLength);
-  if (PolyIsErr(&p))
-    return ERR_WRONG_POLY;
+/**
+ * Pobiera z kawałka wejścia znaki bieżącej linii, aż do znaku nowej linii
+ * albo końca kawałka. Znak nowej linii jest pomijany.
+ * @param[in,out] in : wejście z co najmniej jednym nieprzetworzonym znakiem
+ * @param[out] size : liczba pobranych znaków
+ * @param[out] lineEnd : czy linia się skończyła
+ * @return wskaźnik na pierwszy pobrany znak
+ */
+static const char *InputTake(Input *in, size_t *size, bool *lineEnd) {
+  const char *start = in->buf + in->pos;
+  const char *newline = memchr(start, '\n', in->size - in->pos);
+  *lineEnd = newline != NULL;
+  *size = (*lineEnd ? newline : in->buf + in->size) - start;
+  in->pos += *size + *lineEnd;
+  return start;
+}
+
+/**
+ * Pomija bieżącą linię wejścia.
+ * @param[in,out] in : wejście
+ */
+static void SkipLine(Input *in) {
+  bool lineEnd = false;
+  while (!lineEnd && InputFill(in)) {
+    size_t size;
+    InputTake(in, &size, &lineEnd);
+  }
+}
+
+/**
+ * Wczytuje bieżącą linię wejścia do bufora, łącznie ze znakiem nowej
+ * linii, jeśli występuje, i kończy ją znakiem '\0', także gdy ostatnia
+ * linia wejścia nie ma znaku nowej linii. Bufor jest w razie potrzeby
+ * powiększany.
+ * @param[in,out] in : wejście
+ * @param[in,out] buffer : bufor
+ * @param[in,out] bufSize : rozmiar bufora
+ * @return długość linii
+ */
+static size_t ReadLine(Input *in, char **buffer, size_t *bufSize) {
+  size_t length = 0;
+  bool lineEnd = false;
+  while (!lineEnd && InputFill(in)) {
+    size_t size;
+    const char *piece = InputTake(in, &size, &lineEnd);
+    if (length + size + 2 > *bufSize) {
+      while (length + size + 2 > *bufSize)
+        *bufSize *= 2;
+      *buffer = realloc(*buffer, *bufSize);
+      CHECK_PTR(*buffer);
+    }
+    memcpy(*buffer + length, piece, size);
+    length += size;
+  }
+  if (lineEnd)
+    (*buffer)[length++] = '\n';
+  (*buffer)[length] = '\0';
+  return length;
+}
+
+/**
+ * Parsuje bieżącą linię wejścia jako wielomian i wstawia wynik na stos.
+ * Przy jednym wątku parser przyrostowy dostaje kolejne kawałki wejścia,
+ * a po błędzie reszta linii jest pomijana. Przy kilku wątkach linia jest
+ * wczytywana do bufora i parsowana funkcją ParsePolyParallel.
+ * @param[in,out] in : wejście
+ * @param[in,out] buffer : bufor linii
+ * @param[in,out] bufSize : rozmiar bufora
+ * @param[in] s : stos
+ * @return kod wyjścia typu exec
+ */
+static exec_code_t ParsePolyLine(Input *in, char **buffer, size_t *bufSize,
+                                 Stack *s) {
+  Poly p;
+  if (parseThreads > 1) {
+    size_t lineLength = ReadLine(in, buffer, bufSize);
+    p = ParsePolyParallel(*buffer, lineLength, parseThreads, NULL);
+    if (PolyIsErr(&p))
+      return ERR_WRONG_POLY;
+  }
+  else {
+    PolyParser parser = PolyParserInit();
+    bool lineEnd = false;
+    while (!lineEnd && InputFill(in)) {
+      size_t size;
+      const char *piece = InputTake(in, &size, &lineEnd);
+      PolyParserFeed(&parser, piece, size);
+    }
+    if (!PolyParserFinish(&parser, &p, NULL))
+      return ERR_WRONG_POLY;
+  }
 
   Push(s, &p);
 
@@ -568,46 +966,130 @@ static exec_code_t ParseLine(char *line, size_t lineLength, Stack *s) {
 }
 
 /**
- * Wczytuje linie z wejścia i parsuje je, wywołując dla każdej linii
- * funkcję ParseLine i sprawdzając kod wyjścia typu exec.
+ * Wczytuje wejście kawałkami i przetwarza kolejne linie: komentarze
+ * pomija, polecenia przekazuje funkcji ParseLine, a wielomiany funkcji
+ * ParsePolyLine, sprawdzając kod wyjścia typu exec.
  */
 static void ParseInput() {
   Stack s = InitStack();
 
+  static Input in = {.pos = 0, .size = 0};
   size_t bufSize = 64;
-  ssize_t lineLength;
   long lineIndex = 1;
   char *buffer = calloc(bufSize, sizeof(char));
   CHECK_PTR(buffer);
 
-  /* Wczytujemy w pętli linie ze strumienia wejścia, sprawdzając
-   * za każdym razem czy funkcja getline nie zasygnalizowała braku pamięci. */
-  errno = 0;
-  while ((lineLength = getline(&buffer, &bufSize, stdin)) != -1) {
-    int execCode = ParseLine(buffer, lineLength, &s);
+  while (InputFill(&in)) {
+    exec_code_t execCode = OK;
+    char first = in.buf[in.pos];
+    if (first == '#') {
+      SkipLine(&in);
+    }
+    else if (isalpha((unsigned char) first) || first == '\n') {
+      /* Linia jest poleceniem, bo pierwszy znak to litera. */
+      size_t lineLength = ReadLine(&in, &buffer, &bufSize);
+      execCode = ParseLine(buffer, lineLength, &s);
+    }
+    else {
+      execCode = ParsePolyLine(&in, &buffer, &bufSize, &s);
+    }
+
     if (execCode != OK)
       PrintErr(execCode, lineIndex);
 
+    /* Zwalniamy pamięć odłożoną przez to polecenie i porcję pamięci
+     * pozostawionej przez poprzednie, aby czas polecenia nie zależał
+     * od rozmiaru wielomianów usuniętych wcześniej. */
+    PolyReclaim(RECLAIM_BUDGET);
     lineIndex++;
   }
 
-  /* Sprawdzamy, czy wystąpił jakiś błąd. */
-  CHECK_PTR(buffer);
-  if (errno == ENOMEM || errno == EINVAL) {
-    DestroyStack(&s);
-    free(buffer);
-    exit(1);
-  }
-
+  /* Sprawdzamy, czy wystąpił błąd odczytu. */
+  bool readError = ferror(stdin);
   DestroyStack(&s);
+  PolyReclaim(SIZE_MAX);
+  PolyScratchRelease();
+  PolyBigRelease();
   free(buffer);
+  if (readError)
+    exit(1);
+}
+
+/**
+ * Wczytuje konfigurację wyboru algorytmu mnożenia z pliku wskazanego
+ * zmienną środowiskową POLY_MUL_CONFIG, jeśli jest ustawiona.
+ * Plik można wygenerować narzędziem mul_tune.
+ */
+static void LoadMulConfig() {
+  const char *path = getenv("POLY_MUL_CONFIG");
+  if (path == NULL)
+    return;
+
+  FILE *f = fopen(path, "r");
+  if (f == NULL)
+    return;
+
+  PolyMulConfig config = PolyGetMulConfig();
+  if (ReadMulConfig(f, &config))
+    PolySetMulConfig(&config);
+  fclose(f);
+}
+
+/**
+ * Ustawia tryb arytmetyki współczynników na podstawie argumentów programu.
+ * Argumenty `--mod m` włączają arytmetykę modulo @f$m@f$, a argument
+ * `--exact` dokładną arytmetykę, w której współczynniki niemieszczące się
+ * w typie poly_coeff_t są liczbami dowolnej precyzji. Argumenty `--threads n` ustawiają liczbę
+ * wątków parsujących linie wielomianów.
+ * @param[in] argc : liczba argumentów
+ * @param[in] argv : argumenty
+ * @return czy argumenty były poprawne
+ */
+static bool ParseArgs(int argc, char *argv[]) {
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--exact") == 0) {
+      PolySetExact(true);
+      continue;
+    }
+    if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc &&
+        isdigit(argv[i + 1][0])) {
+      char *endPtr = NULL;
+      errno = 0;
+      unsigned long threads = strtoul(argv[++i], &endPtr, 10);
+      if (*endPtr != '\0' || errno == ERANGE || threads == 0)
+        return false;
+      parseThreads = threads;
+      continue;
+    }
+    if (strcmp(argv[i], "--mod") != 0 || i + 1 == argc ||
+        !isdigit(argv[i + 1][0]))
+      return false;
+
+    char *endPtr = NULL;
+    errno = 0;
+    long long modulus = strtoll(argv[++i], &endPtr, 10);
+    if (*endPtr != '\0' || errno == ERANGE ||
+        modulus >= POLY_MODULUS_LIMIT || !PolySetModulus(modulus))
+      return false;
+  }
+  return true;
 }
 
 /**
  * Główna funkcja wykonująca program.
+ * @param[in] argc : liczba argumentów
+ * @param[in] argv : argumenty; opcjonalnie `--exact`, `--mod m`
+ * i `--threads n`
  * @return kod wyjścia programu
  */
-int main() {
+int main(int argc, char *argv[]) {
+  if (!ParseArgs(argc, argv)) {
+    fprintf(stderr, "usage: %s [--exact] [--mod m] [--threads n], "
+            "2 <= m < %lld\n", argv[0], POLY_MODULUS_LIMIT);
+    exit(1);
+  }
+
+  LoadMulConfig();
   ParseInput();
   exit(0);
 }
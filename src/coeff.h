@@ -0,0 +1,162 @@
+/** @file
+ * Interfejs arytmetyki współczynników wielomianów
+ *
+ * Współczynniki są zwykłymi liczbami całkowitymi albo, po ustawieniu
+ * modułu funkcją PolySetModulus, resztami modulo liczba @f$m@f$. W trybie
+ * modularnym wszystkie współczynniki tworzone przez bibliotekę leżą
+ * w przedziale @f$[0, m)@f$, więc współczynnik zerowy jest rozpoznawany
+ * dopiero po redukcji, jak w trybie zwykłym. Iloczyny są redukowane
+ * metodą Barretta, która używa tylko mnożeń i przesunięć 64-bitowych
+ * oraz odejmowań warunkowych, więc pętle po tablicach współczynników
+ * nie zawierają dzielenia ani skoków.
+ *
+ * W trybie zwykłym współczynniki przepełniają się modulo @f$2^{64}@f$,
+ * chyba że włączono tryb dokładny funkcją PolySetExact. Wtedy małe
+ * współczynniki są dodawane i mnożone wbudowanymi funkcjami kompilatora
+ * sprawdzającymi przepełnienie, co kosztuje jeden przewidywalny skok,
+ * a wyniki spoza zakresu małych współczynników są zapisywane jako liczby
+ * dowolnej precyzji (patrz bignum.h).
+ *
+ * Jeśli zdefiniowano makro POLY_COEFF_MODULUS, moduł jest stałą czasu
+ * kompilacji: stała Barretta jest wyliczana przez kompilator, a sprawdzenia
+ * trybu znikają z rozwiniętych funkcji.
+ *
+ * @author Filip Głębocki <fg429202@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2021
+ */
+
+#ifndef __COEFF_H__
+#define __COEFF_H__
+
+#include "poly.h"
+#include "bignum.h"
+#include <stdint.h>
+
+/**
+ * To jest struktura opisująca pierścień współczynników. Dla modułu
+ * @f$m@f$ o @f$k@f$ bitach przechowuje stałą Barretta
+ * @f$\lfloor 4^k / m \rfloor@f$.
+ */
+typedef struct CoeffRing {
+  uint64_t modulus; ///< moduł @f$m@f$ albo 0 dla zwykłych liczb całkowitych
+  uint64_t barrett; ///< stała Barretta @f$\lfloor 4^k / m \rfloor@f$
+  unsigned bits; ///< liczba bitów modułu @f$k@f$
+  bool exact; ///< czy w trybie zwykłym liczyć dokładnie
+} CoeffRing;
+
+/**
+ * To jest typ bez znaku, w którym sumy iloczynów współczynników przepełniają
+ * się w sposób określony. Ma co najmniej 64 bity i co najmniej tyle bitów
+ * co typ poly_coeff_t.
+ */
+#if POLY_COEFF_BITS == 128
+typedef unsigned __int128 coeff_acc_t;
+#else
+typedef uint64_t coeff_acc_t;
+#endif
+
+/** To jest bieżący pierścień współczynników, ustawiany przez PolySetModulus. */
+extern CoeffRing coeffRing;
+
+#ifdef POLY_COEFF_MODULUS
+_Static_assert(POLY_COEFF_MODULUS >= 2 &&
+               POLY_COEFF_MODULUS < POLY_MODULUS_LIMIT,
+               "POLY_COEFF_MODULUS spoza zakresu");
+
+/** To jest liczba bitów stałego modułu. */
+#define COEFF_FIXED_BITS (64 - __builtin_clzll(POLY_COEFF_MODULUS))
+
+/**
+ * Daje bieżący pierścień współczynników, czyli pierścień o stałym module.
+ * @return pierścień współczynników
+ */
+static inline CoeffRing CoeffCurrentRing(void) {
+  return (CoeffRing) {.modulus = POLY_COEFF_MODULUS,
+      .barrett = ((uint64_t) 1 << (2 * COEFF_FIXED_BITS)) / POLY_COEFF_MODULUS,
+      .bits = COEFF_FIXED_BITS, .exact = false};
+}
+#else
+/**
+ * Daje bieżący pierścień współczynników.
+ * @return pierścień współczynników
+ */
+static inline CoeffRing CoeffCurrentRing(void) {
+  return coeffRing;
+}
+#endif
+
+/**
+ * Redukuje iloczyn dwóch reszt metodą Barretta. Dla @f$x < 4^k@f$ przybliżony
+ * iloraz jest mniejszy od dokładnego o co najwyżej 2, więc wystarczą dwa
+ * odejmowania warunkowe.
+ * @param[in] ring : pierścień modularny
+ * @param[in] x : liczba @f$x < m^2@f$
+ * @return @f$x \bmod m@f$
+ */
+static inline uint64_t CoeffBarrett(const CoeffRing *ring, uint64_t x) {
+  uint64_t q = ((x >> (ring->bits - 1)) * ring->barrett) >> (ring->bits + 1);
+  uint64_t r = x - q * ring->modulus;
+  r -= r >= ring->modulus ? ring->modulus : 0;
+  r -= r >= ring->modulus ? ring->modulus : 0;
+  return r;
+}
+
+/**
+ * Sprowadza dowolną liczbę do reszty w bieżącym pierścieniu. Używa
+ * dzielenia, więc służy do redukcji danych wejściowych, a nie wyników
+ * pośrednich. W trybie dokładnym zamienia liczbę, która nie jest małym
+ * współczynnikiem, na uchwyt liczby z puli.
+ * @param[in] a : liczba
+ * @return reszta z przedziału @f$[0, m)@f$ albo współczynnik równy @p a
+ * w trybie zwykłym
+ */
+static inline poly_coeff_t CoeffReduce(poly_coeff_t a) {
+  CoeffRing ring = CoeffCurrentRing();
+  if (ring.modulus == 0)
+    return ring.exact && !CoeffIsSmall(a) ? CoeffBigBox(a) : a;
+  poly_coeff_t r = a % (poly_coeff_t) ring.modulus;
+  return r < 0 ? r + (poly_coeff_t) ring.modulus : r;
+}
+
+/**
+ * Dodaje dwa współczynniki w bieżącym pierścieniu.
+ * @param[in] a : współczynnik zredukowany
+ * @param[in] b : współczynnik zredukowany
+ * @return @f$a + b@f$
+ */
+static inline poly_coeff_t CoeffAdd(poly_coeff_t a, poly_coeff_t b) {
+  CoeffRing ring = CoeffCurrentRing();
+  if (ring.modulus == 0) {
+    poly_coeff_t sum;
+    __builtin_add_overflow(a, b, &sum);
+    if (!ring.exact || __builtin_expect(CoeffIsSmall(a) && CoeffIsSmall(b) &&
+                                        CoeffIsSmall(sum), 1))
+      return sum;
+    return CoeffBigAdd(a, b);
+  }
+  uint64_t sum = (uint64_t) a + (uint64_t) b;
+  return sum >= ring.modulus ? sum - ring.modulus : sum;
+}
+
+/**
+ * Mnoży dwa współczynniki w bieżącym pierścieniu.
+ * @param[in] a : współczynnik zredukowany
+ * @param[in] b : współczynnik zredukowany
+ * @return @f$a \cdot b@f$
+ */
+static inline poly_coeff_t CoeffMul(poly_coeff_t a, poly_coeff_t b) {
+  CoeffRing ring = CoeffCurrentRing();
+  if (ring.modulus == 0) {
+    poly_coeff_t product;
+    bool overflow = __builtin_mul_overflow(a, b, &product);
+    if (!ring.exact || __builtin_expect(!overflow && CoeffIsSmall(a) &&
+                                        CoeffIsSmall(b) &&
+                                        CoeffIsSmall(product), 1))
+      return product;
+    return CoeffBigMul(a, b);
+  }
+  return CoeffBarrett(&ring, (uint64_t) a * (uint64_t) b);
+}
+
+#endif /* __COEFF_H__ */
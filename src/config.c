@@ -0,0 +1,58 @@
+/** @file
+ * Implementacja funkcji zapisujących i wczytujących konfigurację biblioteki
+ *
+ * @author Filip Głębocki <fg429202@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2021
+ */
+
+#include "config.h"
+#include <string.h>
+
+/** To jest maksymalna długość nazwy pola w pliku konfiguracyjnym. */
+#define CONFIG_NAME_LENGTH 32
+
+bool ReadMulConfig(FILE *f, PolyMulConfig *config) {
+  char name[CONFIG_NAME_LENGTH + 1];
+  unsigned long value;
+  int c;
+
+  while ((c = getc(f)) != EOF) {
+    /* Pomijamy komentarze i puste linie. */
+    if (c == '#') {
+      while (c != '\n' && c != EOF)
+        c = getc(f);
+      continue;
+    }
+    if (c == '\n')
+      continue;
+    ungetc(c, f);
+
+    if (fscanf(f, "%32s %lu", name, &value) != 2)
+      return false;
+
+    if (strcmp(name, "strategy") == 0 && value <= MUL_DENSE)
+      config->strategy = value;
+    else if (strcmp(name, "dense_ratio") == 0)
+      config->denseRatio = value;
+    else if (strcmp(name, "hash_ratio") == 0)
+      config->hashRatio = value;
+    else if (strcmp(name, "heap_min_products") == 0)
+      config->heapMinProducts = value;
+    else if (strcmp(name, "threads") == 0)
+      config->threads = value;
+    else
+      return false;
+  }
+
+  return true;
+}
+
+void WriteMulConfig(FILE *f, const PolyMulConfig *config) {
+  fprintf(f, "# Konfiguracja wyboru algorytmu mnożenia wielomianów\n");
+  fprintf(f, "strategy %d\n", (int) config->strategy);
+  fprintf(f, "dense_ratio %zu\n", config->denseRatio);
+  fprintf(f, "hash_ratio %zu\n", config->hashRatio);
+  fprintf(f, "heap_min_products %zu\n", config->heapMinProducts);
+  fprintf(f, "threads %zu\n", config->threads);
+}
@@ -0,0 +1,32 @@
+/** @file
+ * Interfejs funkcji zapisujących i wczytujących konfigurację biblioteki
+ *
+ * @author Filip Głębocki <fg429202@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2021
+ */
+
+#ifndef __CONFIG_H__
+#define __CONFIG_H__
+
+#include "poly.h"
+#include <stdio.h>
+
+/**
+ * Wczytuje konfigurację wyboru algorytmu mnożenia zapisaną funkcją
+ * WriteMulConfig. Każda linia ma postać `nazwa wartość`; linie zaczynające
+ * się znakiem '#' są pomijane. Pola nieobecne w pliku nie są zmieniane.
+ * @param[in] f : plik
+ * @param[in,out] config : konfiguracja
+ * @return czy plik był poprawny
+ */
+bool ReadMulConfig(FILE *f, PolyMulConfig *config);
+
+/**
+ * Zapisuje konfigurację wyboru algorytmu mnożenia.
+ * @param[in] f : plik
+ * @param[in] config : konfiguracja
+ */
+void WriteMulConfig(FILE *f, const PolyMulConfig *config);
+
+#endif /* __CONFIG_H__ */
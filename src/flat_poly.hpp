@@ -0,0 +1,565 @@
+/** @file
+ * Wielomiany o liczbie zmiennych ustalonej w czasie kompilacji
+ *
+ * Szablon poly::FlatPoly przechowuje wielomian @f$N@f$ zmiennych jako
+ * posortowaną leksykograficznie tablicę składników
+ * @f$c x_0^{e_0} x_1^{e_1} \ldots x_{N-1}^{e_{N-1}}@f$. Wektory wykładników
+ * mają rozmiar znany kompilatorowi, więc porównania, dodawanie wektorów
+ * i stopnie są rozwijane w czasie kompilacji, a żadna operacja nie przechodzi
+ * po drzewie zagłębionych wielomianów. Jeśli wykładniki wyniku mnożenia
+ * mieszczą się w @f$\lfloor 64 / N \rfloor@f$ bitach, wektory są pakowane
+ * w jedną liczbę 64-bitową, której porządek jest porządkiem
+ * leksykograficznym, a iloczyn jednomianów jest sumą takich liczb.
+ *
+ * Porządek leksykograficzny wektorów jest porządkiem przejścia w głąb
+ * po wielomianie Poly, więc konwersje w obie strony są liniowe i bezstratne,
+ * o ile współczynniki mieszczą się w obu typach. Współczynniki są liczone
+ * w bieżącym pierścieniu biblioteki: w trybie modularnym (stały moduł
+ * POLY_COEFF_MODULUS albo PolySetModulus) każdy wynik jest resztą, a w trybie
+ * zwykłym przepełnia się jak w bibliotece. Tryb dokładny nie jest
+ * obsługiwany, bo współczynniki mogłyby być uchwytami liczb dowolnej
+ * precyzji; operacje zgłaszają wtedy wyjątek std::domain_error.
+ *
+ * @author Filip Głębocki <fg429202@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2021
+ */
+
+#ifndef __FLAT_POLY_HPP__
+#define __FLAT_POLY_HPP__
+
+#include "poly.hpp"
+#include "builder.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace poly {
+
+namespace detail {
+
+/**
+ * To jest bieżący pierścień współczynników biblioteki, odczytywany raz
+ * na operację na wielomianach FlatPoly. Moduł jest mniejszy niż
+ * POLY_MODULUS_LIMIT, więc iloczyn dwóch reszt mieści się w 64 bitach.
+ */
+template <class C>
+struct FlatRing {
+  uint64_t modulus; ///< moduł albo 0 dla zwykłej arytmetyki
+
+  /**
+   * Daje bieżący pierścień biblioteki.
+   * @return pierścień
+   * @throw std::domain_error w trybie dokładnym
+   */
+  static FlatRing Current() {
+    if (PolyGetExact())
+      throw std::domain_error("FlatPoly: tryb dokładny nie jest obsługiwany");
+    return {(uint64_t) PolyGetModulus()};
+  }
+
+  /**
+   * Sprowadza dowolną liczbę do współczynnika pierścienia.
+   * @param[in] a : liczba
+   * @return reszta z przedziału @f$[0, m)@f$ albo @p a w trybie zwykłym
+   */
+  C Reduce(C a) const {
+    if (modulus == 0)
+      return a;
+    C r = a % (C) modulus;
+    return r < 0 ? (C) (r + (C) modulus) : r;
+  }
+
+  /**
+   * Dodaje dwa współczynniki.
+   * @param[in] a : współczynnik zredukowany
+   * @param[in] b : współczynnik zredukowany
+   * @return @f$a + b@f$
+   */
+  C Add(C a, C b) const {
+    if (modulus == 0) {
+      C result;
+      __builtin_add_overflow(a, b, &result);
+      return result;
+    }
+    uint64_t sum = (uint64_t) a + (uint64_t) b;
+    return (C) (sum >= modulus ? sum - modulus : sum);
+  }
+
+  /**
+   * Mnoży dwa współczynniki.
+   * @param[in] a : współczynnik zredukowany
+   * @param[in] b : współczynnik zredukowany
+   * @return @f$a \cdot b@f$
+   */
+  C Mul(C a, C b) const {
+    if (modulus == 0) {
+      C result;
+      __builtin_mul_overflow(a, b, &result);
+      return result;
+    }
+    return (C) ((uint64_t) a * (uint64_t) b % modulus);
+  }
+
+  /**
+   * Zwraca współczynnik przeciwny.
+   * @param[in] a : współczynnik zredukowany
+   * @return @f$-a@f$
+   */
+  C Neg(C a) const {
+    if (modulus == 0)
+      return Mul(a, -1);
+    return a == 0 ? a : (C) (modulus - (uint64_t) a);
+  }
+};
+
+} // namespace detail
+
+/**
+ * To jest wielomian @p N zmiennych o współczynnikach typu @p Coeff.
+ * Składniki są posortowane rosnąco leksykograficznie według wektorów
+ * wykładników, mają parami różne wektory i niezerowe współczynniki.
+ */
+template <size_t N, class Coeff = poly_coeff_t>
+class FlatPoly {
+  static_assert(N >= 1, "wielomian musi mieć co najmniej jedną zmienną");
+
+public:
+  /** To jest typ wektora wykładników. */
+  using Exps = std::array<poly_exp_t, N>;
+
+  /** To jest składnik wielomianu. */
+  struct Term {
+    Exps exps; ///< wektor wykładników
+    Coeff coeff; ///< niezerowy współczynnik
+  };
+
+  /** To jest liczba bitów jednego wykładnika w postaci spakowanej. */
+  static constexpr unsigned PackBits = 64 / N;
+
+  /** To jest największy wykładnik mieszczący się w PackBits bitach. */
+  static constexpr uint64_t PackMask =
+      PackBits >= 64 ? ~(uint64_t) 0 : ((uint64_t) 1 << (PackBits % 64)) - 1;
+
+  /** Tworzy wielomian tożsamościowo równy zeru. */
+  FlatPoly() = default;
+
+  /**
+   * Tworzy wielomian ze składników w dowolnej kolejności, łącząc składniki
+   * o równych wektorach wykładników. W trybie modularnym współczynniki
+   * są sprowadzane do reszt.
+   * @param[in] terms : składniki
+   * @return wielomian
+   * @throw std::domain_error w trybie dokładnym
+   */
+  static FlatPoly FromTerms(std::vector<Term> terms) {
+    Ring ring = Ring::Current();
+    FlatPoly result;
+    result.terms_ = std::move(terms);
+    for (Term &t : result.terms_)
+      t.coeff = ring.Reduce(t.coeff);
+    result.Normalize(ring);
+    return result;
+  }
+
+  /**
+   * Sprawdza, czy wielomian Poly ma co najwyżej @p N zmiennych,
+   * czyli czy można go przekształcić funkcją FromPoly.
+   * @param[in] p : wielomian
+   * @return czy @p p mieści się w @p N zmiennych
+   */
+  static bool Fits(const Poly &p) {
+    return PolyDepth(&p) <= N;
+  }
+
+  /**
+   * Przekształca wielomian Poly, przechodząc po nim raz w głąb.
+   * Składniki zmiennych o indeksach co najmniej @p N nie miałyby gdzie
+   * trafić, więc głębszy wielomian jest odrzucany także bez asercji.
+   * @param[in] p : wielomian o co najwyżej @p N zmiennych
+   * @return wielomian
+   * @throw std::invalid_argument gdy @p p ma więcej niż @p N zmiennych
+   * @throw std::domain_error w trybie dokładnym
+   */
+  static FlatPoly FromPoly(const Poly &p) {
+    Ring::Current();
+    if (!Fits(p))
+      throw std::invalid_argument("FlatPoly::FromPoly: za dużo zmiennych");
+    FlatPoly result;
+    result.terms_.reserve(PolyTermCount(&p));
+    Exps exps{};
+    result.template Flatten<0>(p, exps);
+    return result;
+  }
+
+  /**
+   * Przekształca wielomian Polynomial.
+   * @param[in] p : wielomian o co najwyżej @p N zmiennych
+   * @return wielomian
+   */
+  static FlatPoly FromPoly(const Polynomial &p) {
+    return FromPoly(p.Get());
+  }
+
+  /**
+   * Tworzy równy wielomian Poly budowniczym, który w trybie modularnym
+   * sprowadza współczynniki do reszt.
+   * @return wielomian
+   */
+  Polynomial ToPoly() const {
+    PolyBuilder b = PolyBuilderInit();
+    for (const Term &t : terms_) {
+      assert((Coeff) (poly_coeff_t) t.coeff == t.coeff);
+      PolyBuilderAddTerm(&b, N, t.exps.data(), (poly_coeff_t) t.coeff);
+    }
+    return Polynomial::Adopt(PolyBuilderFinish(&b));
+  }
+
+  /**
+   * Daje składniki wielomianu.
+   * @return składniki w porządku leksykograficznym
+   */
+  const std::vector<Term> &Terms() const {
+    return terms_;
+  }
+
+  /**
+   * Sprawdza, czy wielomian jest tożsamościowo równy zeru.
+   * @return czy wielomian jest równy zeru
+   */
+  bool IsZero() const {
+    return terms_.empty();
+  }
+
+  /**
+   * Zwraca stopień całkowity wielomianu.
+   * @return stopień wielomianu albo -1 dla zera
+   */
+  poly_exp_t Deg() const {
+    poly_exp_t deg = -1;
+    for (const Term &t : terms_)
+      deg = std::max(deg, Sum(t.exps, Indices()));
+    return deg;
+  }
+
+  /**
+   * Zwraca stopień wielomianu ze względu na zmienną o indeksie znanym
+   * w czasie kompilacji.
+   * @return stopień ze względu na @f$x_I@f$ albo -1 dla zera
+   */
+  template <size_t I>
+  poly_exp_t DegBy() const {
+    static_assert(I < N, "indeks zmiennej poza zakresem");
+    poly_exp_t deg = -1;
+    for (const Term &t : terms_)
+      deg = std::max(deg, std::get<I>(t.exps));
+    return deg;
+  }
+
+  /**
+   * Zwraca stopnie wielomianu ze względu na wszystkie zmienne naraz.
+   * @return wektor stopni; dla zera same -1
+   */
+  Exps DegByAll() const {
+    Exps deg;
+    deg.fill(-1);
+    for (const Term &t : terms_)
+      deg = Max(deg, t.exps, Indices());
+    return deg;
+  }
+
+  /**
+   * Sprawdza równość dwóch wielomianów.
+   * @param[in] p : wielomian
+   * @param[in] q : wielomian
+   * @return @f$p = q@f$
+   */
+  friend bool operator==(const FlatPoly &p, const FlatPoly &q) {
+    return std::equal(p.terms_.begin(), p.terms_.end(), q.terms_.begin(),
+                      q.terms_.end(), [](const Term &a, const Term &b) {
+                        return a.coeff == b.coeff &&
+                               Compare(a.exps, b.exps, Indices()) == 0;
+                      });
+  }
+
+  /**
+   * Sprawdza nierówność dwóch wielomianów.
+   * @param[in] p : wielomian
+   * @param[in] q : wielomian
+   * @return @f$p \neq q@f$
+   */
+  friend bool operator!=(const FlatPoly &p, const FlatPoly &q) {
+    return !(p == q);
+  }
+
+  /**
+   * Dodaje dwa wielomiany, scalając ich składniki.
+   * @param[in] p : wielomian
+   * @param[in] q : wielomian
+   * @return @f$p + q@f$
+   */
+  friend FlatPoly operator+(const FlatPoly &p, const FlatPoly &q) {
+    return Merge(p, q, false);
+  }
+
+  /**
+   * Odejmuje dwa wielomiany, scalając ich składniki.
+   * @param[in] p : wielomian
+   * @param[in] q : wielomian
+   * @return @f$p - q@f$
+   */
+  friend FlatPoly operator-(const FlatPoly &p, const FlatPoly &q) {
+    return Merge(p, q, true);
+  }
+
+  /**
+   * Zwraca przeciwny wielomian.
+   * @param[in] p : wielomian
+   * @return @f$-p@f$
+   */
+  friend FlatPoly operator-(const FlatPoly &p) {
+    Ring ring = Ring::Current();
+    FlatPoly result = p;
+    for (Term &t : result.terms_)
+      t.coeff = ring.Neg(t.coeff);
+    return result;
+  }
+
+  /**
+   * Mnoży dwa wielomiany, sortując wszystkie iloczyny składników. Jeśli
+   * stopnie czynników na to pozwalają, sortowane są spakowane wektory
+   * wykładników.
+   * @param[in] p : wielomian
+   * @param[in] q : wielomian
+   * @return @f$p \cdot q@f$
+   */
+  friend FlatPoly operator*(const FlatPoly &p, const FlatPoly &q) {
+    Ring ring = Ring::Current();
+    if (p.IsZero() || q.IsZero())
+      return FlatPoly();
+    if (Packable(p.DegByAll(), q.DegByAll(), Indices()))
+      return MulPacked(p, q, ring);
+
+    FlatPoly result;
+    result.terms_.reserve(p.terms_.size() * q.terms_.size());
+    for (const Term &a : p.terms_)
+      for (const Term &b : q.terms_)
+        result.terms_.push_back({Add(a.exps, b.exps, Indices()),
+                                 ring.Mul(a.coeff, b.coeff)});
+    result.Normalize(ring);
+    return result;
+  }
+
+private:
+  /** To jest ciąg indeksów zmiennych, po którym rozwijane są pętle. */
+  using Indices = std::make_index_sequence<N>;
+
+  /** To jest pierścień współczynników. */
+  using Ring = detail::FlatRing<Coeff>;
+
+  std::vector<Term> terms_; ///< składniki w porządku leksykograficznym
+
+  /**
+   * Porównuje leksykograficznie dwa wektory wykładników.
+   * @param[in] a : wektor
+   * @param[in] b : wektor
+   * @return liczba ujemna, zero albo dodatnia, gdy @f$a < b@f$, @f$a = b@f$
+   * albo @f$a > b@f$
+   */
+  template <size_t... I>
+  static constexpr int Compare(const Exps &a, const Exps &b,
+                               std::index_sequence<I...>) {
+    int cmp = 0;
+    ((cmp = cmp != 0 ? cmp : (a[I] > b[I]) - (a[I] < b[I])), ...);
+    return cmp;
+  }
+
+  /**
+   * Dodaje dwa wektory wykładników.
+   * @param[in] a : wektor
+   * @param[in] b : wektor
+   * @return @f$a + b@f$
+   */
+  template <size_t... I>
+  static constexpr Exps Add(const Exps &a, const Exps &b,
+                            std::index_sequence<I...>) {
+    return {{(a[I] + b[I])...}};
+  }
+
+  /**
+   * Daje maksimum dwóch wektorów wykładników po współrzędnych.
+   * @param[in] a : wektor
+   * @param[in] b : wektor
+   * @return wektor maksimów
+   */
+  template <size_t... I>
+  static constexpr Exps Max(const Exps &a, const Exps &b,
+                            std::index_sequence<I...>) {
+    return {{std::max(a[I], b[I])...}};
+  }
+
+  /**
+   * Sumuje współrzędne wektora wykładników.
+   * @param[in] a : wektor
+   * @return @f$a_0 + a_1 + \ldots + a_{N-1}@f$
+   */
+  template <size_t... I>
+  static constexpr poly_exp_t Sum(const Exps &a, std::index_sequence<I...>) {
+    return (a[I] + ... + 0);
+  }
+
+  /**
+   * Sprawdza, czy wykładniki iloczynu wielomianów o zadanych stopniach
+   * względem zmiennych nie przekraczają PackMask.
+   * @param[in] p : stopnie pierwszego czynnika
+   * @param[in] q : stopnie drugiego czynnika
+   * @return czy iloczyn można liczyć na spakowanych wektorach
+   */
+  template <size_t... I>
+  static constexpr bool Packable(const Exps &p, const Exps &q,
+                                 std::index_sequence<I...>) {
+    return (... && ((uint64_t) p[I] + (uint64_t) q[I] <= PackMask));
+  }
+
+  /**
+   * Pakuje wektor wykładników w liczbę, której porządek jest porządkiem
+   * leksykograficznym wektorów.
+   * @param[in] a : wektor
+   * @return spakowany wektor
+   */
+  template <size_t... I>
+  static constexpr uint64_t Pack(const Exps &a, std::index_sequence<I...>) {
+    return (... | ((uint64_t) a[I] << (PackBits * (N - 1 - I))));
+  }
+
+  /**
+   * Rozpakowuje wektor wykładników.
+   * @param[in] key : spakowany wektor
+   * @return wektor
+   */
+  template <size_t... I>
+  static constexpr Exps Unpack(uint64_t key, std::index_sequence<I...>) {
+    return {{(poly_exp_t) ((key >> (PackBits * (N - 1 - I))) & PackMask)...}};
+  }
+
+  /**
+   * Mnoży dwa wielomiany na spakowanych wektorach wykładników.
+   * @param[in] p : wielomian
+   * @param[in] q : wielomian
+   * @param[in] ring : pierścień współczynników
+   * @return @f$p \cdot q@f$
+   */
+  static FlatPoly MulPacked(const FlatPoly &p, const FlatPoly &q,
+                            const Ring &ring) {
+    std::vector<uint64_t> qKeys;
+    qKeys.reserve(q.terms_.size());
+    for (const Term &b : q.terms_)
+      qKeys.push_back(Pack(b.exps, Indices()));
+
+    std::vector<std::pair<uint64_t, Coeff>> products;
+    products.reserve(p.terms_.size() * q.terms_.size());
+    for (const Term &a : p.terms_) {
+      uint64_t key = Pack(a.exps, Indices());
+      for (size_t j = 0; j < qKeys.size(); j++)
+        products.emplace_back(key + qKeys[j],
+                              ring.Mul(a.coeff, q.terms_[j].coeff));
+    }
+    std::sort(products.begin(), products.end(),
+              [](const auto &x, const auto &y) { return x.first < y.first; });
+
+    FlatPoly result;
+    for (size_t i = 0; i < products.size();) {
+      uint64_t key = products[i].first;
+      Coeff coeff = 0;
+      for (; i < products.size() && products[i].first == key; i++)
+        coeff = ring.Add(coeff, products[i].second);
+      if (coeff != 0)
+        result.terms_.push_back({Unpack(key, Indices()), coeff});
+    }
+    return result;
+  }
+
+  /**
+   * Scala składniki dwóch wielomianów.
+   * @param[in] p : wielomian
+   * @param[in] q : wielomian
+   * @param[in] negate : czy odjąć składniki @p q zamiast je dodać
+   * @return @f$p + q@f$ albo @f$p - q@f$
+   */
+  static FlatPoly Merge(const FlatPoly &p, const FlatPoly &q, bool negate) {
+    Ring ring = Ring::Current();
+    FlatPoly result;
+    result.terms_.reserve(p.terms_.size() + q.terms_.size());
+    size_t i = 0, j = 0;
+    while (i < p.terms_.size() || j < q.terms_.size()) {
+      int cmp = i == p.terms_.size()   ? 1
+                : j == q.terms_.size() ? -1
+                    : Compare(p.terms_[i].exps, q.terms_[j].exps, Indices());
+      if (cmp < 0) {
+        result.terms_.push_back(p.terms_[i++]);
+        continue;
+      }
+      Coeff coeff = negate ? ring.Neg(q.terms_[j].coeff) : q.terms_[j].coeff;
+      if (cmp == 0)
+        coeff = ring.Add(p.terms_[i++].coeff, coeff);
+      if (coeff != 0)
+        result.terms_.push_back({q.terms_[j].exps, coeff});
+      j++;
+    }
+    return result;
+  }
+
+  /**
+   * Przywraca niezmienniki: sortuje składniki, łączy składniki o równych
+   * wektorach wykładników i usuwa zerowe.
+   * @param[in] ring : pierścień współczynników
+   */
+  void Normalize(const Ring &ring) {
+    std::sort(terms_.begin(), terms_.end(), [](const Term &a, const Term &b) {
+      return Compare(a.exps, b.exps, Indices()) < 0;
+    });
+    size_t size = 0;
+    for (size_t i = 0; i < terms_.size();) {
+      Term term = terms_[i++];
+      for (; i < terms_.size() &&
+             Compare(terms_[i].exps, term.exps, Indices()) == 0; i++)
+        term.coeff = ring.Add(term.coeff, terms_[i].coeff);
+      if (term.coeff != 0)
+        terms_[size++] = term;
+    }
+    terms_.resize(size);
+  }
+
+  /**
+   * Dopisuje składniki wielomianu Poly w kolejności przejścia w głąb,
+   * która jest porządkiem leksykograficznym wektorów wykładników.
+   * Indeks zmiennej jest parametrem szablonu, więc rekurencja jest
+   * rozwijana w czasie kompilacji.
+   * @param[in] p : wielomian nad zmiennymi @f$x_{Var}, x_{Var+1}, \ldots@f$
+   * @param[in,out] exps : wykładniki zmiennych o mniejszych indeksach
+   */
+  template <size_t Var>
+  void Flatten(const Poly &p, Exps &exps) {
+    if (PolyIsCoeff(&p)) {
+      if (!PolyIsZero(&p)) {
+        assert((poly_coeff_t) (Coeff) p.coeff == p.coeff);
+        terms_.push_back({exps, (Coeff) p.coeff});
+      }
+      return;
+    }
+    if constexpr (Var < N) {
+      for (size_t i = 0; i < p.size; i++) {
+        std::get<Var>(exps) = MonoGetExp(&p.arr[i]);
+        Flatten<Var + 1>(p.arr[i].p, exps);
+      }
+      std::get<Var>(exps) = 0;
+    }
+  }
+};
+
+} // namespace poly
+
+#endif /* __FLAT_POLY_HPP__ */
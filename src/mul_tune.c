@@ -0,0 +1,174 @@
+/** @file
+ * Narzędzie wyznaczające progi wyboru algorytmu mnożenia wielomianów
+ *
+ * Mierzy czasy działania algorytmów mnożenia na danej maszynie, wyznacza
+ * punkty, w których opłaca się przejść z jednego algorytmu na drugi,
+ * i zapisuje konfigurację w formacie funkcji WriteMulConfig na standardowe
+ * wyjście albo do pliku podanego jako pierwszy argument.
+ *
+ * @author Filip Głębocki <fg429202@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2021
+ */
+
+#include "poly.h"
+#include "builder.h"
+#include "config.h"
+#include <stdio.h>
+#include <time.h>
+
+/** To jest minimalny czas pojedynczego pomiaru w sekundach. */
+#define MEASURE_TIME 0.02
+
+/**
+ * Zwraca kolejną liczbę pseudolosową.
+ * @param[in,out] seed : stan generatora
+ * @return liczba pseudolosowa
+ */
+static unsigned long NextRandom(unsigned long *seed) {
+  *seed = *seed * 6364136223846793005UL + 1442695040888963407UL;
+  return *seed >> 33;
+}
+
+/**
+ * Tworzy pseudolosowy wielomian o zadanej liczbie jednomianów
+ * na najwyższym poziomie.
+ * @param[in] size : liczba jednomianów
+ * @param[in] span : wykładniki są losowane z przedziału @f$[0, span)@f$
+ * @param[in] inner : liczba jednomianów współczynników; 0 oznacza
+ * wielomian jednej zmiennej
+ * @param[in,out] seed : stan generatora
+ * @return wielomian
+ */
+static Poly RandomPoly(size_t size, size_t span, size_t inner,
+                       unsigned long *seed) {
+  PolyBuilder b = PolyBuilderInit();
+  for (size_t i = 0; i < size; i++) {
+    poly_exp_t exps[2] = {NextRandom(seed) % span, 0};
+    if (inner == 0) {
+      PolyBuilderAddTerm(&b, 1, exps, NextRandom(seed) % 100 + 1);
+      continue;
+    }
+    for (size_t j = 0; j < inner; j++) {
+      exps[1] = NextRandom(seed) % (4 * inner);
+      PolyBuilderAddTerm(&b, 2, exps, NextRandom(seed) % 100 + 1);
+    }
+  }
+  return PolyBuilderFinish(&b);
+}
+
+/**
+ * Mierzy średni czas mnożenia wielomianów zadanym algorytmem.
+ * @param[in] strategy : algorytm
+ * @param[in] p : wielomian
+ * @param[in] q : wielomian
+ * @return czas jednego mnożenia w sekundach
+ */
+static double Measure(PolyMulStrategy strategy, const Poly *p, const Poly *q) {
+  PolyMulConfig config = POLY_MUL_CONFIG_DEFAULT;
+  config.strategy = strategy;
+  PolySetMulConfig(&config);
+
+  size_t reps = 0;
+  clock_t start = clock();
+  double elapsed;
+  do {
+    Poly pq = PolyMul(p, q);
+    PolyDestroy(&pq);
+    reps++;
+    elapsed = (double) (clock() - start) / CLOCKS_PER_SEC;
+  } while (elapsed < MEASURE_TIME);
+
+  return elapsed / reps;
+}
+
+/**
+ * Wyznacza najmniejszy stosunek liczby iloczynów jednomianów do liczby
+ * możliwych wykładników wyniku, przy którym algorytm @p fast jest szybszy
+ * od każdego z algorytmów @p slow.
+ * @param[in] fast : badany algorytm
+ * @param[in] slow : algorytmy, z którymi porównujemy
+ * @param[in] slowCount : liczba algorytmów w tablicy @p slow
+ * @param[in] inner : liczba jednomianów współczynników czynników
+ * @return wyznaczony próg
+ */
+static size_t FindRatio(PolyMulStrategy fast, const PolyMulStrategy slow[],
+                        size_t slowCount, size_t inner) {
+  unsigned long seed = 2021;
+  size_t size = inner > 0 ? 32 : 128;
+  size_t products = size * size;
+
+  /* Wykładniki obu czynników losujemy z przedziału długości span,
+   * więc wynik ma około 2 * span możliwych wykładników. */
+  for (size_t ratio = 1; ratio <= 256; ratio *= 2) {
+    size_t span = products / ratio / 2 + 1;
+    Poly p = RandomPoly(size, span, inner, &seed);
+    Poly q = RandomPoly(size, span, inner, &seed);
+
+    double fastTime = Measure(fast, &p, &q);
+    bool wins = true;
+    for (size_t i = 0; i < slowCount; i++)
+      if (Measure(slow[i], &p, &q) <= fastTime)
+        wins = false;
+
+    PolyDestroy(&p);
+    PolyDestroy(&q);
+    if (wins)
+      return ratio;
+  }
+
+  return 256;
+}
+
+/**
+ * Wyznacza najmniejszą liczbę iloczynów jednomianów, przy której scalanie
+ * kopcem jest szybsze od sortowania dla czynników bez wspólnych wykładników
+ * iloczynów.
+ * @return wyznaczony próg
+ */
+static size_t FindHeapMinProducts(void) {
+  unsigned long seed = 2021;
+  for (size_t size = 2; size <= 1024; size *= 2) {
+    Poly p = RandomPoly(size, 1 << 30, 0, &seed);
+    Poly q = RandomPoly(size, 1 << 30, 0, &seed);
+    bool wins = Measure(MUL_HEAP, &p, &q) < Measure(MUL_SORT, &p, &q);
+    PolyDestroy(&p);
+    PolyDestroy(&q);
+    if (wins)
+      return size * size;
+  }
+
+  return 1024 * 1024;
+}
+
+/**
+ * Główna funkcja narzędzia.
+ * @param[in] argc : liczba argumentów
+ * @param[in] argv : argumenty; opcjonalnie ścieżka pliku wynikowego
+ * @return kod wyjścia programu
+ */
+int main(int argc, char *argv[]) {
+  PolyMulConfig config = POLY_MUL_CONFIG_DEFAULT;
+
+  const PolyMulStrategy denseRivals[] = {MUL_SORT, MUL_HEAP, MUL_HASH};
+  const PolyMulStrategy hashRivals[] = {MUL_SORT, MUL_HEAP};
+  config.denseRatio = FindRatio(MUL_DENSE, denseRivals, 3, 0);
+  config.hashRatio = FindRatio(MUL_HASH, hashRivals, 2, 4);
+  config.heapMinProducts = FindHeapMinProducts();
+  config.strategy = MUL_AUTO;
+
+  FILE *f = stdout;
+  if (argc > 1) {
+    f = fopen(argv[1], "w");
+    if (f == NULL) {
+      perror(argv[1]);
+      return 1;
+    }
+  }
+
+  WriteMulConfig(f, &config);
+
+  if (f != stdout)
+    fclose(f);
+  return 0;
+}
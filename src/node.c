@@ -0,0 +1,194 @@
+/** @file
+ * Implementacja modułu zarządzającego tablicami jednomianów wielomianów
+ *
+ * @author Filip Głębocki <fg429202@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2021
+ */
+
+#include "node.h"
+
+/** To jest minimalny rozmiar kawałka pamięci areny w bajtach. */
+#define ARENA_CHUNK_SIZE (64 * 1024)
+
+/**
+ * To jest liczba bajtów, które jedna operacja może przydzielić z areny.
+ * Arena nie odzyskuje pamięci usuniętych wielomianów, więc powyżej tego
+ * limitu lepiej sprawdza się zwykła alokacja, która ją ponownie używa.
+ */
+#define ARENA_LIMIT (1024 * 1024)
+
+/**
+ * To jest struktura przechowująca kawałek pamięci areny. Kawałki tworzą
+ * listę od najnowszego, a każdy kolejny jest co najmniej dwa razy większy.
+ */
+typedef struct ArenaChunk {
+  struct ArenaChunk *prev; ///< poprzedni, mniejszy kawałek
+  size_t capacity; ///< rozmiar kawałka w bajtach
+  size_t used; ///< liczba zajętych bajtów
+  max_align_t data[]; ///< pamięć kawałka
+} ArenaChunk;
+
+/** To jest najnowszy kawałek areny bieżącego wątku. */
+static _Thread_local ArenaChunk *arenaChunk = NULL;
+
+/** To jest informacja, czy arena bieżącego wątku jest włączona. */
+static _Thread_local bool arenaActive = false;
+
+/** To jest liczba bajtów przydzielonych z areny od ostatniego opróżnienia. */
+static _Thread_local size_t arenaUsed = 0;
+
+/**
+ * Przydziela pamięć z areny bieżącego wątku, w razie potrzeby dokładając
+ * nowy kawałek.
+ * @param[in] bytes : liczba bajtów
+ * @return przydzielona pamięć albo NULL, jeśli arena przekroczyła limit
+ */
+static void *ArenaAlloc(size_t bytes) {
+  bytes = (bytes + sizeof(max_align_t) - 1) / sizeof(max_align_t) *
+          sizeof(max_align_t);
+  if (arenaUsed + bytes > ARENA_LIMIT)
+    return NULL;
+  arenaUsed += bytes;
+
+  if (arenaChunk == NULL || arenaChunk->capacity - arenaChunk->used < bytes) {
+    size_t capacity = ARENA_CHUNK_SIZE;
+    if (arenaChunk != NULL && 2 * arenaChunk->capacity > capacity)
+      capacity = 2 * arenaChunk->capacity;
+    if (bytes > capacity)
+      capacity = bytes;
+
+    ArenaChunk *chunk = malloc(sizeof(ArenaChunk) + capacity);
+    CHECK_PTR(chunk);
+    *chunk = (ArenaChunk) {.prev = arenaChunk, .capacity = capacity,
+                           .used = 0};
+    arenaChunk = chunk;
+  }
+
+  void *result = (char *) arenaChunk->data + arenaChunk->used;
+  arenaChunk->used += bytes;
+  return result;
+}
+
+Mono *NodeAlloc(size_t size) {
+  assert(size > 0);
+  size_t bytes = sizeof(NodeHeader) + size * sizeof(Mono);
+
+  NodeHeader *header = arenaActive ? ArenaAlloc(bytes) : NULL;
+  if (header != NULL) {
+    header->kind = NODE_ARENA;
+    return (Mono *) (header + 1);
+  }
+
+  header = malloc(bytes);
+  CHECK_PTR(header);
+  header->kind = NODE_HEAP;
+  return (Mono *) (header + 1);
+}
+
+Mono *NodeRealloc(Mono *arr, size_t size) {
+  assert(size > 0);
+  /* Tablice z areny są tylko zmniejszane, więc zostają na miejscu. */
+  if (NodeGetHeader(arr)->kind != NODE_HEAP)
+    return arr;
+
+  NodeHeader *header = realloc((NodeHeader *) arr - 1,
+                               sizeof(NodeHeader) + size * sizeof(Mono));
+  CHECK_PTR(header);
+  return (Mono *) (header + 1);
+}
+
+void NodeFree(Mono *arr) {
+  if (arr == NULL)
+    return;
+
+  NodeKind kind = NodeGetHeader(arr)->kind;
+  if (kind == NODE_HEAP || kind == NODE_BLOCK_ROOT)
+    free(NodeGetHeader(arr));
+}
+
+NodeBlock NodeBlockInit(size_t nodes, size_t monos) {
+  assert(nodes > 0);
+  size_t bytes = nodes * sizeof(NodeHeader) + monos * sizeof(Mono);
+  char *start = malloc(bytes);
+  CHECK_PTR(start);
+  return (NodeBlock) {.start = start, .next = start, .end = start + bytes};
+}
+
+Mono *NodeBlockAlloc(NodeBlock *block, size_t size) {
+  assert(size > 0);
+  NodeHeader *header = (NodeHeader *) block->next;
+  block->next += sizeof(NodeHeader) + size * sizeof(Mono);
+  assert(block->next <= block->end);
+
+  /* Korzeń leży na początku bloku, więc jego zwolnienie zwalnia cały blok. */
+  header->kind = (char *) header == block->start ? NODE_BLOCK_ROOT
+                                                 : NODE_BORROWED;
+  return (Mono *) (header + 1);
+}
+
+void NodeUpdateMeta(const Poly *p) {
+  assert(!PolyIsCoeff(p));
+
+  NodeMeta meta = {.deg = 0, .totalDeg = 0, .terms = 0, .depth = 1};
+  for (size_t i = 0; i < p->size; i++) {
+    const Mono *m = &p->arr[i];
+    if (PolyIsZero(&m->p))
+      continue;
+
+    poly_exp_t exp = MonoGetExp(m);
+    poly_exp_t totalDeg = exp;
+    if (PolyIsCoeff(&m->p)) {
+      meta.terms++;
+    } else {
+      NodeMeta *child = NodeGetMeta(m->p.arr);
+      totalDeg += child->totalDeg;
+      meta.terms += child->terms;
+      if (child->depth + 1 > meta.depth)
+        meta.depth = child->depth + 1;
+    }
+
+    if (exp > meta.deg)
+      meta.deg = exp;
+    if (totalDeg > meta.totalDeg)
+      meta.totalDeg = totalDeg;
+  }
+
+  *NodeGetMeta(p->arr) = meta;
+}
+
+bool NodeArenaEnter(void) {
+  if (arenaActive)
+    return false;
+  arenaActive = true;
+  return true;
+}
+
+void NodeArenaLeave(void) {
+  arenaActive = false;
+}
+
+void NodeArenaReset(void) {
+  assert(!arenaActive);
+  arenaUsed = 0;
+  if (arenaChunk == NULL)
+    return;
+
+  /* Zostawiamy tylko największy kawałek, więc kolejna operacja
+   * o podobnym rozmiarze nie będzie już alokować. */
+  ArenaChunk *chunk = arenaChunk->prev;
+  while (chunk != NULL) {
+    ArenaChunk *prev = chunk->prev;
+    free(chunk);
+    chunk = prev;
+  }
+  arenaChunk->prev = NULL;
+  arenaChunk->used = 0;
+}
+
+void NodeArenaRelease(void) {
+  assert(!arenaActive);
+  NodeArenaReset();
+  free(arenaChunk);
+  arenaChunk = NULL;
+}
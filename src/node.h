@@ -0,0 +1,197 @@
+/** @file
+ * Interfejs modułu zarządzającego tablicami jednomianów wielomianów
+ *
+ * Każda tablica jednomianów wielomianu niebędącego współczynnikiem
+ * jest poprzedzona w pamięci nagłówkiem przechowującym metadane węzła,
+ * dzięki czemu zapytania o stopień, liczbę jednomianów czy zagłębienie
+ * wielomianu działają w czasie stałym, a struktura Poly nie rośnie.
+ *
+ * @author Filip Głębocki <fg429202@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2021
+ */
+
+#ifndef __NODE_H__
+#define __NODE_H__
+
+#include "poly.h"
+
+/**
+ * To jest struktura przechowująca metadane węzła, czyli wielomianu
+ * niebędącego współczynnikiem. Metadane są wyliczane raz, przy tworzeniu
+ * wielomianu, na podstawie metadanych jego współczynników.
+ */
+typedef struct NodeMeta {
+  poly_exp_t deg; ///< stopień ze względu na zmienną główną
+  poly_exp_t totalDeg; ///< stopień całkowity, zwracany przez PolyDeg
+  size_t terms; ///< liczba niezerowych współczynników liczbowych w drzewie
+  size_t depth; ///< maksymalne zagłębienie, czyli liczba zmiennych
+} NodeMeta;
+
+/** To jest typ opisujący, kto jest właścicielem pamięci węzła. */
+typedef enum NodeKind {
+  NODE_HEAP, ///< węzeł zaalokowany osobno funkcją NodeAlloc
+  NODE_BLOCK_ROOT, ///< korzeń bloku; zwolnienie zwalnia cały blok
+  NODE_BORROWED, ///< węzeł wewnątrz bloku lub na stosie; nie jest zwalniany
+  NODE_ARENA ///< węzeł z areny; zwalniane są tylko jego współczynniki
+} NodeKind;
+
+/**
+ * To jest struktura przechowująca nagłówek tablicy jednomianów.
+ * Nagłówek znajduje się w pamięci bezpośrednio przed tablicą.
+ * Podczas usuwania wielomianu metadane nie są już potrzebne, więc w ich
+ * miejscu tablice czekające na zwolnienie tworzą listę, dzięki czemu
+ * usuwanie nie wymaga rekurencji ani dodatkowej pamięci.
+ */
+typedef struct NodeHeader {
+  union {
+    NodeMeta meta; ///< metadane węzła
+    struct {
+      Mono *next; ///< następna tablica na liście do zwolnienia
+      size_t size; ///< liczba jednomianów tablicy
+    } link; ///< element listy tablic do zwolnienia
+  };
+  NodeKind kind; ///< właściciel pamięci węzła
+} NodeHeader;
+
+/**
+ * To jest struktura opisująca blok pamięci, w którym kolejne węzły
+ * wielomianu są układane jeden za drugim.
+ */
+typedef struct NodeBlock {
+  char *start; ///< początek bloku, czyli nagłówek korzenia
+  char *next; ///< miejsce na nagłówek następnego węzła
+  char *end; ///< koniec bloku
+} NodeBlock;
+
+/**
+ * To jest struktura przechowująca węzeł o jednym jednomianie razem
+ * z nagłówkiem w pamięci automatycznej wywołującego. Pozwala traktować
+ * współczynnik jak wielomian @f$cx_i^0@f$ bez alokacji na stercie.
+ * Tablica takiego węzła nie może zostać zwolniona.
+ */
+typedef struct NodeInline {
+  NodeHeader header; ///< nagłówek węzła
+  Mono mono; ///< jedyny jednomian węzła
+} NodeInline;
+
+/**
+ * Alokuje tablicę jednomianów wraz z nagłówkiem. Tablice przechowywane
+ * w polu @p arr wielomianów muszą być alokowane tą funkcją. Jeśli arena
+ * bieżącego wątku jest włączona i nie przekroczyła limitu ARENA_LIMIT,
+ * tablica jest przydzielana z areny i jej zwolnienie nic nie robi.
+ * @param[in] size : liczba jednomianów, @f$size > 0@f$
+ * @return wskaźnik na pierwszy jednomian tablicy
+ */
+Mono *NodeAlloc(size_t size);
+
+/**
+ * Zmienia rozmiar tablicy jednomianów zaalokowanej funkcją NodeAlloc.
+ * Tablice zaalokowane w arenie można jedynie zmniejszać.
+ * @param[in] arr : tablica jednomianów
+ * @param[in] size : nowa liczba jednomianów, @f$size > 0@f$
+ * @return wskaźnik na pierwszy jednomian nowej tablicy
+ */
+Mono *NodeRealloc(Mono *arr, size_t size);
+
+/**
+ * Zwalnia tablicę jednomianów, nie zwalniając jej zawartości.
+ * Dla korzenia bloku zwalnia cały blok, a dla węzłów pożyczonych
+ * nic nie robi.
+ * @param[in] arr : tablica jednomianów
+ */
+void NodeFree(Mono *arr);
+
+/**
+ * Alokuje blok mieszczący zadaną liczbę węzłów i jednomianów.
+ * @param[in] nodes : liczba węzłów, @f$nodes > 0@f$
+ * @param[in] monos : łączna liczba jednomianów tych węzłów
+ * @return blok
+ */
+NodeBlock NodeBlockInit(size_t nodes, size_t monos);
+
+/**
+ * Umieszcza w bloku kolejną tablicę jednomianów wraz z nagłówkiem.
+ * Pierwsza tablica bloku staje się jego korzeniem, a pozostałe
+ * są zwalniane razem z nim.
+ * @param[in,out] block : blok
+ * @param[in] size : liczba jednomianów, @f$size > 0@f$
+ * @return wskaźnik na pierwszy jednomian tablicy
+ */
+Mono *NodeBlockAlloc(NodeBlock *block, size_t size);
+
+/**
+ * Daje nagłówek tablicy jednomianów zaalokowanej funkcją NodeAlloc.
+ * @param[in] arr : tablica jednomianów
+ * @return nagłówek tablicy
+ */
+static inline NodeHeader *NodeGetHeader(const Mono *arr) {
+  return (NodeHeader *) arr - 1;
+}
+
+/**
+ * Daje metadane węzła, którego tablicą jednomianów jest @p arr.
+ * @param[in] arr : tablica jednomianów
+ * @return metadane węzła
+ */
+static inline NodeMeta *NodeGetMeta(const Mono *arr) {
+  return &NodeGetHeader(arr)->meta;
+}
+
+/**
+ * Zapisuje w węźle @p node wielomian @f$cx_i^0@f$ równy współczynnikowi
+ * @p c. Wynik jest ważny, dopóki istnieje @p node, i nie wolno go usuwać.
+ * @param[out] node : węzeł
+ * @param[in] c : niezerowy współczynnik
+ * @return wielomian @f$cx_i^0@f$
+ */
+static inline Poly NodeInlineLift(NodeInline *node, poly_coeff_t c) {
+  assert(c != 0);
+  _Static_assert(sizeof(NodeHeader) % _Alignof(Mono) == 0,
+                 "jednomian musi leżeć bezpośrednio za nagłówkiem");
+
+  node->mono = (Mono) {.p = PolyFromCoeff(c), .exp = 0};
+  node->header.meta = (NodeMeta) {.deg = 0, .totalDeg = 0, .terms = 1,
+                                  .depth = 1};
+  node->header.kind = NODE_BORROWED;
+  return (Poly) {.size = 1, .arr = &node->mono};
+}
+
+/**
+ * Wylicza metadane wielomianu niebędącego współczynnikiem na podstawie
+ * metadanych jego współczynników. Musi być wywołana po utworzeniu tablicy
+ * jednomianów, a przed przekazaniem wielomianu dalej.
+ * @param[in] p : wielomian
+ */
+void NodeUpdateMeta(const Poly *p);
+
+/**
+ * Włącza arenę bieżącego wątku. Od tej chwili NodeAlloc przydziela
+ * tablice z areny, co pozwala nie zwalniać wielomianów tymczasowych
+ * pojedynczo, tylko usunąć je wszystkie naraz funkcją NodeArenaReset.
+ * Wielomiany zawierające węzły z areny nadal trzeba usuwać funkcją
+ * PolyDestroy, bo po przekroczeniu limitu areny ich współczynniki mogą
+ * być alokowane osobno.
+ * @return czy arena została włączona tym wywołaniem; jeśli była już
+ * włączona, wywołujący nie powinien jej wyłączać
+ */
+bool NodeArenaEnter(void);
+
+/**
+ * Wyłącza arenę bieżącego wątku. Tablice przydzielone z areny pozostają
+ * ważne aż do wywołania NodeArenaReset, więc można z nich skopiować wynik.
+ */
+void NodeArenaLeave(void);
+
+/**
+ * Usuwa wszystkie tablice przydzielone z areny bieżącego wątku,
+ * zachowując jej pamięć na potrzeby kolejnych operacji.
+ */
+void NodeArenaReset(void);
+
+/**
+ * Zwalnia całą pamięć areny bieżącego wątku.
+ */
+void NodeArenaRelease(void);
+
+#endif /* __NODE_H__ */
@@ -7,153 +7,809 @@
  */
 
 #include "parsing.h"
+#include <threads.h>
 
-static Mono ParseMono(char *str, size_t size);
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/** To jest początkowa pojemność stosów parsera. */
+#define PARSER_INITIAL_SIZE 16
 
 /**
- * Funkcja pomocnicza, wywoływana przez ParsePoly, która wykonuje
- * właściwe parsowanie. Jeśli napis nie jest poprawnym wielomianem,
- * zwracane jest ERR_POLY.
- * @param[in] str : napis
- * @param[in] size : długość napisu
- * @return sparsowany wielomian
- */
-static Poly ParsePolyHelper(char *str, size_t size) {
-  /* Sprawdzamy, czy parsowany napis nie jest liczbą, czyli wielomianem stałym. */
-  char *endPtr = NULL;
-  errno = 0;
-  long coeff = strtol(str, &endPtr, 10);
-  /* Nie akceptujemy liczb z plusem na początku, a także sprawdzamy,
-   * czy liczba nie jest spoza zakresu. */
-  if (str[0] == '+' || errno == ERANGE)
-    return ERR_POLY;
-  if (*endPtr == '\0')
-    return PolyFromCoeff(coeff);
-
-  /* Liczymy jednomiany w zadanym napisie i zamieniamy znaki '+', które nie są
-   * w środku żadnego nawiasu na znaki '_'. */
-  int monoCount = 1, openedParenthesesCount = 0;
-  for (size_t i = 0; i < size; i++) {
-    if (str[i] == '(') {
-      openedParenthesesCount++;
-    }
-    else if (str[i] == ')') {
-      openedParenthesesCount--;
-    }
-    else if (str[i] == '+' && openedParenthesesCount == 0) {
-      monoCount++;
-      str[i] = '_';
-    }
+ * To jest najmniejsza długość napisu, który funkcja ParsePolyParallel
+ * dzieli między wątki. Krótsze napisy parsuje szybciej jeden wątek.
+ */
+#define PARSE_PARALLEL_MIN_SIZE ((size_t) 1 << 20)
+
+/** To jest najmniejsza długość fragmentu napisu przypadającego na wątek. */
+#define PARSE_PARALLEL_MIN_CHUNK ((size_t) 1 << 16)
+
+/**
+ * To jest liczba cyfr, z których każda liczba mieści się w typie
+ * poly_coeff_t. Krótsze liczby są wczytywane bez sprawdzania przepełnienia.
+ */
+#if POLY_COEFF_BITS == 32
+#define COEFF_SAFE_DIGITS 9
+#elif POLY_COEFF_BITS == 64
+#define COEFF_SAFE_DIGITS 18
+#else
+#define COEFF_SAFE_DIGITS 38
+#endif
+
+/** To jest liczba cyfr, z których każdy wykładnik mieści się w typie int. */
+#define EXP_SAFE_DIGITS 9
+
+/** To są zapisy liczb od 0 do 99 dwiema cyframi, do formatowania liczb. */
+static const char digitPairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233"
+    "34353637383940414243444546474849505152535455565758596061626364656667"
+    "6869707172737475767778798081828384858687888990919293949596979899";
+
+/**
+ * Sprawdza, czy znak jest cyfrą dziesiętną.
+ * @param[in] c : znak
+ * @return czy znak jest cyfrą
+ */
+static inline bool IsDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+/**
+ * Liczy cyfry na początku napisu, nie więcej niż @p limit.
+ * @param[in] pos : początek napisu
+ * @param[in] end : koniec napisu
+ * @param[in] limit : największy potrzebny wynik
+ * @return liczba początkowych cyfr albo @p limit
+ */
+static inline size_t DigitRun(const char *pos, const char *end, size_t limit) {
+  size_t n = 0;
+  while (n < limit && pos + n != end && IsDigit(pos[n]))
+    n++;
+  return n;
+}
+
+/**
+ * Zamienia osiem cyfr na liczbę bez pętli (SWAR): cyfry są wczytywane jako
+ * jedna liczba 64-bitowa, a trzy mnożenia łączą kolejno pary cyfr, pary
+ * par i czwórki. Wymaga kolejności bajtów little-endian.
+ * @param[in] digits : osiem cyfr
+ * @return liczba zapisana cyframi
+ */
+static inline uint64_t EightDigits(const char *digits) {
+  uint64_t v;
+  memcpy(&v, digits, sizeof(v));
+  v -= 0x3030303030303030;
+  v = v * 10 + (v >> 8);
+  v = ((v & 0x000000FF000000FF) * (100 + (1000000ULL << 32)) +
+       ((v >> 16) & 0x000000FF000000FF) * (1 + (10000ULL << 32))) >> 32;
+  return v;
+}
+
+/**
+ * Zamienia ciąg cyfr na liczbę bez sprawdzania przepełnienia, po osiem
+ * cyfr naraz, jeśli to możliwe.
+ * @param[in] digits : cyfry
+ * @param[in] n : liczba cyfr, nie większa niż COEFF_SAFE_DIGITS
+ * @return liczba zapisana cyframi
+ */
+static inline poly_coeff_t DigitsValue(const char *digits, size_t n) {
+  poly_coeff_t v = 0;
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  for (; n >= 8; n -= 8, digits += 8)
+    v = v * 100000000 + (poly_coeff_t) EightDigits(digits);
+#endif
+  for (; n > 0; n--, digits++)
+    v = v * 10 + (*digits - '0');
+  return v;
+}
+
+/**
+ * Dopisuje cyfrę do liczby gromadzonej ujemnie, bo zakres liczb ujemnych
+ * jest większy.
+ * @param[in,out] v : liczba ze znakiem minus
+ * @param[in] digit : cyfra
+ * @return czy liczba się przepełniła
+ */
+static inline bool AppendDigit(poly_coeff_t *v, char digit) {
+  return __builtin_mul_overflow(*v, 10, v) |
+         __builtin_sub_overflow(*v, digit - '0', v);
+}
+
+/**
+ * Wczytuje liczbę typu poly_coeff_t z opcjonalnym znakiem, nie czytając
+ * znaków od @p end. Jeśli nie ma cyfr, nie przesuwa @p pos.
+ * @param[in,out] pos : bieżący znak; po wywołaniu pierwszy znak za liczbą
+ * @param[in] end : koniec napisu
+ * @param[out] value : wczytana liczba
+ * @return czy liczba mieści się w typie poly_coeff_t
+ */
+static bool ScanCoeff(const char **pos, const char *end, poly_coeff_t *value) {
+  const char *p = *pos;
+  bool negative = p != end && *p == '-';
+  if (p != end && (*p == '-' || *p == '+'))
+    p++;
+  if (p == end || !IsDigit(*p)) {
+    *value = 0;
+    return true;
+  }
+
+  /* Liczby, które na pewno się mieszczą, zamieniamy bez sprawdzania. */
+  poly_coeff_t v = 0;
+  bool overflow = false;
+  size_t run = DigitRun(p, end, COEFF_SAFE_DIGITS + 1);
+  if (run <= COEFF_SAFE_DIGITS) {
+    v = -DigitsValue(p, run);
+    p += run;
+  }
+  for (; p != end && IsDigit(*p); p++)
+    overflow |= AppendDigit(&v, *p);
+  if (!negative)
+    overflow |= __builtin_mul_overflow(v, -1, &v);
+
+  *pos = p;
+  *value = v;
+  return !overflow;
+}
+
+poly_coeff_t ParseCoeff(const char *str, char **endPtr) {
+  const char *pos = str;
+  poly_coeff_t value;
+  bool inRange = ScanCoeff(&pos, str + strlen(str), &value);
+  *endPtr = (char *) pos;
+  if (!inRange) {
+    errno = ERANGE;
+    return *str == '-' ? POLY_COEFF_MIN : POLY_COEFF_MAX;
+  }
+  return value;
+}
+
+/**
+ * Zapisuje liczbę cyframi, od końca bufora, po dwie cyfry naraz.
+ * @param[in] v : liczba
+ * @param[in] end : koniec bufora
+ * @return wskaźnik na pierwszą cyfrę
+ */
+static char *FormatDigits(uint64_t v, char *end) {
+  while (v >= 100) {
+    end -= 2;
+    memcpy(end, digitPairs + 2 * (v % 100), 2);
+    v /= 100;
+  }
+  if (v >= 10) {
+    end -= 2;
+    memcpy(end, digitPairs + 2 * v, 2);
+  }
+  else {
+    *--end = (char) ('0' + v);
+  }
+  return end;
+}
+
+size_t FormatCoeff(poly_coeff_t c, char *buffer) {
+  char digits[POLY_COEFF_CHARS];
+  char *end = digits + POLY_COEFF_CHARS;
+  /* Wartość bezwzględną liczymy z liczby ujemnej, bo jej zakres jest
+   * większy. */
+  poly_coeff_t value = c < 0 ? c : -c;
+#if POLY_COEFF_BITS == 128
+  /* Szerszy typ dzielimy przez 10^19, aż liczba zmieści się w 64 bitach.
+   * Każda odcięta część ma dokładnie 19 cyfr, łącznie z zerami wiodącymi. */
+  const poly_coeff_t part = (poly_coeff_t) 10000000000000000000ULL;
+  while (value < -(poly_coeff_t) UINT64_MAX) {
+    end -= 19;
+    memset(end, '0', 19);
+    FormatDigits((uint64_t) -(value % part), end + 19);
+    value /= part;
   }
+#endif
+  char *pos = FormatDigits((uint64_t) 0 - (uint64_t) value, end);
+  if (c < 0)
+    *--pos = '-';
 
-  /* Dzielimy napis na słowa względem znaków '_' i wpisujemy je
-   * razem z ich długością do tablicy struktur typu str_len_t. */
-  str_len_t *helperArr = calloc(monoCount, sizeof(str_len_t));
-  CHECK_PTR(helperArr);
+  size_t length = digits + POLY_COEFF_CHARS - pos;
+  memcpy(buffer, pos, length);
+  return length;
+}
+
+size_t FormatExp(poly_exp_t e, char *buffer) {
+  char digits[POLY_EXP_CHARS];
+  /* Wykładniki wyników, które przepełniły typ poly_exp_t, mogą być ujemne;
+   * wartość bezwzględną liczymy w typie bez znaku, jak w FormatCoeff. */
+  uint64_t value = e < 0 ? (uint64_t) 0 - (uint64_t) e : (uint64_t) e;
+  char *pos = FormatDigits(value, digits + POLY_EXP_CHARS);
+  if (e < 0)
+    *--pos = '-';
+  size_t length = digits + POLY_EXP_CHARS - pos;
+  memcpy(buffer, pos, length);
+  return length;
+}
 
-  char *monoStr = strtok(str, "_");
-  size_t i = 0;
-  while (monoStr != NULL) {
-    helperArr[i].str = monoStr;
-    helperArr[i].length = strlen(monoStr) + 1;
+/**
+ * Otwiera nową sumę jednomianów.
+ * @param[in,out] p : parser
+ * @return czy zagłębienie nie przekroczyło POLY_MAX_DEPTH
+ */
+static bool ParserOpen(PolyParser *p) {
+  if (p->depth == POLY_MAX_DEPTH)
+    return false;
+  if (p->depth == p->startSize) {
+    p->startSize = p->startSize == 0 ? PARSER_INITIAL_SIZE : 2 * p->startSize;
+    p->starts = realloc(p->starts, p->startSize * sizeof(size_t));
+    CHECK_PTR(p->starts);
+  }
+  p->starts[p->depth++] = p->monoCount;
+  return true;
+}
 
-    monoStr = strtok(NULL, "_");
-    i++;
+/**
+ * Kończy jednomian najgłębszej otwartej sumy, przejmując wielomian
+ * @p value jako jego współczynnik.
+ * @param[in,out] p : parser
+ */
+static void ParserPushMono(PolyParser *p) {
+  if (p->monoCount == p->monoSize) {
+    p->monoSize = p->monoSize == 0 ? PARSER_INITIAL_SIZE : 2 * p->monoSize;
+    p->monos = realloc(p->monos, p->monoSize * sizeof(Mono));
+    CHECK_PTR(p->monos);
   }
+  p->monos[p->monoCount++] = MonoFromPoly(&p->value, (poly_exp_t) p->exp);
+  p->hasValue = false;
+}
+
+/**
+ * Zapamiętuje zakończony wielomian. Jeśli jest otwarta jakaś suma,
+ * wielomian jest współczynnikiem jej jednomianu, więc parser czeka
+ * na przecinek, a w przeciwnym razie wielomian jest wynikiem.
+ * @param[in,out] p : parser
+ * @param[in] value : wielomian
+ */
+static void ParserSetValue(PolyParser *p, Poly value) {
+  p->value = value;
+  p->hasValue = true;
+  p->state = p->depth > 0 ? PARSER_COMMA : PARSER_DONE;
+}
+
+/**
+ * Zamyka najgłębszą otwartą sumę, tworząc z jej jednomianów wielomian
+ * w postaci kanonicznej.
+ * @param[in,out] p : parser
+ */
+static void ParserClose(PolyParser *p) {
+  size_t start = p->starts[--p->depth];
+  Poly sum = PolyAddMonos(p->monoCount - start, p->monos + start);
+  p->monoCount = start;
+  ParserSetValue(p, sum);
+}
+
+/**
+ * Kończy bieżący współczynnik, sprowadzając go do współczynnika
+ * w bieżącym trybie arytmetyki (patrz PolyCoeffReduce), bo parser od razu
+ * sumuje jednomiany o równych wykładnikach.
+ * @param[in,out] p : parser
+ * @return czy współczynnik mieści się w typie poly_coeff_t
+ */
+static bool ParserFinishCoeff(PolyParser *p) {
+  if (!p->negative && __builtin_mul_overflow(p->coeff, -1, &p->coeff))
+    return false;
+  ParserSetValue(p, PolyFromCoeff(PolyCoeffReduce(p->coeff)));
+  return true;
+}
+
+/**
+ * Zapamiętuje błąd. Pamięć jest zwalniana w funkcji PolyParserFinish.
+ * @param[in,out] p : parser
+ * @param[in] offset : indeks znaku, na którym wykryto błąd
+ */
+static void ParserFail(PolyParser *p, size_t offset) {
+  p->state = PARSER_ERROR;
+  p->errOffset = offset;
+}
+
+/**
+ * Zwalnia pamięć parsera i przywraca jego stan początkowy.
+ * @param[in,out] p : parser
+ */
+static void ParserDestroy(PolyParser *p) {
+  if (p->hasValue)
+    PolyDestroy(&p->value);
+  for (size_t i = 0; i < p->monoCount; i++)
+    MonoDestroy(&p->monos[i]);
+  free(p->monos);
+  free(p->starts);
+  *p = PolyParserInit();
+}
+
+PolyParser PolyParserInit(void) {
+  return (PolyParser) {.state = PARSER_POLY, .offset = 0, .errOffset = 0,
+                       .hasValue = false, .monoCount = 0, .monoSize = 0,
+                       .monos = NULL, .depth = 0, .startSize = 0,
+                       .starts = NULL};
+}
+
+bool PolyParserFeed(PolyParser *p, const char *chunk, size_t size) {
+  const char *pos = chunk, *end = chunk + size;
+  /* Indeks znaku *pos w całym napisie. */
+#define OFFSET (p->offset + (size_t) (pos - chunk))
+
+  while (pos != end && p->state != PARSER_ERROR) {
+    char c = *pos;
+    switch (p->state) {
+      case PARSER_POLY:
+        /* Każdy nawias otwiera sumę, której pierwszy jednomian ma
+         * za współczynnik dalszą część napisu, aż do liczby. */
+        if (c == '(') {
+          if (!ParserOpen(p))
+            ParserFail(p, OFFSET);
+          pos++;
+          break;
+        }
+        p->numStart = OFFSET;
+        p->negative = c == '-';
+        p->coeff = 0;
+        if (c == '-') {
+          p->state = PARSER_SIGN;
+          pos++;
+        }
+        else if (IsDigit(c)) {
+          p->state = PARSER_COEFF;
+        }
+        else {
+          ParserFail(p, OFFSET);
+        }
+        break;
+
+      case PARSER_SIGN:
+        if (IsDigit(c))
+          p->state = PARSER_COEFF;
+        else
+          ParserFail(p, OFFSET);
+        break;
+
+      case PARSER_COEFF: {
+        /* Jeśli dotąd wczytano same zera, krótką liczbę zamieniamy bez
+         * sprawdzania przepełnienia, a długą cyfra po cyfrze. */
+        bool overflow = false;
+        size_t run = DigitRun(pos, end, COEFF_SAFE_DIGITS + 1);
+        if (p->coeff == 0 && run <= COEFF_SAFE_DIGITS) {
+          p->coeff = -DigitsValue(pos, run);
+          pos += run;
+        }
+        for (; pos != end && IsDigit(*pos); pos++)
+          overflow |= AppendDigit(&p->coeff, *pos);
+        if (overflow)
+          ParserFail(p, p->numStart);
+        else if (pos != end && !ParserFinishCoeff(p))
+          ParserFail(p, p->numStart);
+        break;
+      }
+
+      case PARSER_COMMA:
+        if (c == ',') {
+          p->state = PARSER_EXP_START;
+          p->numStart = OFFSET + 1;
+          p->exp = 0;
+          pos++;
+        }
+        else {
+          ParserFail(p, OFFSET);
+        }
+        break;
+
+      case PARSER_EXP_START:
+        if (IsDigit(c))
+          p->state = PARSER_EXP;
+        else
+          ParserFail(p, OFFSET);
+        break;
 
-  Mono *monos = calloc(monoCount, sizeof(Mono));
-  CHECK_PTR(monos);
+      case PARSER_EXP: {
+        size_t run = DigitRun(pos, end, EXP_SAFE_DIGITS + 1);
+        if (p->exp == 0 && run <= EXP_SAFE_DIGITS) {
+          p->exp = (long long) DigitsValue(pos, run);
+          pos += run;
+        }
+        for (; pos != end && IsDigit(*pos) && p->exp <= INT_MAX; pos++)
+          p->exp = 10 * p->exp + (*pos - '0');
+        if (p->exp > INT_MAX) {
+          ParserFail(p, p->numStart);
+        }
+        else if (pos != end) {
+          if (*pos != ')') {
+            ParserFail(p, OFFSET);
+            break;
+          }
+          ParserPushMono(p);
+          p->state = PARSER_MONO_END;
+          pos++;
+        }
+        break;
+      }
 
-  /* Parsujemy każdy jednomian i wpisujemy go do tablicy monos.
-   * Jeśli parsowanie któregoś jednomianu się nie udało, zwalniamy
-   * zaalokowaną pamięć i zwracamy ERR_POLY. */
-  for (i = 0; i < (size_t) monoCount; i++) {
-    monos[i] = ParseMono(helperArr[i].str, helperArr[i].length);
+      case PARSER_MONO_END:
+        /* Po plusie zaczyna się kolejny jednomian tej samej sumy,
+         * a każdy inny znak kończy sumę. */
+        if (c == '+') {
+          p->state = PARSER_PLUS;
+          pos++;
+        }
+        else {
+          ParserClose(p);
+        }
+        break;
 
-    if (MonoIsErr(&monos[i])) {
-      free(helperArr);
-      free(monos);
-      return ERR_POLY;
+      case PARSER_PLUS:
+        if (c == '(') {
+          p->state = PARSER_POLY;
+          pos++;
+        }
+        else {
+          ParserFail(p, OFFSET);
+        }
+        break;
+
+      default:
+        ParserFail(p, OFFSET);
+        break;
     }
   }
 
-  /* Wywołujemy PolyAddMonos na tablicy monos, zwalniamy zaalokowaną
-   * pamięć i zwracamy wynikowy wielomian. */
-  Poly result = PolyAddMonos(monoCount, monos);
-  free(helperArr);
-  free(monos);
+#undef OFFSET
+  p->offset += size;
+  return p->state != PARSER_ERROR;
+}
+
+bool PolyParserFinish(PolyParser *p, Poly *result, size_t *errOffset) {
+  /* Koniec napisu kończy liczbę i wszystkie sumy, po których nie ma plusa. */
+  if (p->state == PARSER_COEFF && !ParserFinishCoeff(p))
+    ParserFail(p, p->numStart);
+  while (p->state == PARSER_MONO_END)
+    ParserClose(p);
+
+  bool ok = p->state == PARSER_DONE;
+  if (ok) {
+    *result = p->value;
+    p->hasValue = false;
+  }
+  else if (errOffset != NULL) {
+    *errOffset = p->state == PARSER_ERROR ? p->errOffset : p->offset;
+  }
+
+  ParserDestroy(p);
+  return ok;
+}
+
+Poly ParsePoly(const char *str, size_t size, size_t *errOffset) {
+  if (size > 0 && str[size - 1] == '\n')
+    size--;
+
+  PolyParser parser = PolyParserInit();
+  PolyParserFeed(&parser, str, size);
+  Poly result;
+  if (!PolyParserFinish(&parser, &result, errOffset))
+    return ERR_POLY;
   return result;
 }
 
 /**
- * Funkcja pomocnicza, wywoływana przez ParsePolyHelper, która parsuje
- * kawałek napisu będący jednomianem. Jeśli napis nie jest poprawnym
- * jednomianem, zwracane jest ERR_MONO.
+ * To jest struktura przechowująca zadanie jednego wątku funkcji
+ * ParsePolyParallel. Kolejne fazy używają różnych pól.
+ */
+typedef struct ParseTask {
+  const char *str; ///< cały napis
+  size_t begin; ///< początek fragmentu napisu
+  size_t end; ///< koniec fragmentu napisu
+  long depth; ///< zmiana zagłębienia nawiasów we fragmencie albo zagłębienie
+              ///< na jego początku
+  size_t cut; ///< indeks pierwszego plusa zewnętrznej sumy albo SIZE_MAX
+  bool ok; ///< czy fragment jest poprawną sumą jednomianów
+  size_t monoCount; ///< liczba sparsowanych jednomianów
+  Mono *monos; ///< sparsowane jednomiany
+} ParseTask;
+
+/** To jest liczba znaków klasyfikowanych razem przez ClassifyBlock. */
+#define SCAN_BLOCK 64
+
+/**
+ * To jest struktura opisująca klasy znaków bloku SCAN_BLOCK znaków napisu.
+ * Bit @f$i@f$ każdej maski odpowiada znakowi @f$i@f$ bloku. Nawiasy i plusy
+ * są jedynymi znakami potrzebnymi do wyznaczenia zagłębienia i granic
+ * jednomianów, więc przejście po ustawionych bitach ich masek pomija
+ * cyfry i przecinki.
+ */
+typedef struct CharMasks {
+  uint64_t open; ///< nawiasy otwierające
+  uint64_t close; ///< nawiasy zamykające
+  uint64_t plus; ///< plusy
+  uint64_t invalid; ///< znaki, które nie mogą wystąpić w wielomianie
+} CharMasks;
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#ifdef __AVX2__
+/** To jest typ wektora znaków. */
+typedef __m256i CharLane;
+/** To jest liczba znaków wektora. */
+#define LANE_SIZE 32
+/** Wczytuje wektor znaków spod adresu @p p. */
+#define LaneLoad(p) _mm256_loadu_si256((const __m256i *) (p))
+/** Tworzy wektor, którego każdy znak to @p c. */
+#define LaneSet(c) _mm256_set1_epi8(c)
+/** Porównuje wektory znak po znaku. */
+#define LaneEq(a, b) _mm256_cmpeq_epi8(a, b)
+/** Liczy alternatywę bitową wektorów. */
+#define LaneOr(a, b) _mm256_or_si256(a, b)
+/** Odejmuje wektory znak po znaku. */
+#define LaneSub(a, b) _mm256_sub_epi8(a, b)
+/** Liczy minimum wektorów znak po znaku, bez znaku. */
+#define LaneMin(a, b) _mm256_min_epu8(a, b)
+/** Zbiera najstarsze bity znaków wektora w maskę. */
+#define LaneMask(v) ((uint64_t) (uint32_t) _mm256_movemask_epi8(v))
+#else
+/** To jest typ wektora znaków. */
+typedef __m128i CharLane;
+/** To jest liczba znaków wektora. */
+#define LANE_SIZE 16
+/** Wczytuje wektor znaków spod adresu @p p. */
+#define LaneLoad(p) _mm_loadu_si128((const __m128i *) (p))
+/** Tworzy wektor, którego każdy znak to @p c. */
+#define LaneSet(c) _mm_set1_epi8(c)
+/** Porównuje wektory znak po znaku. */
+#define LaneEq(a, b) _mm_cmpeq_epi8(a, b)
+/** Liczy alternatywę bitową wektorów. */
+#define LaneOr(a, b) _mm_or_si128(a, b)
+/** Odejmuje wektory znak po znaku. */
+#define LaneSub(a, b) _mm_sub_epi8(a, b)
+/** Liczy minimum wektorów znak po znaku, bez znaku. */
+#define LaneMin(a, b) _mm_min_epu8(a, b)
+/** Zbiera najstarsze bity znaków wektora w maskę. */
+#define LaneMask(v) ((uint64_t) (uint16_t) _mm_movemask_epi8(v))
+#endif
+
+/**
+ * Klasyfikuje SCAN_BLOCK znaków wektorowo, porównując cały wektor
+ * znaków z każdą klasą naraz. Cyfry to znaki, których różnica z '0'
+ * bez znaku nie przekracza 9.
+ * @param[in] block : blok znaków
+ * @return maski klas znaków
+ */
+static inline CharMasks ClassifyBlock(const char *block) {
+  CharMasks m = {.open = 0, .close = 0, .plus = 0, .invalid = 0};
+  for (unsigned i = 0; i < SCAN_BLOCK; i += LANE_SIZE) {
+    CharLane c = LaneLoad(block + i);
+    CharLane open = LaneEq(c, LaneSet('('));
+    CharLane close = LaneEq(c, LaneSet(')'));
+    CharLane plus = LaneEq(c, LaneSet('+'));
+    CharLane digit = LaneSub(c, LaneSet('0'));
+    digit = LaneEq(LaneMin(digit, LaneSet(9)), digit);
+    CharLane valid = LaneOr(LaneOr(open, close), LaneOr(plus, digit));
+    valid = LaneOr(valid, LaneOr(LaneEq(c, LaneSet(',')),
+                                 LaneEq(c, LaneSet('-'))));
+    m.open |= LaneMask(open) << i;
+    m.close |= LaneMask(close) << i;
+    m.plus |= LaneMask(plus) << i;
+    m.invalid |= (~LaneMask(valid) & (((uint64_t) 1 << LANE_SIZE) - 1)) << i;
+  }
+  return m;
+}
+#else
+/**
+ * Klasyfikuje SCAN_BLOCK znaków, gdy procesor nie ma instrukcji
+ * wektorowych.
+ * @param[in] block : blok znaków
+ * @return maski klas znaków
+ */
+static inline CharMasks ClassifyBlock(const char *block) {
+  CharMasks m = {.open = 0, .close = 0, .plus = 0, .invalid = 0};
+  for (unsigned i = 0; i < SCAN_BLOCK; i++) {
+    char c = block[i];
+    m.open |= (uint64_t) (c == '(') << i;
+    m.close |= (uint64_t) (c == ')') << i;
+    m.plus |= (uint64_t) (c == '+') << i;
+    m.invalid |= (uint64_t) !(IsDigit(c) || c == '(' || c == ')' ||
+                              c == '+' || c == ',' || c == '-') << i;
+  }
+  return m;
+}
+#endif
+
+/**
+ * Klasyfikuje blok zaczynający się od znaku @p pos fragmentu. Ostatni,
+ * niepełny blok jest dopełniany przecinkami, które nie należą do żadnej
+ * z wyznaczanych klas.
  * @param[in] str : napis
- * @param[in] size : długość napisu
- * @return sparsowany jednomian
- */
-static Mono ParseMono(char *str, size_t size) {
-  /* Sprawdzamy czy napis nie jest pusty i czy zaczyna się i kończy nawiasami. */
-  if (str == NULL || str[0] != '(' || str[size - 2] != ')')
-    return ERR_MONO;
-
-  /* Modyfikujemy lekko nasz napis, usuwając nawiasy i przesuwając
-   * wskaźnik o jeden do przodu. */
-  str[0] = '\0';
-  str[size - 2] = '\0';
-  str++;
-
-  /* Szukamy od końca, na której pozycji znajduje się przecinek. */
-  size_t commaIndex = 0;
-  for (size_t i = size - 2; i > 0; i--) {
-    if (str[i] == ',') {
-      commaIndex = i;
-      break;
+ * @param[in] pos : indeks pierwszego znaku bloku
+ * @param[in] end : koniec fragmentu
+ * @return maski klas znaków
+ */
+static CharMasks ClassifyAt(const char *str, size_t pos, size_t end) {
+  if (end - pos >= SCAN_BLOCK)
+    return ClassifyBlock(str + pos);
+  char block[SCAN_BLOCK];
+  memset(block, ',', SCAN_BLOCK);
+  memcpy(block, str + pos, end - pos);
+  return ClassifyBlock(block);
+}
+
+/**
+ * Liczy zmianę zagłębienia nawiasów we fragmencie napisu jako różnicę
+ * liczby bitów masek nawiasów i sprawdza, czy fragment zawiera tylko
+ * znaki dozwolone w wielomianie.
+ * @param[in,out] arg : zadanie
+ * @return 0
+ */
+static int ParseDepthWorker(void *arg) {
+  ParseTask *task = arg;
+  long depth = 0;
+  uint64_t invalid = 0;
+  for (size_t i = task->begin; i < task->end; i += SCAN_BLOCK) {
+    CharMasks m = ClassifyAt(task->str, i, task->end);
+    depth += __builtin_popcountll(m.open) - __builtin_popcountll(m.close);
+    invalid |= m.invalid;
+  }
+  task->depth = depth;
+  task->ok = invalid == 0;
+  return 0;
+}
+
+/**
+ * Szuka we fragmencie napisu pierwszego plusa na zerowym zagłębieniu
+ * nawiasów, czyli plusa rozdzielającego jednomiany zewnętrznej sumy.
+ * Zagłębienie zmienia się o różnicę liczby bitów masek nawiasów, więc
+ * sprawdzane są tylko pozycje plusów, bez przechodzenia znak po znaku.
+ * @param[in,out] arg : zadanie ze znanym zagłębieniem na początku fragmentu
+ * @return 0
+ */
+static int ParseCutWorker(void *arg) {
+  ParseTask *task = arg;
+  long depth = task->depth;
+  task->cut = SIZE_MAX;
+  for (size_t i = task->begin; i < task->end; i += SCAN_BLOCK) {
+    CharMasks m = ClassifyAt(task->str, i, task->end);
+    /* Zagłębienie przed plusem to liczba nawiasów otwierających minus
+     * liczba zamykających na niższych bitach masek. */
+    for (uint64_t bits = m.plus; bits != 0; bits &= bits - 1) {
+      uint64_t below = (bits & -bits) - 1;
+      if (depth + __builtin_popcountll(m.open & below) ==
+          __builtin_popcountll(m.close & below)) {
+        task->cut = i + __builtin_ctzll(bits);
+        return 0;
+      }
+    }
+    depth += __builtin_popcountll(m.open) - __builtin_popcountll(m.close);
+  }
+  return 0;
+}
+
+/**
+ * Parsuje fragment napisu będący sumą jednomianów zewnętrznej sumy.
+ * Parser zaczyna tak, jakby przed fragmentem był już jednomian i plus,
+ * więc jednomiany nie są sumowane i sortowane, tylko przekazywane dalej.
+ * @param[in,out] arg : zadanie
+ * @return 0
+ */
+static int ParseChunkWorker(void *arg) {
+  ParseTask *task = arg;
+  PolyParser p = PolyParserInit();
+  ParserOpen(&p);
+  p.state = PARSER_PLUS;
+  PolyParserFeed(&p, task->str + task->begin, task->end - task->begin);
+
+  task->ok = p.state == PARSER_MONO_END && p.depth == 1;
+  task->monoCount = 0;
+  task->monos = NULL;
+  if (task->ok) {
+    task->monoCount = p.monoCount;
+    task->monos = p.monos;
+    p.monoCount = 0;
+    p.monos = NULL;
+  }
+  ParserDestroy(&p);
+  return 0;
+}
+
+/**
+ * Wykonuje zadania w osobnych wątkach, a pierwsze z nich w bieżącym.
+ * Jeśli wątku nie da się utworzyć, zadanie jest wykonywane w bieżącym.
+ * @param[in,out] tasks : zadania
+ * @param[in] count : liczba zadań
+ * @param[in] worker : funkcja wykonująca zadanie
+ */
+static void ParseRunTasks(ParseTask tasks[], size_t count,
+                          int (*worker)(void *)) {
+  thrd_t *threads = malloc(count * sizeof(thrd_t));
+  CHECK_PTR(threads);
+  bool *started = calloc(count, sizeof(bool));
+  CHECK_PTR(started);
+
+  for (size_t i = 1; i < count; i++)
+    started[i] = thrd_create(&threads[i], worker, &tasks[i]) == thrd_success;
+  worker(&tasks[0]);
+  for (size_t i = 1; i < count; i++) {
+    if (started[i])
+      thrd_join(threads[i], NULL);
+    else
+      worker(&tasks[i]);
+  }
+
+  free(started);
+  free(threads);
+}
+
+Poly ParsePolyParallel(const char *str, size_t size, size_t threads,
+                       size_t *errOffset) {
+  if (size > 0 && str[size - 1] == '\n')
+    size--;
+  if (threads <= 1 || size < PARSE_PARALLEL_MIN_SIZE || str[0] != '(')
+    return ParsePoly(str, size, errOffset);
+  if (threads > size / PARSE_PARALLEL_MIN_CHUNK)
+    threads = size / PARSE_PARALLEL_MIN_CHUNK;
+
+  /* Dzielimy napis na równe fragmenty i liczymy zagłębienie nawiasów
+   * na początku każdego z nich jako sumę prefiksową zmian zagłębienia. */
+  ParseTask *tasks = malloc(threads * sizeof(ParseTask));
+  CHECK_PTR(tasks);
+  for (size_t i = 0; i < threads; i++)
+    tasks[i] = (ParseTask) {.str = str, .begin = i * (size / threads),
+        .end = i + 1 == threads ? size : (i + 1) * (size / threads)};
+  ParseRunTasks(tasks, threads, ParseDepthWorker);
+  long depth = 0;
+  bool valid = true;
+  for (size_t i = 0; i < threads; i++) {
+    valid &= tasks[i].ok;
+    long delta = tasks[i].depth;
+    tasks[i].depth = depth;
+    depth += delta;
+  }
+
+  /* Napis z niedozwolonym znakiem albo niezrównoważonymi nawiasami jest
+   * błędny, więc od razu szukamy błędu jednym wątkiem. */
+  if (!valid || depth != 0) {
+    free(tasks);
+    return ParsePoly(str, size, errOffset);
+  }
+
+  /* Każdy fragment poza pierwszym przesuwamy do pierwszego plusa zewnętrznej
+   * sumy. Fragmenty bez takiego plusa dołączają do poprzednich. */
+  ParseRunTasks(tasks, threads, ParseCutWorker);
+  size_t chunks = 1;
+  for (size_t i = 1; i < threads; i++) {
+    if (tasks[i].cut == SIZE_MAX)
+      continue;
+    tasks[chunks - 1].end = tasks[i].cut;
+    tasks[chunks++] = (ParseTask) {.str = str, .begin = tasks[i].cut + 1,
+                                   .end = size};
+  }
+  tasks[chunks - 1].end = size;
+  ParseRunTasks(tasks, chunks, ParseChunkWorker);
+
+  bool ok = true;
+  size_t total = 0;
+  for (size_t i = 0; i < chunks; i++) {
+    ok &= tasks[i].ok;
+    total += tasks[i].monoCount;
+  }
+
+  Mono *monos = NULL;
+  if (ok) {
+    monos = malloc(total * sizeof(Mono));
+    CHECK_PTR(monos);
+  }
+  for (size_t i = 0, pos = 0; i < chunks; i++) {
+    for (size_t j = 0; j < tasks[i].monoCount; j++) {
+      if (ok)
+        monos[pos++] = tasks[i].monos[j];
+      else
+        MonoDestroy(&tasks[i].monos[j]);
     }
+    free(tasks[i].monos);
   }
-  /* Jeśli nie znaleziono przecinka, to zwracamy ERR_MONO. */
-  if (commaIndex == 0)
-    return ERR_MONO;
-
-  /* Parsujemy napis znajdujący się po przecinku, który powinien
-   * zawierać wykładnik jednomianu. Jeśli napis nie zawiera liczby,
-   * liczba ta jest spoza zakresu, lub ma plus na początku to
-   * zwracamy ERR_MONO. */
-  char *endPtr = NULL;
-  char *expStr = str + commaIndex + 1;
-  errno = 0;
-  long exp = strtol(expStr, &endPtr, 10);
-  if (expStr[0] == '+' || *endPtr != '\0' ||
-      errno == ERANGE || exp < 0 || exp > INT_MAX)
-    return ERR_MONO;
-
-  /* Wstawiamy znak zerowy zamiast przecinka. */
-  str[commaIndex] = '\0';
-
-  /* Wywołujemy ParsePolyHelper na pozostałym napisie i jeśli nie jest błędny,
-   * to zwracamy jednomian utworzony z tego wielomianu i wyznaczonego
-   * wyżej wykładnika. */
-  Poly p = ParsePolyHelper(str, commaIndex + 1);
-  if (PolyIsErr(&p))
-    return ERR_MONO;
-
-  return MonoFromPoly(&p, exp);
-}
-
-Poly ParsePoly(char *str, size_t size) {
-  /* Sprawdzamy, czy napis zawiera tylko znaki ze zbioru
-   * znaków dopuszczalnych w wielomianie i przy okazji
-   * obliczamy długość napisu. */
-  size_t i = 0;
-  while (str[i] != '\n' && i != size) {
-    if (!IsCorrectPolyChar(str[i]))
-      return ERR_POLY;
-    i++;
-  }
-
-  /* Pozbywamy się znaku nowej linii z końca napisu. */
-  str[i] = '\0';
-
-  return ParsePolyHelper(str, i);
-}
\ No newline at end of file
+  free(tasks);
+
+  /* Jednomiany wszystkich fragmentów łączymy jednym sumowaniem. Błędny
+   * napis parsujemy jeszcze raz, aby wskazać pierwszy błędny znak. */
+  if (!ok)
+    return ParsePoly(str, size, errOffset);
+  Poly result = PolyAddMonos(total, monos);
+  free(monos);
+  return result;
+}
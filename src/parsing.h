@@ -1,5 +1,6 @@
 /** @file
  * Interfejs funkcji parsujących wielomiany rzadkie wielu zmiennych
+ * oraz zamieniających ich współczynniki i wykładniki na napisy
  *
  * @author Filip Głębocki <fg429202@students.mimuw.edu.pl>
  * @copyright Uniwersytet Warszawski
@@ -14,33 +15,150 @@
 #include <errno.h>
 #include <limits.h>
 
-/** To jest struktura przechowująca napis i jego długość. */
-typedef struct str_len_t {
-  /** To jest przechowywany napis. */
-  char *str;
-  /** To jest długość napisu. */
-  size_t length;
-} str_len_t;
+/**
+ * Parsuje zapisaną dziesiętnie liczbę typu poly_coeff_t z opcjonalnym
+ * znakiem, tak jak funkcja strtol dla typu long. Jeśli liczba jest spoza
+ * zakresu, ustawia errno na ERANGE i zwraca POLY_COEFF_MIN
+ * lub POLY_COEFF_MAX.
+ * @param[in] str : napis
+ * @param[out] endPtr : wskaźnik na pierwszy nieprzetworzony znak; jeśli
+ * napis nie zaczyna się liczbą, równy @p str
+ * @return sparsowana liczba albo 0, jeśli napis nie zaczyna się liczbą
+ */
+poly_coeff_t ParseCoeff(const char *str, char **endPtr);
+
+/** To jest największa liczba znaków zapisu dziesiętnego współczynnika. */
+#define POLY_COEFF_CHARS 41
+
+/**
+ * To jest największa liczba znaków zapisu dziesiętnego wykładnika,
+ * łącznie ze znakiem minus.
+ */
+#define POLY_EXP_CHARS 11
+
+/**
+ * Zapisuje współczynnik dziesiętnie, bez kończącego znaku '\0'. Cyfry są
+ * wyznaczane parami, z tablicy zapisów liczb od 0 do 99, więc liczba
+ * dzieleń jest o połowę mniejsza niż przy wyznaczaniu kolejnych cyfr.
+ * @param[in] c : współczynnik
+ * @param[out] buffer : bufor na co najmniej POLY_COEFF_CHARS znaków
+ * @return liczba zapisanych znaków
+ */
+size_t FormatCoeff(poly_coeff_t c, char *buffer);
+
+/**
+ * Zapisuje wykładnik dziesiętnie, tak jak funkcja FormatCoeff.
+ * @param[in] e : wykładnik
+ * @param[out] buffer : bufor na co najmniej POLY_EXP_CHARS znaków
+ * @return liczba zapisanych znaków
+ */
+size_t FormatExp(poly_exp_t e, char *buffer);
+
+/**
+ * To jest typ wyliczeniowy opisujący, czego parser wielomianów oczekuje
+ * w następnym znaku.
+ */
+typedef enum PolyParserState {
+  PARSER_POLY, ///< początku wielomianu: nawiasu otwierającego albo liczby
+  PARSER_SIGN, ///< pierwszej cyfry liczby ujemnej
+  PARSER_COEFF, ///< kolejnej cyfry współczynnika
+  PARSER_COMMA, ///< przecinka po współczynniku jednomianu
+  PARSER_EXP_START, ///< pierwszej cyfry wykładnika
+  PARSER_EXP, ///< kolejnej cyfry wykładnika albo nawiasu zamykającego
+  PARSER_MONO_END, ///< plusa albo końca sumy jednomianów
+  PARSER_PLUS, ///< nawiasu otwierającego jednomian po plusie
+  PARSER_DONE, ///< końca napisu, bo wielomian jest już kompletny
+  PARSER_ERROR ///< niczego, bo wykryto błąd
+} PolyParserState;
 
 /**
- * Sprawdza, czy znak należy do zbioru poprawnych znaków dopuszczalnych
- * w parsowanym wielomianie.
- * @param[in] c : znak
- * @return czy znak jest poprawny
+ * To jest struktura przechowująca stan przyrostowego parsera wielomianów.
+ * Napis może być podawany w dowolnych kawałkach, a stan, łącznie
+ * z niedokończoną liczbą, przechodzi między nimi. Zamiast rekurencji parser
+ * trzyma stos otwartych sum jednomianów: dla każdej z nich pamięta indeks
+ * jej pierwszego jednomianu na wspólnym stosie jednomianów. Zamknięcie sumy
+ * zamienia jej jednomiany w wielomian w postaci kanonicznej, który staje się
+ * współczynnikiem jednomianu sumy o jeden poziom płytszej, więc w pamięci
+ * jest tylko budowany wielomian, a nie jego zapis.
  */
-static inline bool IsCorrectPolyChar(char c) {
-  return (c >= '0' && c <= '9') ||
-         c == '(' || c == ')' || c == ',' || c == '+' || c == '-';
-}
+typedef struct PolyParser {
+  PolyParserState state; ///< czego parser oczekuje
+  size_t offset; ///< liczba znaków we wcześniejszych kawałkach
+  size_t errOffset; ///< indeks znaku, na którym wykryto błąd
+  size_t numStart; ///< indeks pierwszego znaku bieżącej liczby
+  bool negative; ///< czy bieżąca liczba ma minus
+  poly_coeff_t coeff; ///< bieżący współczynnik ze znakiem minus
+  long long exp; ///< bieżący wykładnik
+  bool hasValue; ///< czy parser przechowuje wielomian @p value
+  Poly value; ///< współczynnik bieżącego jednomianu albo cały wynik
+  size_t monoCount; ///< liczba jednomianów na stosie
+  size_t monoSize; ///< pojemność stosu jednomianów
+  Mono *monos; ///< jednomiany otwartych sum
+  size_t depth; ///< liczba otwartych sum
+  size_t startSize; ///< pojemność tablicy @p starts
+  size_t *starts; ///< indeks pierwszego jednomianu każdej otwartej sumy
+} PolyParser;
+
+/**
+ * Inicjuje parser przed pierwszym kawałkiem napisu.
+ * @return parser
+ */
+PolyParser PolyParserInit(void);
+
+/**
+ * Przetwarza kolejny kawałek napisu. Kawałek może się kończyć w dowolnym
+ * miejscu, także w środku liczby. Każdy znak jest czytany raz.
+ * @param[in,out] p : parser
+ * @param[in] chunk : kawałek napisu
+ * @param[in] size : długość kawałka
+ * @return czy dotychczas wczytany napis może być początkiem poprawnego
+ * wielomianu; po błędzie kolejne kawałki są pomijane
+ */
+bool PolyParserFeed(PolyParser *p, const char *chunk, size_t size);
+
+/**
+ * Kończy parsowanie i zwalnia pamięć parsera.
+ * @param[in,out] p : parser
+ * @param[out] result : sparsowany wielomian, jeśli napis był poprawny
+ * @param[out] errOffset : jeśli nie jest NULL, to w razie błędu dostaje
+ * indeks pierwszego znaku, którym nie może być kontynuowany poprawny
+ * wielomian (długość napisu, jeśli napis kończy się przedwcześnie)
+ * @return czy napis był poprawnym wielomianem
+ */
+bool PolyParserFinish(PolyParser *p, Poly *result, size_t *errOffset);
 
 /**
  * Parsuje napis, zwracając wielomian. Jeśli napis nie jest
- * poprawnym wielomianem, zwracane jest ERR_POLY. Sama ta funkcja
- * sprawdza na początek istotne warunki, a potem wywołuje ParsePolyHelper.
+ * poprawnym wielomianem, zwracane jest ERR_POLY. Napis jest czytany raz,
+ * znak po znaku, parserem przyrostowym i nie jest modyfikowany. Końcowy
+ * znak nowej linii jest pomijany. Napisy o zagłębieniu nawiasów większym
+ * niż POLY_MAX_DEPTH są odrzucane.
+ * @param[in] str : napis
+ * @param[in] size : długość napisu
+ * @param[out] errOffset : jeśli nie jest NULL, to w razie błędu dostaje
+ * indeks pierwszego znaku, którym nie może być kontynuowany poprawny
+ * wielomian (@p size, jeśli napis kończy się przedwcześnie)
+ * @return sparsowany wielomian
+ */
+Poly ParsePoly(const char *str, size_t size, size_t *errOffset);
+
+/**
+ * Parsuje napis tak jak funkcja ParsePoly, dzieląc pracę między
+ * @p threads wątków. Napis jest dzielony na równe fragmenty, a zagłębienie
+ * nawiasów na początku każdego fragmentu wyznacza równoległa suma
+ * prefiksowa. Dzięki temu każdy wątek znajduje w swoim fragmencie plus
+ * rozdzielający jednomiany zewnętrznej sumy i parsuje jednomiany od tego
+ * plusa do plusa znalezionego przez następny wątek. Jednomiany ze
+ * wszystkich wątków są na końcu łączone jednym wywołaniem PolyAddMonos.
+ * Krótkie napisy i napisy niebędące sumą jednomianów są parsowane
+ * w bieżącym wątku. Wynik i indeks błędu są takie same jak dla ParsePoly.
  * @param[in] str : napis
  * @param[in] size : długość napisu
+ * @param[in] threads : maksymalna liczba wątków
+ * @param[out] errOffset : jak dla funkcji ParsePoly
  * @return sparsowany wielomian
  */
-Poly ParsePoly(char *str, size_t size);
+Poly ParsePolyParallel(const char *str, size_t size, size_t threads,
+                       size_t *errOffset);
 
 #endif // PARSING_H
@@ -7,29 +7,321 @@
  */
 
 #include "poly.h"
+#include "builder.h"
+#include "node.h"
+#include "coeff.h"
+#include <limits.h>
+#include <stdint.h>
+#include <threads.h>
+
+/**
+ * To jest minimalna waga obu poddrzew iloczynu w PolyMulMany, przy której
+ * opłaca się liczyć je w osobnych wątkach.
+ */
+#define MUL_MANY_PARALLEL_WEIGHT 256
+
+/**
+ * To jest największy stosunek liczby możliwych wykładników wyniku do liczby
+ * iloczynów jednomianów, przy którym narzucony algorytm MUL_DENSE jest
+ * używany. Tablica sum ma tyle elementów, ile możliwych wykładników, więc
+ * dla rzadkich czynników mogłaby zająć gigabajty.
+ */
+#define MUL_DENSE_MAX_SPAN_RATIO 64
+
+/**
+ * To jest bieżąca konfiguracja wyboru algorytmu mnożenia.
+ * Domyślne progi zostały zmierzone narzędziem mul_tune.
+ */
+static PolyMulConfig mulConfig = POLY_MUL_CONFIG_DEFAULT;
+
+/**
+ * To jest lista tablic jednomianów przekazanych do zwolnienia funkcją
+ * PolyDestroyDeferred i jeszcze niezwolnionych przez PolyReclaim.
+ */
+static Mono *pendingList = NULL;
+
+/**
+ * To jest górne ograniczenie liczby węzłów i jednomianów na liście
+ * pendingList, liczonych tak jak budżet funkcji PolyReclaim.
+ */
+static size_t pendingUnits = 0;
+
+/**
+ * To jest liczba węzłów i jednomianów odłożonych od ostatniego wywołania
+ * PolyReclaim, które to wywołanie musi zwolnić niezależnie od budżetu.
+ */
+static size_t pendingDebt = 0;
+
+CoeffRing coeffRing = {.modulus = 0, .barrett = 0, .bits = 0, .exact = false};
+
+/**
+ * Dokłada tablicę jednomianów wielomianu na listę tablic do zwolnienia.
+ * Wielomian skompaktowany jest zwalniany od razu, jednym wywołaniem,
+ * a tablice z areny trafiają na listę tylko ze względu na współczynniki.
+ * @param[in,out] list : lista przepleciona przez nagłówki tablic
+ * @param[in] p : wielomian
+ */
+static void ReclaimPush(Mono **list, const Poly *p) {
+  if (PolyIsCoeff(p))
+    return;
+
+  NodeHeader *header = NodeGetHeader(p->arr);
+  if (header->kind != NODE_HEAP && header->kind != NODE_ARENA) {
+    NodeFree(p->arr);
+    return;
+  }
+
+  /* Metadane usuwanego węzła nie są już potrzebne, więc w ich miejscu
+   * zapisujemy element listy. */
+  header->link.next = *list;
+  header->link.size = p->size;
+  *list = p->arr;
+}
+
+/**
+ * Zwalnia tablice z listy, aż lista się opróżni albo wyczerpie się budżet.
+ * Zwolnienie tablicy kosztuje jeden plus liczbę jej jednomianów.
+ * @param[in,out] list : lista przepleciona przez nagłówki tablic
+ * @param[in] budget : budżet
+ * @return wykorzystana część budżetu
+ */
+static size_t ReclaimList(Mono **list, size_t budget) {
+  size_t initial = budget;
+  while (*list != NULL && budget > 0) {
+    Mono *arr = *list;
+    NodeHeader *header = NodeGetHeader(arr);
+    size_t size = header->link.size;
+    *list = header->link.next;
+
+    for (size_t i = 0; i < size; i++)
+      ReclaimPush(list, &arr[i].p);
+    NodeFree(arr);
+
+    budget -= (size < budget) ? size + 1 : budget;
+  }
+  return initial - budget;
+}
+
+/**
+ * Dodaje dwie liczby, zwracając SIZE_MAX w razie przepełnienia.
+ * @param[in] a : liczba
+ * @param[in] b : liczba
+ * @return @f$\min(a + b, SIZE\_MAX)@f$
+ */
+static inline size_t AddSaturate(size_t a, size_t b) {
+  return a > SIZE_MAX - b ? SIZE_MAX : a + b;
+}
+
+/**
+ * Odkłada wielomian do usunięcia, zaciągając dług, który następne
+ * wywołanie PolyReclaim spłaci w całości.
+ * @param[in] p : wielomian
+ * @param[in] units : górne ograniczenie liczby węzłów i jednomianów @p p
+ */
+static void DeferDestroy(Poly *p, size_t units) {
+  Mono *head = pendingList;
+  ReclaimPush(&pendingList, p);
+  if (pendingList == head)
+    return;
+
+  pendingUnits = AddSaturate(pendingUnits, units);
+  pendingDebt = AddSaturate(pendingDebt, units);
+}
 
 void PolyDestroy(Poly *p) {
+  /* Tablice czekające na zwolnienie trzymamy na liście przeplecionej
+   * przez ich nagłówki, więc nie potrzebujemy ani rekurencji, ani stosu. */
+  Mono *list = NULL;
+  ReclaimPush(&list, p);
+  ReclaimList(&list, SIZE_MAX);
+}
+
+void PolyDestroyDeferred(Poly *p) {
   if (PolyIsCoeff(p))
     return;
 
-  for (size_t i = 0; i < p->size; i++) {
-    MonoDestroy(&p->arr[i]);
+  /* Każdy jednomian zawiera co najmniej jeden współczynnik liczbowy,
+   * więc na każdym z depth poziomów jest co najwyżej terms jednomianów,
+   * a tablic jest co najwyżej o jedną więcej niż jednomianów. */
+  NodeMeta *meta = NodeGetMeta(p->arr);
+  size_t monos = meta->terms > SIZE_MAX / meta->depth
+                 ? SIZE_MAX : meta->terms * meta->depth;
+  DeferDestroy(p, AddSaturate(monos, AddSaturate(monos, 1)));
+}
+
+bool PolyReclaim(size_t budget) {
+  /* Zwalniamy co najmniej tyle, ile odłożono od poprzedniego wywołania,
+   * więc odłożona pamięć nie rośnie, nawet gdy budżet jest mały. */
+  if (budget < pendingDebt)
+    budget = pendingDebt;
+  pendingDebt = 0;
+
+  size_t spent = ReclaimList(&pendingList, budget);
+  pendingUnits = pendingList == NULL || spent > pendingUnits
+                 ? 0 : pendingUnits - spent;
+  return pendingList == NULL;
+}
+
+size_t PolyReclaimPending(void) {
+  return pendingUnits;
+}
+
+/**
+ * To jest struktura przechowująca stan przejścia po jednej tablicy
+ * jednomianów w iteracyjnych przejściach po drzewie wielomianu.
+ */
+typedef struct TraversalFrame {
+  const Mono *arr; ///< przeglądana tablica jednomianów
+  const Mono *other; ///< druga tablica: kopia albo porównywany wielomian
+  size_t size; ///< liczba jednomianów tablicy
+  size_t i; ///< indeks bieżącego jednomianu
+} TraversalFrame;
+
+/**
+ * Alokuje stos ramek wystarczający do przejścia po wielomianie @p p.
+ * Zagłębienie wielomianu jest znane z metadanych, więc stos nie musi rosnąć.
+ * @param[in] p : wielomian niebędący współczynnikiem
+ * @return stos ramek
+ */
+static TraversalFrame *TraversalAlloc(const Poly *p) {
+  TraversalFrame *stack = malloc(PolyDepth(p) * sizeof(TraversalFrame));
+  CHECK_PTR(stack);
+  return stack;
+}
+
+/**
+ * Alokuje tablicę jednomianów kopii wielomianu: osobno albo w bloku.
+ * @param[in,out] block : blok albo NULL
+ * @param[in] size : liczba jednomianów
+ * @return tablica jednomianów
+ */
+static Mono *CloneAlloc(NodeBlock *block, size_t size) {
+  if (block == NULL)
+    return NodeAlloc(size);
+  return NodeBlockAlloc(block, size);
+}
+
+/**
+ * Robi głęboką kopię wielomianu niebędącego współczynnikiem, układając
+ * węzły kopii w kolejności przejścia w głąb.
+ * @param[in] p : wielomian
+ * @param[in,out] block : blok, w którym umieszczamy kopię, albo NULL,
+ * jeśli każdy węzeł ma być zaalokowany osobno
+ * @return skopiowany wielomian
+ */
+static Poly PolyCloneInto(const Poly *p, NodeBlock *block) {
+  Mono *newArr = CloneAlloc(block, p->size);
+  *NodeGetMeta(newArr) = *NodeGetMeta(p->arr);
+
+  TraversalFrame *stack = TraversalAlloc(p);
+  size_t top = 0;
+  stack[top++] = (TraversalFrame) {.arr = p->arr, .other = newArr,
+                                   .size = p->size, .i = 0};
+
+  while (top > 0) {
+    TraversalFrame *frame = &stack[top - 1];
+    if (frame->i == frame->size) {
+      top--;
+      continue;
+    }
+
+    const Mono *m = &frame->arr[frame->i];
+    Mono *copy = (Mono *) &frame->other[frame->i];
+    frame->i++;
+    copy->exp = m->exp;
+    if (PolyIsCoeff(&m->p)) {
+      copy->p = m->p;
+      continue;
+    }
+
+    Mono *childArr = CloneAlloc(block, m->p.size);
+    *NodeGetMeta(childArr) = *NodeGetMeta(m->p.arr);
+    copy->p = (Poly) {.size = m->p.size, .arr = childArr};
+    stack[top++] = (TraversalFrame) {.arr = m->p.arr, .other = childArr,
+                                     .size = m->p.size, .i = 0};
   }
 
-  free(p->arr);
+  free(stack);
+  return (Poly) {.size = p->size, .arr = newArr};
 }
 
 Poly PolyClone(const Poly *p) {
   if (PolyIsCoeff(p))
     return PolyFromCoeff(p->coeff);
 
-  Mono *newArr = calloc(p->size, sizeof(Mono));
-  CHECK_PTR(newArr);
+  return PolyCloneInto(p, NULL);
+}
 
-  for (size_t i = 0; i < p->size; i++)
-    newArr[i] = MonoClone(&p->arr[i]);
+/**
+ * Kończy operację, która włączyła arenę (patrz NodeArenaEnter): kopiuje
+ * wynik z areny do zwykłej pamięci i usuwa wszystkie wielomiany tymczasowe.
+ * @param[in] outer : czy to ta operacja włączyła arenę
+ * @param[in] result : wynik operacji; jest usuwany
+ * @return wynik operacji poza areną
+ */
+static Poly ScratchFinish(bool outer, Poly *result) {
+  if (!outer)
+    return *result;
+
+  NodeArenaLeave();
+  Poly copy = PolyClone(result);
+  PolyDestroy(result);
+  NodeArenaReset();
+  return copy;
+}
 
-  return (Poly) {.size = p->size, .arr = newArr};
+void PolyScratchRelease(void) {
+  NodeArenaRelease();
+}
+
+/**
+ * Przenosi wielomian do jednego ciągłego bloku pamięci.
+ * @param[in,out] p : wielomian
+ * @param[in] deferred : czy pierwotny wielomian odłożyć do usunięcia
+ */
+static void PolyCompactWith(Poly *p, bool deferred) {
+  if (PolyIsCoeff(p) || NodeGetHeader(p->arr)->kind != NODE_HEAP)
+    return;
+
+  /* Najpierw liczymy węzły i jednomiany, aby zaalokować jeden blok. */
+  TraversalFrame *stack = TraversalAlloc(p);
+  size_t top = 0, nodes = 1, monos = 0;
+  stack[top++] = (TraversalFrame) {.arr = p->arr, .size = p->size, .i = 0};
+  while (top > 0) {
+    TraversalFrame *frame = &stack[top - 1];
+    if (frame->i == frame->size) {
+      monos += frame->size;
+      top--;
+      continue;
+    }
+
+    const Poly *child = &frame->arr[frame->i].p;
+    frame->i++;
+    if (!PolyIsCoeff(child)) {
+      nodes++;
+      stack[top++] = (TraversalFrame) {.arr = child->arr, .size = child->size,
+                                       .i = 0};
+    }
+  }
+  free(stack);
+
+  NodeBlock block = NodeBlockInit(nodes, monos);
+  Poly result = PolyCloneInto(p, &block);
+  assert(block.next == block.end);
+  /* Rozmiar drzewa już policzyliśmy, więc dług jest dokładny. */
+  if (deferred)
+    DeferDestroy(p, nodes + monos);
+  else
+    PolyDestroy(p);
+  *p = result;
+}
+
+void PolyCompact(Poly *p) {
+  PolyCompactWith(p, false);
+}
+
+void PolyCompactDeferred(Poly *p) {
+  PolyCompactWith(p, true);
 }
 
 int CompareMonos(const void *a, const void *b) {
@@ -54,10 +346,18 @@ static bool PolyIsDeepCoeff(const Poly *p) {
   if (PolyIsCoeff(p))
     return true;
 
-  if (p->size != 1)
+  /* Wielomian o więcej niż jednym współczynniku liczbowym odrzucamy od razu.
+   * Stopnia całkowitego nie używamy, bo wykładniki, które przepełniły typ
+   * poly_exp_t, mogą być ujemne, więc sprawdzamy wykładniki na ścieżce. */
+  if (NodeGetMeta(p->arr)->terms > 1)
     return false;
 
-  return (PolyIsDeepCoeff(&p->arr[0].p) && MonoGetExp(&p->arr[0]) == 0);
+  while (!PolyIsCoeff(p)) {
+    if (p->size != 1 || MonoGetExp(&p->arr[0]) != 0)
+      return false;
+    p = &p->arr[0].p;
+  }
+  return true;
 }
 
 /**
@@ -70,98 +370,136 @@ static bool PolyIsDeepCoeff(const Poly *p) {
 static poly_coeff_t PolyGetDeepCoeff(const Poly *p) {
   assert(PolyIsDeepCoeff(p));
 
-  if (PolyIsCoeff(p))
-    return p->coeff;
+  while (!PolyIsCoeff(p))
+    p = &p->arr[0].p;
 
-  return PolyGetDeepCoeff(&p->arr[0].p);
+  return p->coeff;
 }
 
-Poly PolyAdd(const Poly *p, const Poly *q) {
-  /* Sprawdzamy, czy któryś z argumentów jest wielomianem
-   * tożsamościowo równym zeru. */
-  if (PolyIsZero(p))
-    return PolyClone(q);
-  if (PolyIsZero(q))
-    return PolyClone(p);
+/**
+ * Tworzy wielomian z tablicy jednomianów posortowanej ściśle rosnąco
+ * po wykładnikach, pomijając jednomiany tożsamościowo równe zeru.
+ * Przejmuje na własność pamięć wskazywaną przez @p monos i jej zawartość.
+ * W przeciwieństwie do funkcji PolyAddMonos nie sortuje i nie kopiuje tablicy.
+ * @param[in] count : liczba jednomianów
+ * @param[in] monos : tablica jednomianów zaalokowana funkcją NodeAlloc
+ * @return wielomian będący sumą jednomianów
+ */
+static Poly PolyOwnSortedMonos(size_t count, Mono *monos) {
+  size_t newSize = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (PolyIsZero(&monos[i].p)) {
+      MonoDestroy(&monos[i]);
+      continue;
+    }
+    monos[newSize] = monos[i];
+    newSize++;
+  }
 
-  /* Sprawdzamy, czy któryś z argumentów jest wielomianem stałym. */
-  if (PolyIsCoeff(p) && PolyIsCoeff(q)) {
-    poly_coeff_t newCoeff = p->coeff + q->coeff;
-    return PolyFromCoeff(newCoeff);
+  if (newSize == 0) {
+    NodeFree(monos);
+    return PolyZero();
   }
-  if (PolyIsCoeff(p)) {
-    Mono *newArr = calloc(1, sizeof(Mono));
-    CHECK_PTR(newArr);
-    newArr[0] = (Mono) {.p = PolyFromCoeff(p->coeff), .exp = 0};
+  if (newSize < count)
+    monos = NodeRealloc(monos, newSize);
 
-    Poly newP = {.size = 1, .arr = newArr};
-    Poly result = PolyAdd(&newP, q);
-    PolyDestroy(&newP);
-    return result;
+  /* Sprawdzamy, czy wynikiem nie jest zagłębiony wielomian stały. */
+  Poly result = (Poly) {.size = newSize, .arr = monos};
+  NodeUpdateMeta(&result);
+  if (PolyIsDeepCoeff(&result)) {
+    Poly newResult = PolyFromCoeff(PolyGetDeepCoeff(&result));
+    PolyDestroy(&result);
+    return newResult;
   }
-  if (PolyIsCoeff(q)) {
-    Mono *newArr = calloc(1, sizeof(Mono));
-    CHECK_PTR(newArr);
-    newArr[0] = (Mono) {.p = PolyFromCoeff(q->coeff), .exp = 0};
+  return result;
+}
 
-    Poly newQ = {.size = 1, .arr = newArr};
-    Poly result = PolyAdd(p, &newQ);
-    PolyDestroy(&newQ);
-    return result;
+/**
+ * Funkcja pomocnicza do funkcji PolyLinComb, przyjmująca współczynniki
+ * zredukowane w bieżącym pierścieniu.
+ * @param[in] a : współczynnik @f$a@f$
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] b : współczynnik @f$b@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @return @f$a \cdot p + b \cdot q@f$
+ */
+static Poly LinCombHelper(poly_coeff_t a, const Poly *p, poly_coeff_t b,
+                          const Poly *q) {
+  /* Składnik z zerowym współczynnikiem lub zerowym wielomianem pomijamy,
+   * a samotny składnik tylko skalujemy. */
+  if (a == 0 || PolyIsZero(p)) {
+    if (b == 0 || PolyIsZero(q))
+      return PolyZero();
+    const Poly *tmpP = p;
+    p = q;
+    q = tmpP;
+    a = b;
+    b = 0;
+  }
+  if (b == 0 || PolyIsZero(q)) {
+    if (PolyIsCoeff(p))
+      return PolyFromCoeff(CoeffMul(a, p->coeff));
+    if (a == 1)
+      return PolyClone(p);
   }
 
-  size_t resultSize = p->size + q->size;
-  Mono *resultArr = calloc(resultSize, sizeof(Mono));
-  CHECK_PTR(resultArr);
+  /* Sprawdzamy, czy oba argumenty są wielomianami stałymi. */
+  if (PolyIsCoeff(p) && (b == 0 || PolyIsCoeff(q)))
+    return PolyFromCoeff(CoeffAdd(CoeffMul(a, p->coeff),
+                                  b == 0 ? 0 : CoeffMul(b, q->coeff)));
+
+  /* Współczynnik traktujemy jak wielomian cx^0, którego węzeł
+   * leży na stosie wywołań, więc nie wymaga alokacji. */
+  NodeInline lifted;
+  if (PolyIsCoeff(p)) {
+    Poly newP = NodeInlineLift(&lifted, p->coeff);
+    return LinCombHelper(a, &newP, b, q);
+  }
+  if (b != 0 && PolyIsCoeff(q)) {
+    Poly newQ = NodeInlineLift(&lifted, q->coeff);
+    return LinCombHelper(a, p, b, &newQ);
+  }
+
+  /* Wynik scalania jest posortowany, więc budujemy go od razu
+   * w docelowej tablicy, bez kopiowania i sortowania. */
+  size_t qSize = b == 0 ? 0 : q->size;
+  Mono *resultArr = NodeAlloc(p->size + qSize);
 
   /* Przechodzimy po tablicach .arr wielomianów p i q, wrzucając
-   * na przemian do tablicy resultArr jednomiany z p->arr i q->arr
+   * do tablicy resultArr przeskalowane jednomiany z p->arr i q->arr
    * tak, aby wynikowa tablica była posortowana i nie zawierała
    * dwóch jednomianów o równym wykładniku. */
   size_t pI = 0, qI = 0, i = 0;
-  while (pI < p->size && qI < q->size) {
-    Mono pMono = p->arr[pI], qMono = q->arr[qI];
-    poly_exp_t pExp = MonoGetExp(&pMono);
-    poly_exp_t qExp = MonoGetExp(&qMono);
-    if (pExp < qExp) {
-      resultArr[i] = MonoClone(&pMono);
-      i++;
+  while (pI < p->size || qI < qSize) {
+    const Mono *pMono = pI < p->size ? &p->arr[pI] : NULL;
+    const Mono *qMono = qI < qSize ? &q->arr[qI] : NULL;
+    if (qMono == NULL || (pMono != NULL && pMono->exp < qMono->exp)) {
+      resultArr[i] = (Mono) {.exp = pMono->exp,
+          .p = LinCombHelper(a, &pMono->p, 0, &pMono->p)};
+      pI++;
+    } else if (pMono == NULL || pMono->exp > qMono->exp) {
+      resultArr[i] = (Mono) {.exp = qMono->exp,
+          .p = LinCombHelper(b, &qMono->p, 0, &qMono->p)};
+      qI++;
+    } else {
+      resultArr[i] = (Mono) {.exp = pMono->exp,
+          .p = LinCombHelper(a, &pMono->p, b, &qMono->p)};
       pI++;
-      continue;
-    }
-    if (pExp > qExp) {
-      resultArr[i] = MonoClone(&qMono);
-      i++;
       qI++;
-      continue;
     }
-    /* pExp == qExp */
-    resultArr[i] = (Mono) {.exp = pExp,
-        .p = PolyAdd(&pMono.p, &qMono.p)};
     i++;
-    pI++;
-    qI++;
-    resultSize--;
-  }
-  /* Dodajemy do tablicy pozostałe jednomiany. */
-  if (pI != p->size) {
-    for (; pI < p->size; pI++) {
-      resultArr[i] = MonoClone(&p->arr[pI]);
-      i++;
-    }
-  }
-  if (qI != q->size) {
-    for (; qI < q->size; qI++) {
-      resultArr[i] = MonoClone(&q->arr[qI]);
-      i++;
-    }
   }
 
-  Poly result = PolyAddMonos(resultSize, resultArr);
+  /* Współczynniki mogły się wyzerować, np. w wyniku przepełnienia. */
+  return PolyOwnSortedMonos(i, resultArr);
+}
 
-  free(resultArr);
+Poly PolyLinComb(poly_coeff_t a, const Poly *p, poly_coeff_t b, const Poly *q) {
+  return LinCombHelper(CoeffReduce(a), p, CoeffReduce(b), q);
+}
 
-  return result;
+Poly PolyAdd(const Poly *p, const Poly *q) {
+  return PolyLinComb(1, p, 1, q);
 }
 
 Poly PolyAddMonos(size_t count, const Mono monos[]) {
@@ -198,8 +536,7 @@ Poly PolyAddMonos(size_t count, const Mono monos[]) {
    *
    * index - indeks wskazujący na odpowiednie pole w tablicy monosShort
    * sizeDiff - różnica rozmiarów tablic monosCopy i monosShort. */
-  Mono *monosShort = calloc(newSize, sizeof(Mono));
-  CHECK_PTR(monosShort);
+  Mono *monosShort = NodeAlloc(newSize);
   monosShort[0] = monosCopy[0];
   size_t index = 0;
   size_t sizeDiff = 0;
@@ -229,12 +566,13 @@ Poly PolyAddMonos(size_t count, const Mono monos[]) {
   if (newSize == 1 && PolyIsZero(&monosShort[0].p)) {
     MonoDestroy(&monosShort[0]);
     Poly result = PolyZero();
-    free(monosShort);
+    NodeFree(monosShort);
     return result;
   }
 
   /* Na koniec sprawdzamy, czy wynikiem nie jest zagłębiony wielomian stały. */
   Poly result = (Poly) {.size = newSize, .arr = monosShort};
+  NodeUpdateMeta(&result);
   if (PolyIsDeepCoeff(&result)) {
     Poly newResult = PolyFromCoeff(PolyGetDeepCoeff(&result));
     PolyDestroy(&result);
@@ -264,52 +602,27 @@ Poly PolyCloneMonos(size_t count, const Mono monos[]) {
 }
 
 Poly PolyMulCoeff(const Poly *p, poly_coeff_t c) {
-  if (PolyIsDeepCoeff(p))
-    return PolyFromCoeff(PolyGetDeepCoeff(p) * c);
-  if (c == 0)
-    return PolyZero();
-
-  Mono *newArr = calloc(p->size, sizeof(Mono));
-  CHECK_PTR(newArr);
-
-  /* Rekurencyjnie konstruujemy wielomian wynikowy. */
-  for (size_t i = 0; i < p->size; i++) {
-    Mono currentMono = p->arr[i];
-    newArr[i] = (Mono) {.p = PolyMulCoeff(&currentMono.p, c),
-        .exp = currentMono.exp};
-  }
-
-  /* Na wszelki wypadek sprawdzamy, czy wynikiem nie jest wielomian
-   * tożsamościowo równy zeru, np. w wyniku pomnożenia zbyt dużych wartości. */
-//  if (PolyIsZero(&newArr[0].p)) {
-//    for (size_t i = 0; i < p->size; i++) {
-//      MonoDestroy(&newArr[i]);
-//    }
-//    free(newArr);
-//    return PolyZero();
-//  }
-
-  //return (Poly) {.size = p->size, .arr = newArr};
-  Poly result = PolyAddMonos(p->size, newArr);
-  free(newArr);
-  return result;
+  return PolyLinComb(c, p, 0, p);
 }
 
-Poly PolyMul(const Poly *p, const Poly *q) {
-  /* Sprawdzamy, czy któryś z argumentów jest wielomianem stałym. */
-  if (PolyIsCoeff(p) && PolyIsCoeff(q))
-    return PolyFromCoeff(p->coeff * q->coeff);
-
-  if (PolyIsCoeff(p)) {
-    Poly result = PolyMulCoeff(q, p->coeff);
-    return result;
-  }
-
-  if (PolyIsCoeff(q)) {
-    Poly result = PolyMulCoeff(p, q->coeff);
-    return result;
-  }
+/**
+ * Sprawdza, czy wszystkie jednomiany wielomianu mają stałe współczynniki,
+ * czyli czy jest to wielomian jednej zmiennej.
+ * @param[in] p : wielomian niebędący współczynnikiem
+ * @return Czy @p p jest wielomianem jednej zmiennej?
+ */
+static bool PolyIsUnivariate(const Poly *p) {
+  return NodeGetMeta(p->arr)->depth == 1;
+}
 
+/**
+ * Mnoży dwa wielomiany niebędące współczynnikami, tworząc tablicę wszystkich
+ * iloczynów jednomianów i sortując ją w funkcji PolyAddMonos.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @return @f$p * q@f$
+ */
+static Poly PolyMulSort(const Poly *p, const Poly *q) {
   /* Konstruujemy tablicę jednomianów resultArr, wrzucając do niej
    * każdy jednomian postaci m_i * n_j, gdzie m_i to i-ty jednomian
    * z tablicy p->arr, a n_j to j-ty jednomian z tablicy q->arr. */
@@ -334,130 +647,931 @@ Poly PolyMul(const Poly *p, const Poly *q) {
   return result;
 }
 
-Poly PolyNeg(const Poly *p) {
-  /* Mnożymy wielomian p przez stałą -1. */
-  Poly result = PolyMulCoeff(p, -1);
-  return result;
-}
+/**
+ * To jest struktura przechowująca element kopca używanego przez funkcję
+ * PolyMulHeap. Odpowiada iloczynowi jednomianów @f$a_{row} b_{col}@f$.
+ */
+typedef struct MulHeapItem {
+  poly_exp_t exp; ///< wykładnik iloczynu, będący kluczem
+  size_t row; ///< indeks jednomianu krótszego czynnika
+  size_t col; ///< indeks jednomianu dłuższego czynnika
+} MulHeapItem;
 
-Poly PolySub(const Poly *p, const Poly *q) {
-  /* Korzystamy z prostej tożsamości p - q == p + (-1) * q. */
-  Poly qNeg = PolyNeg(q);
-  Poly result = PolyAdd(p, &qNeg);
-  PolyDestroy(&qNeg);
-  return result;
+/**
+ * Przesuwa element kopca o indeksie @p i w dół, przywracając
+ * własność kopca minimalnego.
+ * @param[in] heap : kopiec
+ * @param[in] size : liczba elementów kopca
+ * @param[in] i : indeks elementu
+ */
+static void MulHeapSiftDown(MulHeapItem heap[], size_t size, size_t i) {
+  MulHeapItem item = heap[i];
+  while (2 * i + 1 < size) {
+    size_t child = 2 * i + 1;
+    if (child + 1 < size && heap[child + 1].exp < heap[child].exp)
+      child++;
+    if (heap[child].exp >= item.exp)
+      break;
+    heap[i] = heap[child];
+    i = child;
+  }
+  heap[i] = item;
 }
 
-poly_exp_t PolyDegBy(const Poly *p, size_t varIdx) {
-  /* Sprawdzamy, czy argument p jest wielomianem stałym. */
-  if (PolyIsZero(p))
-    return -1;
-  if (PolyIsCoeff(p))
-    return 0;
-
-  /* Funkcja działa rekurencyjnie: jeśli var_idx == 0, to po prostu
-   * obliczamy stopień wielomianu. Jeśli zaś var_idx > 0, to bierzemy
-   * wartość największą ze stopni współczynników jednomianów z tablicy
-   * p->arr, wywołując funkcję rekurencyjnie i zmniejszając var_idx o 1. */
-  if (varIdx == 0) {
-    Mono firstMono = p->arr[0];
-    poly_exp_t maxExp = MonoGetExp(&firstMono);
-    if (PolyIsZero(&firstMono.p))
-      maxExp = -1;
-
-    for (size_t i = 1; i < p->size; i++) {
-      Mono currentMono = p->arr[i];
-      if (PolyIsZero(&currentMono.p))
-        continue;
-
-      if (MonoGetExp(&currentMono) > maxExp)
-        maxExp = MonoGetExp(&p->arr[i]);
+/**
+ * Mnoży dwa wielomiany niebędące współczynnikami, scalając za pomocą kopca
+ * wiersze iloczynów jednomianów krótszego czynnika z jednomianami dłuższego.
+ * Iloczyny powstają w kolejności rosnących wykładników, więc wynik nie
+ * wymaga sortowania, a kopiec ma rozmiar krótszego czynnika.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @param[in] estimate : górne ograniczenie liczby różnych wykładników wyniku
+ * @return @f$p * q@f$
+ */
+static Poly PolyMulHeap(const Poly *p, const Poly *q, size_t estimate) {
+  const Poly *a = p->size <= q->size ? p : q;
+  const Poly *b = p->size <= q->size ? q : p;
+
+  MulHeapItem *heap = calloc(a->size, sizeof(MulHeapItem));
+  CHECK_PTR(heap);
+  for (size_t i = 0; i < a->size; i++)
+    heap[i] = (MulHeapItem) {.exp = a->arr[i].exp + b->arr[0].exp,
+        .row = i, .col = 0};
+  size_t heapSize = a->size;
+
+  Mono *resultArr = NodeAlloc(estimate);
+  size_t count = 0;
+
+  while (heapSize > 0) {
+    MulHeapItem top = heap[0];
+    Poly pq = PolyMul(&a->arr[top.row].p, &b->arr[top.col].p);
+
+    if (count > 0 && resultArr[count - 1].exp == top.exp) {
+      Poly mem = resultArr[count - 1].p;
+      resultArr[count - 1].p = PolyAdd(&mem, &pq);
+      PolyDestroy(&mem);
+      PolyDestroy(&pq);
+    } else {
+      resultArr[count] = (Mono) {.p = pq, .exp = top.exp};
+      count++;
     }
 
-    return maxExp;
-  }
-
-  /* varIdx > 0 */
-  Mono firstMono = p->arr[0];
-  poly_exp_t maxExp = PolyDegBy(&firstMono.p, varIdx - 1);
-
-  for (size_t i = 1; i < p->size; i++) {
-    Mono currentMono = p->arr[i];
-    poly_exp_t CurrentMaxExp = PolyDegBy(&currentMono.p, varIdx - 1);
-    if (CurrentMaxExp > maxExp)
-      maxExp = CurrentMaxExp;
+    /* Zastępujemy iloczyn następnym iloczynem z tego samego wiersza
+     * albo, jeśli wiersz się skończył, usuwamy go z kopca. */
+    if (top.col + 1 < b->size) {
+      heap[0].col++;
+      heap[0].exp = a->arr[top.row].exp + b->arr[top.col + 1].exp;
+    } else {
+      heapSize--;
+      heap[0] = heap[heapSize];
+    }
+    MulHeapSiftDown(heap, heapSize, 0);
   }
 
-  return maxExp;
+  free(heap);
+  return PolyOwnSortedMonos(count, resultArr);
 }
 
-poly_exp_t PolyDeg(const Poly *p) {
-  /* Sprawdzamy, czy argument p jest wielomianem stałym. */
-  if (PolyIsZero(p))
-    return -1;
-  if (PolyIsCoeff(p))
-    return 0;
+/**
+ * To jest struktura przechowująca pole tablicy haszującej używanej
+ * przez funkcję PolyMulHash.
+ */
+typedef struct MulHashSlot {
+  bool used; ///< czy pole jest zajęte
+  poly_exp_t exp; ///< wykładnik, będący kluczem
+  Poly acc; ///< suma iloczynów współczynników o tym wykładniku
+} MulHashSlot;
 
-  poly_exp_t maxDeg = 0;
+/**
+ * Mnoży dwa wielomiany niebędące współczynnikami, sumując iloczyny
+ * jednomianów od razu w tablicy haszującej z adresowaniem otwartym,
+ * której kluczami są wykładniki. Sortowane są jedynie różne wykładniki
+ * wyniku, a nie wszystkie iloczyny jednomianów.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @param[in] estimate : górne ograniczenie liczby różnych wykładników wyniku
+ * @return @f$p * q@f$
+ */
+static Poly PolyMulHash(const Poly *p, const Poly *q, size_t estimate) {
+  size_t tableSize = 16;
+  while (tableSize < 2 * estimate)
+    tableSize *= 2;
+  size_t mask = tableSize - 1;
 
-  /* Obliczamy stopień wielomianu p poprzez branie największej wartości
-   * z obliczanych rekurencyjnie stopni współczynników jednomianów z tablicy
-   * p->arr, pomnożonych przez wykładnik tych jednomianów. */
-  for (size_t i = 0; i < p->size; i++) {
-    Mono currentMono = p->arr[i];
+  MulHashSlot *table = calloc(tableSize, sizeof(MulHashSlot));
+  CHECK_PTR(table);
 
-    if (PolyIsZero(&currentMono.p))
-      continue;
+  size_t count = 0;
+  for (size_t pI = 0; pI < p->size; pI++) {
+    for (size_t qI = 0; qI < q->size; qI++) {
+      poly_exp_t exp = p->arr[pI].exp + q->arr[qI].exp;
+      Poly pq = PolyMul(&p->arr[pI].p, &q->arr[qI].p);
 
-    poly_exp_t currentDeg = PolyDeg(&currentMono.p) + MonoGetExp(&currentMono);
+      size_t slot = ((size_t) exp * 11400714819323198485UL) >> 32 & mask;
+      while (table[slot].used && table[slot].exp != exp)
+        slot = (slot + 1) & mask;
 
-    if (currentDeg > maxDeg)
-      maxDeg = currentDeg;
-  }
+      if (!table[slot].used) {
+        table[slot] = (MulHashSlot) {.used = true, .exp = exp, .acc = pq};
+        count++;
+        continue;
+      }
 
-  return maxDeg;
-}
+      Poly mem = table[slot].acc;
+      table[slot].acc = PolyAdd(&mem, &pq);
+      PolyDestroy(&mem);
+      PolyDestroy(&pq);
+    }
+  }
 
-bool MonoIsEq(const Mono *m, const Mono *n) {
-  if (m->exp != n->exp)
-    return false;
+  Mono *resultArr = NodeAlloc(count);
+  size_t i = 0;
+  for (size_t slot = 0; slot < tableSize; slot++) {
+    if (table[slot].used) {
+      resultArr[i] = (Mono) {.p = table[slot].acc, .exp = table[slot].exp};
+      i++;
+    }
+  }
+  free(table);
 
-  return PolyIsEq(&m->p, &n->p);
+  /* Sortujemy jedynie różne wykładniki wyniku. */
+  SortMonos(count, resultArr);
+  return PolyOwnSortedMonos(count, resultArr);
 }
 
-bool PolyIsEq(const Poly *p, const Poly *q) {
-  if (PolyIsCoeff(p) && PolyIsCoeff(q))
-    return (p->coeff == q->coeff);
-
-  if (PolyIsCoeff(p) || PolyIsCoeff(q))
-    return false;
-
-  if (p->size != q->size)
-    return false;
-
+/**
+ * Daje największy moduł współczynnika wielomianu jednej zmiennej
+ * w trybie dokładnym.
+ * @param[in] p : wielomian jednej zmiennej
+ * @return największy moduł albo -1, jeśli któryś współczynnik nie jest mały
+ */
+static poly_coeff_t DenseMaxCoeff(const Poly *p) {
+  poly_coeff_t max = 0;
   for (size_t i = 0; i < p->size; i++) {
-    Mono pMono = p->arr[i];
-    Mono qMono = q->arr[i];
-    if (!MonoIsEq(&pMono, &qMono))
-      return false;
+    poly_coeff_t c = p->arr[i].p.coeff;
+    if (!CoeffIsSmall(c))
+      return -1;
+    max = c > max ? c : -c > max ? -c : max;
   }
-
-  return true;
+  return max;
 }
 
 /**
- * Wykonuje szybkie potęgowanie liczb typu poly_coeff_t.
- * @param[in] a : liczba @f$a@f$
- * @param[in] x : liczba @f$x@f$
- * @return @f$a^x@f$
+ * Sprawdza, czy w trybie dokładnym wszystkie sumy iloczynów współczynników
+ * dwóch wielomianów jednej zmiennej są małe. Do każdej sumy trafia co
+ * najwyżej tyle iloczynów, ile jednomianów ma mniejszy z wielomianów.
+ * @param[in] p : wielomian jednej zmiennej @f$p@f$
+ * @param[in] q : wielomian jednej zmiennej @f$q@f$
+ * @return czy sumy można liczyć bez sprawdzania przepełnień
+ */
+static bool DenseSumsSmall(const Poly *p, const Poly *q) {
+  poly_coeff_t maxP = DenseMaxCoeff(p), maxQ = DenseMaxCoeff(q), bound;
+  poly_coeff_t terms = (poly_coeff_t) (p->size < q->size ? p->size : q->size);
+  return maxP >= 0 && maxQ >= 0 &&
+         !__builtin_mul_overflow(maxP, maxQ, &bound) &&
+         !__builtin_mul_overflow(bound, terms, &bound) &&
+         bound < COEFF_SMALL_LIMIT;
+}
+
+/**
+ * Mnoży dwa wielomiany jednej zmiennej, sumując iloczyny współczynników
+ * w gęstej tablicy indeksowanej wykładnikami.
+ * @param[in] p : wielomian jednej zmiennej @f$p@f$
+ * @param[in] q : wielomian jednej zmiennej @f$q@f$
+ * @param[in] span : liczba możliwych wykładników wyniku
+ * @return @f$p * q@f$
+ */
+static Poly PolyMulDense(const Poly *p, const Poly *q, size_t span) {
+  poly_exp_t minExp = p->arr[0].exp + q->arr[0].exp;
+  poly_coeff_t *acc = calloc(span, sizeof(poly_coeff_t));
+  CHECK_PTR(acc);
+
+  /* W trybie modularnym dodajemy zredukowane iloczyny do 64-bitowych sum
+   * bez redukowania ich: każda komórka dostaje mniej niż 2^32 reszt
+   * mniejszych od 2^31, więc suma się mieści także dla 32-bitowego typu
+   * poly_coeff_t, a pętla nie zawiera dzielenia ani skoków. */
+  CoeffRing ring = CoeffCurrentRing();
+  uint64_t *sums = NULL;
+  if (ring.modulus != 0) {
+    sums = calloc(span, sizeof(uint64_t));
+    CHECK_PTR(sums);
+  }
+  /* W trybie dokładnym sprawdzamy przepełnienia tylko wtedy, gdy
+   * oszacowanie sum nie wyklucza dużych współczynników. */
+  bool wrap = ring.modulus == 0 && (!ring.exact || DenseSumsSmall(p, q));
+  for (size_t pI = 0; pI < p->size; pI++) {
+    size_t offset = p->arr[pI].exp + q->arr[0].exp - minExp;
+    poly_coeff_t *row = acc + offset;
+    poly_coeff_t pCoeff = p->arr[pI].p.coeff;
+    if (wrap) {
+      /* Liczymy w typie bez znaku, w którym przepełnienie jest określone,
+       * a wynik jest taki sam jak przy przepełnieniu modulo 2^k. */
+      for (size_t qI = 0; qI < q->size; qI++) {
+        poly_coeff_t *cell = &row[q->arr[qI].exp - q->arr[0].exp];
+        *cell = (poly_coeff_t) ((coeff_acc_t) *cell + (coeff_acc_t) pCoeff *
+                                (coeff_acc_t) q->arr[qI].p.coeff);
+      }
+    } else if (ring.modulus == 0) {
+      for (size_t qI = 0; qI < q->size; qI++) {
+        poly_coeff_t *cell = &row[q->arr[qI].exp - q->arr[0].exp];
+        *cell = CoeffAdd(*cell, CoeffMul(pCoeff, q->arr[qI].p.coeff));
+      }
+    } else {
+      uint64_t *sumRow = sums + offset;
+      for (size_t qI = 0; qI < q->size; qI++)
+        sumRow[q->arr[qI].exp - q->arr[0].exp] += CoeffBarrett(&ring,
+            (uint64_t) pCoeff * (uint64_t) q->arr[qI].p.coeff);
+    }
+  }
+  if (ring.modulus != 0) {
+    for (size_t i = 0; i < span; i++)
+      acc[i] = (poly_coeff_t) (sums[i] % ring.modulus);
+    free(sums);
+  }
+
+  size_t count = 0;
+  for (size_t i = 0; i < span; i++)
+    if (acc[i] != 0)
+      count++;
+
+  if (count == 0) {
+    free(acc);
+    return PolyZero();
+  }
+
+  Mono *resultArr = NodeAlloc(count);
+  count = 0;
+  for (size_t i = 0; i < span; i++) {
+    if (acc[i] != 0) {
+      resultArr[count] = (Mono) {.p = PolyFromCoeff(acc[i]),
+          .exp = minExp + (poly_exp_t) i};
+      count++;
+    }
+  }
+  free(acc);
+
+  return PolyOwnSortedMonos(count, resultArr);
+}
+
+/**
+ * Wybiera algorytm mnożenia dwóch wielomianów niebędących współczynnikami
+ * na podstawie konfiguracji mulConfig i prostych statystyk czynników.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @param[in] products : liczba iloczynów jednomianów
+ * @param[in] span : liczba możliwych wykładników wyniku
+ * @return wybrany algorytm
+ */
+static PolyMulStrategy MulChooseStrategy(const Poly *p, const Poly *q,
+                                         size_t products, size_t span) {
+  PolyMulStrategy strategy = mulConfig.strategy;
+  if (strategy == MUL_DENSE &&
+      (!(PolyIsUnivariate(p) && PolyIsUnivariate(q)) ||
+       span / MUL_DENSE_MAX_SPAN_RATIO > products))
+    return MUL_HASH;
+  if (strategy != MUL_AUTO)
+    return strategy;
+
+  /* Liczba różnych wykładników wyniku nie przekracza ani liczby iloczynów
+   * jednomianów, ani liczby możliwych wykładników. Jeśli jest istotnie
+   * mniejsza od liczby iloczynów, to wiele z nich się zsumuje i opłaca się
+   * sumować je od razu, a nie sortować. */
+  if (span * mulConfig.denseRatio <= products &&
+      PolyIsUnivariate(p) && PolyIsUnivariate(q))
+    return MUL_DENSE;
+  if (span * mulConfig.hashRatio <= products)
+    return MUL_HASH;
+  if (products >= mulConfig.heapMinProducts)
+    return MUL_HEAP;
+  return MUL_SORT;
+}
+
+Poly PolyMul(const Poly *p, const Poly *q) {
+  /* Sprawdzamy, czy któryś z argumentów jest wielomianem stałym. */
+  if (PolyIsCoeff(p) && PolyIsCoeff(q))
+    return PolyFromCoeff(CoeffMul(p->coeff, q->coeff));
+
+  if (PolyIsCoeff(p)) {
+    Poly result = PolyMulCoeff(q, p->coeff);
+    return result;
+  }
+
+  if (PolyIsCoeff(q)) {
+    Poly result = PolyMulCoeff(p, q->coeff);
+    return result;
+  }
+
+  size_t products = p->size * q->size;
+  size_t span = (size_t) (p->arr[p->size - 1].exp - p->arr[0].exp) +
+                (size_t) (q->arr[q->size - 1].exp - q->arr[0].exp) + 1;
+  size_t estimate = span < products ? span : products;
+
+  /* Iloczyny współczynników wielomianów wielu zmiennych są wielomianami
+   * tymczasowymi, więc je alokujemy w arenie. */
+  bool outer = (!PolyIsUnivariate(p) || !PolyIsUnivariate(q)) &&
+               NodeArenaEnter();
+
+  Poly result;
+  switch (MulChooseStrategy(p, q, products, span)) {
+    case MUL_DENSE:
+      result = PolyMulDense(p, q, span);
+      break;
+    case MUL_HASH:
+      result = PolyMulHash(p, q, estimate);
+      break;
+    case MUL_HEAP:
+      result = PolyMulHeap(p, q, estimate);
+      break;
+    default:
+      result = PolyMulSort(p, q);
+      break;
+  }
+
+  return ScratchFinish(outer, &result);
+}
+
+void PolySetMulConfig(const PolyMulConfig *config) {
+  mulConfig = *config;
+}
+
+PolyMulConfig PolyGetMulConfig(void) {
+  return mulConfig;
+}
+
+bool PolySetModulus(poly_coeff_t modulus) {
+#ifdef POLY_COEFF_MODULUS
+  return modulus == POLY_COEFF_MODULUS;
+#else
+  if (modulus == 0) {
+    coeffRing = (CoeffRing) {.modulus = 0, .barrett = 0, .bits = 0,
+                             .exact = coeffRing.exact};
+    return true;
+  }
+#if POLY_COEFF_BITS > 32
+  if (modulus >= POLY_MODULUS_LIMIT)
+    return false;
+#endif
+  if (modulus < 2)
+    return false;
+
+  unsigned bits = 64 - __builtin_clzll(modulus);
+  coeffRing = (CoeffRing) {.modulus = modulus,
+      .barrett = ((uint64_t) 1 << (2 * bits)) / modulus, .bits = bits,
+      .exact = coeffRing.exact};
+  return true;
+#endif
+}
+
+void PolySetExact(bool exact) {
+  coeffRing.exact = exact;
+}
+
+bool PolyGetExact(void) {
+  return CoeffCurrentRing().exact;
+}
+
+poly_coeff_t PolyCoeffReduce(poly_coeff_t c) {
+  return CoeffReduce(c);
+}
+
+poly_coeff_t PolyGetModulus(void) {
+  return CoeffCurrentRing().modulus;
+}
+
+Poly PolyReduce(const Poly *p) {
+  if (PolyIsCoeff(p))
+    return PolyFromCoeff(CoeffReduce(p->coeff));
+
+  Mono *resultArr = NodeAlloc(p->size);
+  for (size_t i = 0; i < p->size; i++)
+    resultArr[i] = (Mono) {.p = PolyReduce(&p->arr[i].p),
+                           .exp = p->arr[i].exp};
+  return PolyOwnSortedMonos(p->size, resultArr);
+}
+
+Poly PolyAddMany(size_t n, const Poly *ps[]) {
+  /* Współczynniki sumujemy od razu, a pozostałe składniki zbieramy
+   * w tablicy inputs, w której zostawiamy miejsce na ich sumę. */
+  const Poly **inputs = malloc((n + 1) * sizeof(Poly *));
+  CHECK_PTR(inputs);
+  size_t count = 0, size = 0;
+  poly_coeff_t coeff = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (PolyIsCoeff(ps[i])) {
+      coeff = CoeffAdd(coeff, ps[i]->coeff);
+    } else {
+      inputs[count++] = ps[i];
+      size += ps[i]->size;
+    }
+  }
+
+  if (count <= 1) {
+    Poly one = PolyFromCoeff(1);
+    Poly result = count == 0 ? PolyFromCoeff(coeff)
+                             : PolyLinComb(1, inputs[0], coeff, &one);
+    free(inputs);
+    return result;
+  }
+
+  /* Sumę współczynników traktujemy jak wielomian cx^0. */
+  NodeInline lifted;
+  Poly liftedCoeff;
+  if (coeff != 0) {
+    liftedCoeff = NodeInlineLift(&lifted, coeff);
+    inputs[count++] = &liftedCoeff;
+    size++;
+  }
+
+  /* Scalamy kopcem wszystkie tablice jednomianów naraz. Jednomiany
+   * o równych wykładnikach zbieramy w tablicy group i sumujemy
+   * rekurencyjnie, również jednym scalaniem. */
+  MulHeapItem *heap = malloc(count * sizeof(MulHeapItem));
+  const Poly **group = malloc(count * sizeof(Poly *));
+  CHECK_PTR(heap);
+  CHECK_PTR(group);
+  for (size_t i = 0; i < count; i++)
+    heap[i] = (MulHeapItem) {.exp = inputs[i]->arr[0].exp, .row = i, .col = 0};
+  size_t heapSize = count;
+  for (size_t i = heapSize / 2; i-- > 0;)
+    MulHeapSiftDown(heap, heapSize, i);
+
+  Mono *resultArr = NodeAlloc(size);
+  size_t resultSize = 0;
+  while (heapSize > 0) {
+    poly_exp_t exp = heap[0].exp;
+    size_t groupSize = 0;
+    while (heapSize > 0 && heap[0].exp == exp) {
+      const Poly *input = inputs[heap[0].row];
+      group[groupSize++] = &input->arr[heap[0].col].p;
+
+      if (heap[0].col + 1 < input->size) {
+        heap[0].col++;
+        heap[0].exp = input->arr[heap[0].col].exp;
+      } else {
+        heapSize--;
+        heap[0] = heap[heapSize];
+      }
+      MulHeapSiftDown(heap, heapSize, 0);
+    }
+
+    Poly sum = groupSize == 1 ? PolyClone(group[0])
+                              : PolyAddMany(groupSize, group);
+    resultArr[resultSize++] = (Mono) {.p = sum, .exp = exp};
+  }
+
+  free(heap);
+  free(group);
+  free(inputs);
+  return PolyOwnSortedMonos(resultSize, resultArr);
+}
+
+/**
+ * To jest struktura przechowująca węzeł drzewa iloczynu budowanego przez
+ * PolyMulMany. Liście odpowiadają czynnikom, a węzły wewnętrzne iloczynom
+ * swoich poddrzew.
+ */
+typedef struct MulTreeNode {
+  const Poly *leaf; ///< czynnik w liściu albo NULL dla węzła wewnętrznego
+  size_t left; ///< indeks lewego syna węzła wewnętrznego
+  size_t right; ///< indeks prawego syna węzła wewnętrznego
+  size_t weight; ///< szacowany rozmiar iloczynu poddrzewa
+} MulTreeNode;
+
+/**
+ * To jest struktura przechowująca zadanie policzenia poddrzewa iloczynu
+ * w osobnym wątku.
+ */
+typedef struct MulTreeTask {
+  const MulTreeNode *tree; ///< drzewo iloczynu
+  size_t node; ///< indeks korzenia poddrzewa
+  size_t threads; ///< liczba wątków dostępnych dla poddrzewa
+  Poly result; ///< iloczyn poddrzewa
+} MulTreeTask;
+
+/**
+ * Porównuje wagi węzłów drzewa iloczynu na potrzeby funkcji qsort.
+ * @param[in] a : wskaźnik na węzeł
+ * @param[in] b : wskaźnik na węzeł
+ * @return wynik porównania wag
+ */
+static int MulTreeCompare(const void *a, const void *b) {
+  size_t aWeight = ((const MulTreeNode *) a)->weight;
+  size_t bWeight = ((const MulTreeNode *) b)->weight;
+  return (aWeight > bWeight) - (aWeight < bWeight);
+}
+
+static Poly MulTreeEval(const MulTreeNode tree[], size_t node, size_t threads);
+
+/**
+ * Liczy poddrzewo iloczynu opisane zadaniem, a potem zwalnia pamięć
+ * pomocniczą wątku.
+ * @param[in,out] arg : zadanie
+ * @return 0
+ */
+static int MulTreeWorker(void *arg) {
+  MulTreeTask *task = arg;
+  task->result = MulTreeEval(task->tree, task->node, task->threads);
+  PolyScratchRelease();
+  return 0;
+}
+
+/**
+ * Liczy iloczyn czynników z liści poddrzewa. Jeśli dostępnych jest kilka
+ * wątków, a oba poddrzewa są dostatecznie duże, lewe poddrzewo jest
+ * liczone w osobnym wątku.
+ * @param[in] tree : drzewo iloczynu
+ * @param[in] node : indeks korzenia poddrzewa
+ * @param[in] threads : liczba dostępnych wątków
+ * @return iloczyn poddrzewa
+ */
+static Poly MulTreeEval(const MulTreeNode tree[], size_t node, size_t threads) {
+  const MulTreeNode *n = &tree[node];
+  if (n->leaf != NULL)
+    return PolyClone(n->leaf);
+
+  const MulTreeNode *children[2] = {&tree[n->left], &tree[n->right]};
+  bool parallel = threads > 1 &&
+                  children[0]->weight >= MUL_MANY_PARALLEL_WEIGHT &&
+                  children[1]->weight >= MUL_MANY_PARALLEL_WEIGHT;
+
+  MulTreeTask task = {.tree = tree, .node = n->left,
+                      .threads = threads / 2};
+  thrd_t thread;
+  if (parallel && thrd_create(&thread, MulTreeWorker, &task) != thrd_success)
+    parallel = false;
+  if (parallel)
+    threads -= threads / 2;
+
+  /* Czynniki z liści mnożymy bez kopiowania. */
+  Poly owned[2];
+  const Poly *factors[2];
+  for (size_t i = 0; i < 2; i++) {
+    if (children[i]->leaf != NULL) {
+      factors[i] = children[i]->leaf;
+    } else if (i > 0 || !parallel) {
+      owned[i] = MulTreeEval(tree, i == 0 ? n->left : n->right, threads);
+      factors[i] = &owned[i];
+    }
+  }
+  if (parallel) {
+    thrd_join(thread, NULL);
+    owned[0] = task.result;
+    factors[0] = &owned[0];
+  }
+
+  Poly result = PolyMul(factors[0], factors[1]);
+  for (size_t i = 0; i < 2; i++)
+    if (children[i]->leaf == NULL)
+      PolyDestroy(&owned[i]);
+  return result;
+}
+
+/**
+ * Zdejmuje z czoła jednej z dwóch kolejek algorytmu Huffmana węzeł
+ * o mniejszej wadze. Pierwszą kolejką są posortowane liście, a drugą
+ * kolejno tworzone węzły wewnętrzne, których wagi nie maleją.
+ * @param[in] tree : drzewo iloczynu
+ * @param[in,out] leafI : czoło kolejki liści
+ * @param[in] leaves : liczba liści
+ * @param[in,out] innerI : czoło kolejki węzłów wewnętrznych
+ * @param[in] end : koniec kolejki węzłów wewnętrznych
+ * @return indeks zdjętego węzła
+ */
+static size_t MulTreeTake(const MulTreeNode tree[], size_t *leafI,
+                          size_t leaves, size_t *innerI, size_t end) {
+  if (*leafI < leaves &&
+      (*innerI == end || tree[*leafI].weight <= tree[*innerI].weight))
+    return (*leafI)++;
+  return (*innerI)++;
+}
+
+Poly PolyMulMany(size_t n, const Poly *ps[]) {
+  /* Współczynniki mnożymy od razu, a pozostałe czynniki stają się
+   * liśćmi drzewa, ważonymi liczbą jednomianów. */
+  MulTreeNode *tree = malloc((2 * n + 1) * sizeof(MulTreeNode));
+  CHECK_PTR(tree);
+  size_t leaves = 0;
+  poly_coeff_t coeff = 1;
+  for (size_t i = 0; i < n; i++) {
+    if (PolyIsZero(ps[i])) {
+      free(tree);
+      return PolyZero();
+    }
+    if (PolyIsCoeff(ps[i]))
+      coeff = CoeffMul(coeff, ps[i]->coeff);
+    else
+      tree[leaves++] = (MulTreeNode) {.leaf = ps[i],
+                                      .weight = PolyTermCount(ps[i])};
+  }
+
+  if (leaves == 0) {
+    free(tree);
+    return PolyFromCoeff(coeff);
+  }
+
+  /* Budujemy drzewo Huffmana: zawsze mnożymy dwa najmniejsze iloczyny,
+   * więc duże wielomiany pośrednie powstają jak najpóźniej. Wagi nowych
+   * węzłów nie maleją, więc wystarczą dwie kolejki zamiast kopca. */
+  qsort(tree, leaves, sizeof(MulTreeNode), MulTreeCompare);
+  size_t leafI = 0, innerI = leaves, end = leaves;
+  while (end < 2 * leaves - 1) {
+    size_t left = MulTreeTake(tree, &leafI, leaves, &innerI, end);
+    size_t right = MulTreeTake(tree, &leafI, leaves, &innerI, end);
+    tree[end] = (MulTreeNode) {.leaf = NULL, .left = left, .right = right,
+        .weight = tree[left].weight + tree[right].weight};
+    end++;
+  }
+
+  size_t threads = mulConfig.threads > 0 ? mulConfig.threads : 1;
+  Poly result = MulTreeEval(tree, end - 1, threads);
+  free(tree);
+
+  if (coeff != 1) {
+    Poly scaled = PolyMulCoeff(&result, coeff);
+    PolyDestroy(&result);
+    result = scaled;
+  }
+  return result;
+}
+
+/**
+ * Zastępuje wielomian jego zwykłą kopią, jeśli leży w bloku utworzonym
+ * przez PolyCompact, bo węzłów bloku nie można podmieniać pojedynczo.
+ * @param[in,out] p : wielomian
+ */
+static void PolyUnshare(Poly *p) {
+  if (PolyIsCoeff(p))
+    return;
+
+  NodeKind kind = NodeGetHeader(p->arr)->kind;
+  if (kind == NODE_BLOCK_ROOT || kind == NODE_BORROWED) {
+    Poly copy = PolyClone(p);
+    PolyDestroy(p);
+    *p = copy;
+  }
+}
+
+/**
+ * Właściwa implementacja PolyFmaInPlace dla argumentów, które nie są
+ * aliasami akumulatora.
+ * @param[in,out] acc : akumulator
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ */
+static void PolyFmaHelper(Poly *acc, const Poly *p, const Poly *q) {
+  if (PolyIsZero(p) || PolyIsZero(q))
+    return;
+
+  if (PolyIsCoeff(p) && PolyIsCoeff(q) && PolyIsCoeff(acc)) {
+    acc->coeff = CoeffAdd(acc->coeff, CoeffMul(p->coeff, q->coeff));
+    return;
+  }
+
+  /* Współczynniki traktujemy jak wielomiany cx^0, których węzły leżą
+   * na stosie wywołań. Iloczyn stałych dodajemy jako 1 * c. */
+  NodeInline liftedP, liftedQ;
+  Poly newP, newQ;
+  if (PolyIsCoeff(p) && PolyIsCoeff(q)) {
+    poly_coeff_t c = CoeffMul(p->coeff, q->coeff);
+    if (c == 0)
+      return;
+    newP = NodeInlineLift(&liftedP, c);
+    newQ = NodeInlineLift(&liftedQ, 1);
+    p = &newP;
+    q = &newQ;
+  } else if (PolyIsCoeff(p)) {
+    newP = NodeInlineLift(&liftedP, p->coeff);
+    p = &newP;
+  } else if (PolyIsCoeff(q)) {
+    newQ = NodeInlineLift(&liftedQ, q->coeff);
+    q = &newQ;
+  }
+
+  /* Jednomiany akumulatora przenosimy do nowej tablicy bez kopiowania,
+   * a współczynnik traktujemy jak jednomian o wykładniku 0. */
+  PolyUnshare(acc);
+  Mono accConst;
+  Mono *accArr = NULL;
+  size_t accSize = 0;
+  if (!PolyIsCoeff(acc)) {
+    accArr = acc->arr;
+    accSize = acc->size;
+  } else if (!PolyIsZero(acc)) {
+    accConst = (Mono) {.p = *acc, .exp = 0};
+    accArr = &accConst;
+    accSize = 1;
+  }
+
+  const Poly *a = p->size <= q->size ? p : q;
+  const Poly *b = p->size <= q->size ? q : p;
+  size_t products = a->size * b->size;
+  size_t span = (size_t) (a->arr[a->size - 1].exp - a->arr[0].exp) +
+                (size_t) (b->arr[b->size - 1].exp - b->arr[0].exp) + 1;
+  Mono *resultArr = NodeAlloc(accSize + (span < products ? span : products));
+
+  /* Iloczyny jednomianów generujemy kopcem w kolejności rosnących
+   * wykładników, jak w PolyMulHeap, i od razu scalamy je z akumulatorem.
+   * Iloczynu współczynników nie tworzymy, tylko rekurencyjnie dodajemy
+   * go do współczynnika jednomianu wyniku. */
+  MulHeapItem *heap = calloc(a->size, sizeof(MulHeapItem));
+  CHECK_PTR(heap);
+  for (size_t i = 0; i < a->size; i++)
+    heap[i] = (MulHeapItem) {.exp = a->arr[i].exp + b->arr[0].exp,
+        .row = i, .col = 0};
+  size_t heapSize = a->size;
+
+  size_t count = 0, accI = 0;
+  while (heapSize > 0) {
+    MulHeapItem top = heap[0];
+    while (accI < accSize && accArr[accI].exp < top.exp)
+      resultArr[count++] = accArr[accI++];
+
+    if (count == 0 || resultArr[count - 1].exp != top.exp) {
+      if (accI < accSize && accArr[accI].exp == top.exp)
+        resultArr[count++] = accArr[accI++];
+      else
+        resultArr[count++] = (Mono) {.p = PolyZero(), .exp = top.exp};
+    }
+    PolyFmaHelper(&resultArr[count - 1].p, &a->arr[top.row].p,
+                  &b->arr[top.col].p);
+
+    if (top.col + 1 < b->size) {
+      heap[0].col++;
+      heap[0].exp = a->arr[top.row].exp + b->arr[top.col + 1].exp;
+    } else {
+      heapSize--;
+      heap[0] = heap[heapSize];
+    }
+    MulHeapSiftDown(heap, heapSize, 0);
+  }
+  while (accI < accSize)
+    resultArr[count++] = accArr[accI++];
+
+  free(heap);
+  if (accArr != &accConst)
+    NodeFree(accArr);
+  *acc = PolyOwnSortedMonos(count, resultArr);
+}
+
+void PolyFmaInPlace(Poly *acc, const Poly *p, const Poly *q) {
+  /* Akumulator jest modyfikowany w trakcie scalania, więc argument,
+   * który jest jego aliasem, najpierw kopiujemy. */
+  Poly pCopy = PolyZero(), qCopy = PolyZero();
+  if (p == acc) {
+    pCopy = PolyClone(p);
+    p = &pCopy;
+  }
+  if (q == acc) {
+    qCopy = PolyClone(q);
+    q = &qCopy;
+  }
+
+  PolyFmaHelper(acc, p, q);
+
+  PolyDestroy(&pCopy);
+  PolyDestroy(&qCopy);
+}
+
+Poly PolyNeg(const Poly *p) {
+  return PolyLinComb(-1, p, 0, p);
+}
+
+Poly PolySub(const Poly *p, const Poly *q) {
+  /* Korzystamy z tożsamości p - q == 1 * p + (-1) * q, scalając
+   * wielomiany raz, bez tworzenia kopii -q. */
+  return PolyLinComb(1, p, -1, q);
+}
+
+poly_exp_t PolyDegBy(const Poly *p, size_t varIdx) {
+  /* Sprawdzamy, czy argument p jest wielomianem stałym. */
+  if (PolyIsZero(p))
+    return -1;
+  if (PolyIsCoeff(p))
+    return 0;
+
+  /* Stopień ze względu na zmienną główną i to, czy zmienna o indeksie
+   * varIdx w ogóle występuje w wielomianie, odczytujemy z metadanych. */
+  NodeMeta *meta = NodeGetMeta(p->arr);
+  if (varIdx == 0)
+    return meta->deg;
+  if (varIdx >= meta->depth)
+    return 0;
+
+  /* Jeśli zaś var_idx > 0, to bierzemy wartość największą ze stopni
+   * współczynników jednomianów z tablicy p->arr, wywołując funkcję
+   * rekurencyjnie i zmniejszając var_idx o 1. */
+  poly_exp_t maxExp = PolyDegBy(&p->arr[0].p, varIdx - 1);
+
+  for (size_t i = 1; i < p->size; i++) {
+    Mono currentMono = p->arr[i];
+    poly_exp_t CurrentMaxExp = PolyDegBy(&currentMono.p, varIdx - 1);
+    if (CurrentMaxExp > maxExp)
+      maxExp = CurrentMaxExp;
+  }
+
+  return maxExp;
+}
+
+poly_exp_t PolyDeg(const Poly *p) {
+  /* Sprawdzamy, czy argument p jest wielomianem stałym. */
+  if (PolyIsZero(p))
+    return -1;
+  if (PolyIsCoeff(p))
+    return 0;
+
+  return NodeGetMeta(p->arr)->totalDeg;
+}
+
+size_t PolyTermCount(const Poly *p) {
+  if (PolyIsCoeff(p))
+    return p->coeff != 0;
+
+  return NodeGetMeta(p->arr)->terms;
+}
+
+size_t PolyDepth(const Poly *p) {
+  if (PolyIsCoeff(p))
+    return 0;
+
+  return NodeGetMeta(p->arr)->depth;
+}
+
+bool MonoIsEq(const Mono *m, const Mono *n) {
+  if (m->exp != n->exp)
+    return false;
+
+  return PolyIsEq(&m->p, &n->p);
+}
+
+/**
+ * Sprawdza, czy dwa wielomiany są równe, nie schodząc do ich jednomianów.
+ * @param[in] p : wielomian
+ * @param[in] q : wielomian
+ * @return czy @p p i @p q mogą być równe; dla współczynników czy są równe
+ */
+static bool PolyIsEqShallow(const Poly *p, const Poly *q) {
+  if (PolyIsCoeff(p) && PolyIsCoeff(q))
+    return (p->coeff == q->coeff);
+
+  if (PolyIsCoeff(p) || PolyIsCoeff(q))
+    return false;
+
+  if (p->size != q->size)
+    return false;
+
+  /* Wielomiany o różnych metadanych nie mogą być równe. */
+  NodeMeta *pMeta = NodeGetMeta(p->arr), *qMeta = NodeGetMeta(q->arr);
+  return (pMeta->totalDeg == qMeta->totalDeg &&
+          pMeta->terms == qMeta->terms && pMeta->depth == qMeta->depth);
+}
+
+bool PolyIsEq(const Poly *p, const Poly *q) {
+  if (!PolyIsEqShallow(p, q))
+    return false;
+  if (PolyIsCoeff(p))
+    return true;
+
+  TraversalFrame *stack = TraversalAlloc(p);
+  size_t top = 0;
+  stack[top++] = (TraversalFrame) {.arr = p->arr, .other = q->arr,
+                                   .size = p->size, .i = 0};
+
+  bool result = true;
+  while (top > 0 && result) {
+    TraversalFrame *frame = &stack[top - 1];
+    if (frame->i == frame->size) {
+      top--;
+      continue;
+    }
+
+    const Mono *pMono = &frame->arr[frame->i];
+    const Mono *qMono = &frame->other[frame->i];
+    frame->i++;
+    if (pMono->exp != qMono->exp || !PolyIsEqShallow(&pMono->p, &qMono->p))
+      result = false;
+    else if (!PolyIsCoeff(&pMono->p))
+      stack[top++] = (TraversalFrame) {.arr = pMono->p.arr,
+                                       .other = qMono->p.arr,
+                                       .size = pMono->p.size, .i = 0};
+  }
+
+  free(stack);
+  return result;
+}
+
+/**
+ * Wykonuje szybkie potęgowanie liczb typu poly_coeff_t.
+ * @param[in] a : liczba @f$a@f$
+ * @param[in] x : liczba @f$x@f$
+ * @return @f$a^x@f$
  */
 static poly_coeff_t QuickPow(poly_coeff_t a, poly_coeff_t x) {
   if (x == 0)
     return 1;
   if (x % 2 == 1)
-    return a * QuickPow(a, x - 1);
+    return CoeffMul(a, QuickPow(a, x - 1));
   poly_coeff_t result = QuickPow(a, x / 2);
-  return result * result;
+  return CoeffMul(result, result);
 }
 
 Poly PolyAt(const Poly *p, poly_coeff_t x) {
@@ -465,48 +1579,373 @@ Poly PolyAt(const Poly *p, poly_coeff_t x) {
   if (PolyIsCoeff(p))
     return PolyFromCoeff(p->coeff);
 
-  /* Wielomian wynikowy konstruujemy poprzez przechodzenie po tablicy jednomianów
-   * p->arr i dodając do siebie ich współczynniki pomnożone przez stałą x. */
-  Mono firstMono = p->arr[0];
-  poly_coeff_t multiplier = QuickPow(x, MonoGetExp(&firstMono));
-  Poly result = PolyMulCoeff(&firstMono.p, multiplier);
-
-  for (size_t i = 1; i < p->size; i++) {
+  /* Wielomian wynikowy konstruujemy, przekazując budowniczemu współczynniki
+   * jednomianów z tablicy p->arr pomnożone przez odpowiednie potęgi x.
+   * Budowniczy łączy powtarzające się jednomiany za jednym razem, zamiast
+   * dodawać kolejne wielomiany do wyniku. */
+  x = CoeffReduce(x);
+  PolyBuilder b = PolyBuilderInit();
+  for (size_t i = 0; i < p->size; i++) {
     Mono currentMono = p->arr[i];
-    multiplier = QuickPow(x, MonoGetExp(&currentMono));
-    Poly newPoly = PolyMulCoeff(&currentMono.p, multiplier);
-
-    Poly mem = result;
-    result = PolyAdd(&result, &newPoly);
-    PolyDestroy(&mem);
-    PolyDestroy(&newPoly);
+    poly_coeff_t multiplier = QuickPow(x, MonoGetExp(&currentMono));
+    PolyBuilderAddScaled(&b, &currentMono.p, multiplier);
   }
 
-  return result;
+  return PolyBuilderFinish(&b);
+}
+
+/**
+ * To jest typ wyliczeniowy reprezentujący strategie potęgowania
+ * wielomianów, spośród których wybiera funkcja PolyPow.
+ */
+typedef enum PowStrategy {
+  POW_REPEATED, ///< wielokrotne mnożenie przez podstawę
+  POW_SQUARING, ///< szybkie potęgowanie przez podnoszenie do kwadratu
+  POW_MILLER    ///< rekurencja J.C.P. Millera dla wielomianów jednej zmiennej
+} PowStrategy;
+
+/**
+ * Szacuje liczbę jednomianów na najwyższym poziomie wielomianu @f$p^j@f$.
+ * Wynik nie przekracza ani liczby możliwych wykładników @f$j \cdot span + 1@f$,
+ * ani liczby kombinacji z powtórzeniami @f$\binom{j + t - 1}{t - 1}@f$.
+ * @param[in] terms : liczba jednomianów @f$t@f$ wielomianu @f$p@f$
+ * @param[in] span : różnica skrajnych wykładników wielomianu @f$p@f$
+ * @param[in] j : wykładnik potęgi
+ * @return szacowana liczba jednomianów
+ */
+static double PowSizeEstimate(size_t terms, double span, poly_exp_t j) {
+  double dense = span * j + 1;
+  double sparse = 1;
+  for (size_t i = 1; i < terms && sparse < dense; i++)
+    sparse = sparse * (j + i) / i;
+
+  return sparse < dense ? sparse : dense;
 }
 
 /**
- * Wykonuje szybkie potęgowanie wielomianów.
+ * Sprawdza, czy do obliczenia @f$p^n@f$ można użyć rekurencji Millera.
+ * Rekurencja wymaga dzielenia, więc stosujemy ją wyłącznie dla wielomianów
+ * jednej zmiennej (o stałych współczynnikach), dla których można wykazać,
+ * że żadna wartość pośrednia nie przekroczy zakresu typu poly_coeff_t.
+ * Wtedy wszystkie dzielenia są dokładne, a wynik jest identyczny z wynikiem
+ * wielokrotnego mnożenia.
  * @param[in] p : wielomian
- * @param[in] x : liczba @f$x@f$
- * @return @f$p^x@f$
+ * @param[in] n : wykładnik potęgi
+ * @return Czy rekurencja Millera da poprawny wynik?
  */
-static Poly PolyQuickPow(const Poly *p, poly_exp_t x) {
-  if (x == 0)
+static bool PowMillerApplicable(const Poly *p, poly_exp_t n) {
+  /* Rekurencja dzieli współczynniki, czego nie da się zrobić modulo m,
+   * a w trybie dokładnym wyniki pośrednie mogą nie być małe. */
+  CoeffRing ring = CoeffCurrentRing();
+  if (NodeGetMeta(p->arr)->depth != 1 || ring.modulus != 0 || ring.exact)
+    return false;
+
+  poly_coeff_t sum = 0;
+  for (size_t i = 0; i < p->size; i++) {
+    poly_coeff_t c = p->arr[i].p.coeff;
+    if (c == POLY_COEFF_MIN)
+      return false;
+    poly_coeff_t abs = c < 0 ? -c : c;
+    if (__builtin_add_overflow(sum, abs, &sum))
+      return false;
+  }
+
+  /* Wszystkie współczynniki p^n są co do modułu nie większe niż sum^n,
+   * a suma w rekurencji nie większa niż (n + 1) * deg * sum * sum^n. */
+  poly_exp_t span = MonoGetExp(&p->arr[p->size - 1]) -
+                    MonoGetExp(&p->arr[0]);
+  poly_coeff_t bound = 1;
+  for (poly_exp_t i = 0; i < n && sum > 1; i++)
+    if (__builtin_mul_overflow(bound, sum, &bound))
+      return false;
+
+  /* Sprawdzamy też, czy wykładniki wyniku mieszczą się w typie poly_exp_t. */
+  poly_exp_t maxExp = MonoGetExp(&p->arr[p->size - 1]);
+  return !__builtin_mul_overflow(bound, sum, &bound) &&
+         !__builtin_mul_overflow(bound, (poly_coeff_t) n + 1, &bound) &&
+         !__builtin_mul_overflow(bound, (poly_coeff_t) span, &bound) &&
+         !__builtin_mul_overflow(maxExp, n, &maxExp);
+}
+
+/**
+ * Potęguje wielomian jednej zmiennej za pomocą rekurencji J.C.P. Millera.
+ * Dla @f$p = x^m \sum_{i=0}^{d} a_i x^i@f$, gdzie @f$a_0 \neq 0@f$,
+ * współczynniki @f$q_k@f$ wielomianu @f$(p / x^m)^n@f$ spełniają
+ * @f$q_0 = a_0^n@f$ oraz
+ * @f$q_k = \frac{1}{k a_0} \sum_{i=1}^{\min(k, d)} ((n + 1) i - k) a_i q_{k-i}@f$.
+ * Nie tworzy żadnych pośrednich potęg wielomianu @p p.
+ * @param[in] p : wielomian spełniający warunki PowMillerApplicable
+ * @param[in] n : wykładnik potęgi
+ * @return @f$p^n@f$
+ */
+static Poly PolyPowMiller(const Poly *p, poly_exp_t n) {
+  poly_exp_t minExp = MonoGetExp(&p->arr[0]);
+  size_t degree = MonoGetExp(&p->arr[p->size - 1]) - minExp;
+  size_t resultDegree = degree * n;
+  poly_coeff_t a0 = p->arr[0].p.coeff;
+
+  poly_coeff_t *q = calloc(resultDegree + 1, sizeof(poly_coeff_t));
+  CHECK_PTR(q);
+
+  q[0] = QuickPow(a0, n);
+  size_t count = 1;
+  for (size_t k = 1; k <= resultDegree; k++) {
+    poly_coeff_t sum = 0;
+    for (size_t j = 1; j < p->size; j++) {
+      size_t i = MonoGetExp(&p->arr[j]) - minExp;
+      if (i > k)
+        break;
+      sum += ((poly_coeff_t) (n + 1) * i - k) * p->arr[j].p.coeff * q[k - i];
+    }
+    q[k] = sum / ((poly_coeff_t) k * a0);
+    if (q[k] != 0)
+      count++;
+  }
+
+  Mono *monos = NodeAlloc(count);
+  size_t index = 0;
+  for (size_t k = 0; k <= resultDegree; k++) {
+    if (q[k] != 0) {
+      monos[index] = (Mono) {.p = PolyFromCoeff(q[k]),
+          .exp = (poly_exp_t) k + minExp * n};
+      index++;
+    }
+  }
+  free(q);
+
+  return PolyOwnSortedMonos(count, monos);
+}
+
+/**
+ * Wybiera najtańszą strategię obliczenia @f$p^n@f$ na podstawie modelu
+ * kosztu. Koszt pomnożenia wielomianów o @f$a@f$ i @f$b@f$ jednomianach
+ * szacujemy jako @f$ab@f$, a rozmiary potęg pośrednich funkcją
+ * PowSizeEstimate. Dla rzadkich podstaw kwadraty potęg pośrednich są
+ * znacznie większe niż one same, więc wielokrotne mnożenie przez @p p
+ * bywa tańsze od podnoszenia do kwadratu.
+ * @param[in] p : wielomian niebędący współczynnikiem
+ * @param[in] n : wykładnik potęgi, @f$n \geq 2@f$
+ * @return wybrana strategia
+ */
+static PowStrategy PowChooseStrategy(const Poly *p, poly_exp_t n) {
+  size_t terms = p->size;
+  double span = MonoGetExp(&p->arr[terms - 1]) - MonoGetExp(&p->arr[0]);
+
+  /* Potęgowanie od najstarszego bitu: podnosimy do kwadratu i, jeśli bit
+   * jest zapalony, mnożymy przez p. */
+  double squaringCost = 0;
+  poly_exp_t e = 1;
+  int bit = 30;
+  while (bit >= 0 && !((n >> bit) & 1))
+    bit--;
+  for (bit--; bit >= 0; bit--) {
+    double size = PowSizeEstimate(terms, span, e);
+    squaringCost += size * size;
+    e *= 2;
+    if ((n >> bit) & 1) {
+      squaringCost += terms * PowSizeEstimate(terms, span, e);
+      e++;
+    }
+  }
+
+  PowStrategy best = POW_SQUARING;
+  double bestCost = squaringCost;
+
+  double repeatedCost = 0;
+  for (poly_exp_t j = 1; j < n && repeatedCost < bestCost; j++)
+    repeatedCost += terms * PowSizeEstimate(terms, span, j);
+  if (repeatedCost < bestCost) {
+    best = POW_REPEATED;
+    bestCost = repeatedCost;
+  }
+
+  double millerCost = (span * n + 1) * terms;
+  if (millerCost < bestCost && PowMillerApplicable(p, n))
+    best = POW_MILLER;
+
+  return best;
+}
+
+Poly PolyPow(const Poly *p, poly_exp_t n) {
+  assert(n >= 0);
+
+  if (n == 0)
     return PolyFromCoeff(1);
-  if (PolyIsZero(p))
+  if (PolyIsCoeff(p))
+    return PolyFromCoeff(QuickPow(p->coeff, n));
+  if (n == 1)
+    return PolyClone(p);
+
+  switch (PowChooseStrategy(p, n)) {
+    case POW_MILLER:
+      return PolyPowMiller(p, n);
+
+    case POW_REPEATED: {
+      Poly result = PolyClone(p);
+      for (poly_exp_t i = 1; i < n; i++) {
+        Poly mem = result;
+        result = PolyMul(&mem, p);
+        PolyDestroy(&mem);
+      }
+      return result;
+    }
+
+    default: {
+      int bit = 30;
+      while (!((n >> bit) & 1))
+        bit--;
+
+      Poly result = PolyClone(p);
+      for (bit--; bit >= 0; bit--) {
+        Poly mem = result;
+        result = PolyMul(&mem, &mem);
+        PolyDestroy(&mem);
+        if ((n >> bit) & 1) {
+          mem = result;
+          result = PolyMul(&mem, p);
+          PolyDestroy(&mem);
+        }
+      }
+      return result;
+    }
+  }
+}
+
+/**
+ * Wyznacza maksymalny wykładnik zmiennej @f$x_{idX}@f$ w obciętym wyniku.
+ * @param[in] bound : ograniczenie stopni
+ * @param[in] idX : stopień zagłębienia
+ * @param[in] budget : pozostała część ograniczenia stopnia całkowitego
+ * @return maksymalny wykładnik
+ */
+static poly_exp_t TruncLimit(const PolyDegBound *bound, size_t idX,
+                             poly_exp_t budget) {
+  if (idX < bound->vars && bound->varDeg[idX] >= 0 &&
+      bound->varDeg[idX] < budget)
+    return bound->varDeg[idX];
+  return budget;
+}
+
+/**
+ * Funkcja pomocnicza do funkcji PolyMulTrunc, mnożąca wielomiany
+ * na zadanym poziomie zagłębienia.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @param[in] bound : ograniczenie stopni
+ * @param[in] idX : stopień zagłębienia
+ * @param[in] budget : pozostała część ograniczenia stopnia całkowitego
+ * @return obcięty iloczyn @f$p * q@f$
+ */
+static Poly PolyMulTruncHelper(const Poly *p, const Poly *q,
+                               const PolyDegBound *bound, size_t idX,
+                               poly_exp_t budget) {
+  if (PolyIsCoeff(p) && PolyIsCoeff(q))
+    return PolyFromCoeff(CoeffMul(p->coeff, q->coeff));
+  if (PolyIsZero(p) || PolyIsZero(q))
     return PolyZero();
 
-  if (x % 2 == 1) {
-    Poly q = PolyQuickPow(p, x - 1);
-    Poly result = PolyMul(p, &q);
-    PolyDestroy(&q);
-    return result;
+  /* Współczynnik traktujemy jak wielomian cx^0. */
+  NodeInline lifted;
+  Poly liftedCoeff;
+  if (PolyIsCoeff(p)) {
+    liftedCoeff = NodeInlineLift(&lifted, p->coeff);
+    p = &liftedCoeff;
+  } else if (PolyIsCoeff(q)) {
+    liftedCoeff = NodeInlineLift(&lifted, q->coeff);
+    q = &liftedCoeff;
+  }
+
+  const Poly *a = p->size <= q->size ? p : q;
+  const Poly *b = p->size <= q->size ? q : p;
+
+  /* Jednomiany są posortowane rosnąco, więc każdy wiersz iloczynów
+   * jednomianu a z jednomianami b przerywamy przy pierwszym iloczynie
+   * przekraczającym ograniczenie. */
+  poly_exp_t limit = TruncLimit(bound, idX, budget);
+  size_t count = 0, rows = 0;
+  for (size_t aI = 0; aI < a->size && a->arr[aI].exp <= limit; aI++) {
+    for (size_t bI = 0;
+         bI < b->size && b->arr[bI].exp <= limit - a->arr[aI].exp; bI++)
+      count++;
+    if (b->arr[0].exp <= limit - a->arr[aI].exp)
+      rows++;
   }
+  if (count == 0)
+    return PolyZero();
+
+  /* Wiersze scalamy kopcem jak w funkcji PolyMulHeap, więc wynik powstaje
+   * w kolejności rosnących wykładników. Wykładniki pierwszych iloczynów
+   * rosną razem z wierszem, więc początkowa tablica jest kopcem. */
+  MulHeapItem *heap = calloc(rows, sizeof(MulHeapItem));
+  CHECK_PTR(heap);
+  for (size_t i = 0; i < rows; i++)
+    heap[i] = (MulHeapItem) {.exp = a->arr[i].exp + b->arr[0].exp,
+        .row = i, .col = 0};
+  size_t heapSize = rows;
+
+  Mono *resultArr = NodeAlloc(count);
+  size_t size = 0;
+  while (heapSize > 0) {
+    MulHeapItem top = heap[0];
+    Poly pq = PolyMulTruncHelper(&a->arr[top.row].p, &b->arr[top.col].p,
+                                 bound, idX + 1, budget - top.exp);
+
+    if (size > 0 && resultArr[size - 1].exp == top.exp) {
+      Poly mem = resultArr[size - 1].p;
+      resultArr[size - 1].p = PolyAdd(&mem, &pq);
+      PolyDestroy(&mem);
+      PolyDestroy(&pq);
+    } else {
+      resultArr[size] = (Mono) {.p = pq, .exp = top.exp};
+      size++;
+    }
 
-  Poly q = PolyQuickPow(p, x / 2);
-  Poly result = PolyMul(&q, &q);
-  PolyDestroy(&q);
+    /* Wiersz kończy się razem z b albo przy przekroczeniu ograniczenia. */
+    poly_exp_t rowExp = a->arr[top.row].exp;
+    if (top.col + 1 < b->size && b->arr[top.col + 1].exp <= limit - rowExp) {
+      heap[0].col++;
+      heap[0].exp = rowExp + b->arr[top.col + 1].exp;
+    } else {
+      heapSize--;
+      heap[0] = heap[heapSize];
+    }
+    MulHeapSiftDown(heap, heapSize, 0);
+  }
+
+  free(heap);
+  return PolyOwnSortedMonos(size, resultArr);
+}
+
+Poly PolyMulTrunc(const Poly *p, const Poly *q, const PolyDegBound *bound) {
+  poly_exp_t budget = bound->totalDeg >= 0 ? bound->totalDeg : INT_MAX;
+  return PolyMulTruncHelper(p, q, bound, 0, budget);
+}
+
+Poly PolyTruncate(const Poly *p, const PolyDegBound *bound) {
+  Poly one = PolyFromCoeff(1);
+  return PolyMulTrunc(p, &one, bound);
+}
+
+Poly PolyPowTrunc(const Poly *p, poly_exp_t n, const PolyDegBound *bound) {
+  assert(n >= 0);
+
+  Poly result = PolyFromCoeff(1);
+  Poly base = PolyTruncate(p, bound);
+  while (n > 0) {
+    if (n & 1) {
+      Poly mem = result;
+      result = PolyMulTrunc(&mem, &base, bound);
+      PolyDestroy(&mem);
+    }
+    n >>= 1;
+    if (n > 0) {
+      Poly mem = base;
+      base = PolyMulTrunc(&mem, &mem, bound);
+      PolyDestroy(&mem);
+    }
+  }
+
+  PolyDestroy(&base);
   return result;
 }
 
@@ -535,24 +1974,22 @@ static Poly PolyComposeHelper(const Poly *p, size_t k, const Poly q[], size_t id
     Poly temp1 = PolyZero();
     if (currExp == 0)
       temp1 = PolyFromCoeff(1);
-    else if (idX <= k)
-      temp1 = PolyQuickPow(&q[idX], currExp);
+    else if (idX < k)
+      temp1 = PolyPow(&q[idX], currExp);
 
+    /* Iloczyn dodajemy od razu do wyniku, bez jego tworzenia. */
     Poly temp2 = PolyComposeHelper(&currMono.p, k, q, idX + 1);
-    Poly temp = PolyMul(&temp1, &temp2);
+    PolyFmaInPlace(&result, &temp1, &temp2);
 
     PolyDestroy(&temp1);
     PolyDestroy(&temp2);
-
-    Poly newResult = PolyAdd(&result, &temp);
-    PolyDestroy(&result);
-    PolyDestroy(&temp);
-    result = newResult;
   }
 
   return result;
 }
 
 Poly PolyCompose(const Poly *p, size_t k, const Poly q[]) {
-  return PolyComposeHelper(p, k, q, 0);
+  bool outer = NodeArenaEnter();
+  Poly result = PolyComposeHelper(p, k, q, 0);
+  return ScratchFinish(outer, &result);
 }
@@ -10,13 +10,19 @@
 #define __POLY_H__
 
 #include <assert.h>
+#include <limits.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /**
  * To jest makro oznaczające błędne Mono, którego nie da się stworzyć
- * w normalnych warunkach. Istnieje po to, aby funkcja ParseMono mogła
+ * w normalnych warunkach. Istnieje po to, aby funkcje parsujące mogły
  * poinformować o wystąpieniu błędu w trakcie parsowania napisu.
  */
 #define ERR_MONO (Mono) { .p = PolyZero(), .exp = -1 }
@@ -39,8 +45,45 @@
     }                   \
   } while (0)
 
+/**
+ * To jest maksymalne zagłębienie wielomianu, dla którego gwarantowane jest
+ * działanie wszystkich operacji. Usuwanie, kopiowanie, porównywanie
+ * i wypisywanie wielomianów działają iteracyjnie dla dowolnego zagłębienia,
+ * a pozostałe operacje schodzą rekurencyjnie po zmiennych, więc zużywają
+ * stos proporcjonalny do zagłębienia. Parser odrzuca głębsze wielomiany.
+ */
+#define POLY_MAX_DEPTH 4096
+
+/**
+ * To jest liczba bitów typu współczynników, wybierana w czasie kompilacji
+ * (32, 64 lub 128). Cała biblioteka jest kompilowana dla jednego typu,
+ * więc działania na współczynnikach nie wymagają wyboru w czasie działania.
+ */
+#ifndef POLY_COEFF_BITS
+#define POLY_COEFF_BITS 64
+#endif
+
+#if POLY_COEFF_BITS == 32
+/** To jest typ reprezentujący współczynniki. */
+typedef int32_t poly_coeff_t;
+/** To jest największa wartość współczynnika. */
+#define POLY_COEFF_MAX INT32_MAX
+#elif POLY_COEFF_BITS == 64
 /** To jest typ reprezentujący współczynniki. */
 typedef long poly_coeff_t;
+/** To jest największa wartość współczynnika. */
+#define POLY_COEFF_MAX LONG_MAX
+#elif POLY_COEFF_BITS == 128
+/** To jest typ reprezentujący współczynniki. */
+typedef __int128 poly_coeff_t;
+/** To jest największa wartość współczynnika. */
+#define POLY_COEFF_MAX ((poly_coeff_t) (((unsigned __int128) 1 << 127) - 1))
+#else
+#error "POLY_COEFF_BITS musi być równe 32, 64 lub 128"
+#endif
+
+/** To jest najmniejsza wartość współczynnika. */
+#define POLY_COEFF_MIN (-POLY_COEFF_MAX - 1)
 
 /** To jest typ reprezentujący wykładniki. */
 typedef int poly_exp_t;
@@ -51,6 +94,8 @@ struct Mono;
  * To jest struktura przechowująca wielomian.
  * Wielomian jest albo liczbą całkowitą, czyli wielomianem stałym
  * (wtedy `arr == NULL`), albo niepustą listą jednomianów (wtedy `arr != NULL`).
+ * Tablice jednomianów są alokowane wyłącznie przez bibliotekę (patrz node.h),
+ * bo poprzedza je nagłówek z metadanymi wielomianu.
  */
 typedef struct Poly {
   /**
@@ -149,14 +194,14 @@ static inline bool PolyIsCoeff(const Poly *p) {
 }
 
 /**
- * Sprawdza, czy wielomian jest tożsamościowo równy zeru.
+ * Sprawdza, czy wielomian jest tożsamościowo równy zeru. Wielomiany
+ * tworzone przez bibliotekę nie zawierają zerowych jednomianów ani
+ * zagłębionych wielomianów stałych, więc zerem może być tylko współczynnik.
  * @param[in] p : wielomian
  * @return Czy wielomian jest równy zeru?
  */
 static inline bool PolyIsZero(const Poly *p) {
-  if (PolyIsCoeff(p))
-    return (p->coeff == 0);
-  return (p->size == 1 && PolyIsZero(&p->arr[0].p));
+  return (PolyIsCoeff(p) && p->coeff == 0);
 }
 
 /**
@@ -173,6 +218,34 @@ static inline void MonoDestroy(Mono *m) {
   PolyDestroy(&m->p);
 }
 
+/**
+ * Przekazuje wielomian do późniejszego usunięcia. Pamięć jest zwalniana
+ * przez funkcję PolyReclaim, więc wywołanie nie zależy od rozmiaru
+ * wielomianu. Wielomian skompaktowany jest zwalniany od razu.
+ * Lista wielomianów do usunięcia jest wspólna i nie jest chroniona
+ * przed dostępem z wielu wątków.
+ * @param[in] p : wielomian
+ */
+void PolyDestroyDeferred(Poly *p);
+
+/**
+ * Zwalnia część pamięci wielomianów przekazanych funkcji
+ * PolyDestroyDeferred. Budżet jest liczbą zwalnianych węzłów
+ * i jednomianów. Wywołanie zwalnia jednak co najmniej tyle, ile odłożono
+ * od poprzedniego wywołania, więc odłożona pamięć nie rośnie bez końca,
+ * a jego czas jest proporcjonalny do pracy, która tę pamięć odłożyła.
+ * @param[in] budget : budżet; SIZE_MAX zwalnia wszystko
+ * @return czy cała odłożona pamięć została zwolniona
+ */
+bool PolyReclaim(size_t budget);
+
+/**
+ * Podaje górne ograniczenie liczby węzłów i jednomianów odłożonych
+ * funkcją PolyDestroyDeferred i jeszcze niezwolnionych.
+ * @return liczba odłożonych węzłów i jednomianów
+ */
+size_t PolyReclaimPending(void);
+
 /**
  * Robi pełną, głęboką kopię wielomianu.
  * @param[in] p : wielomian
@@ -189,6 +262,32 @@ static inline Mono MonoClone(const Mono *m) {
   return (Mono) {.p = PolyClone(&m->p), .exp = m->exp};
 }
 
+/**
+ * Zwalnia pamięć pomocniczą bieżącego wątku. Operacje PolyMul i PolyCompose
+ * alokują wielomiany tymczasowe w arenie przypisanej do wątku, której pamięć
+ * jest zachowywana między wywołaniami. Wątek powinien wywołać tę funkcję
+ * przed zakończeniem.
+ */
+void PolyScratchRelease(void);
+
+/**
+ * Przenosi wielomian do jednego ciągłego bloku pamięci, układając jego
+ * węzły w kolejności przejścia w głąb. Przejścia po tak ułożonym wielomianie
+ * czytają pamięć sekwencyjnie, a usunięcie go zwalnia jeden blok.
+ * Wielomian skompaktowany jest zwykłym wielomianem dla wszystkich funkcji
+ * biblioteki. Dla współczynników i wielomianów już skompaktowanych
+ * funkcja nic nie robi.
+ * @param[in,out] p : wielomian
+ */
+void PolyCompact(Poly *p);
+
+/**
+ * Działa jak PolyCompact, ale pierwotny wielomian przekazuje
+ * do późniejszego usunięcia funkcją PolyDestroyDeferred.
+ * @param[in,out] p : wielomian
+ */
+void PolyCompactDeferred(Poly *p);
+
 /**
  * Porównuje dwa jednomiany na podstawie ich wykładników.
  * @param[in] a : jednomian
@@ -246,6 +345,19 @@ Poly PolyOwnMonos(size_t count, Mono *monos);
  */
 Poly PolyCloneMonos(size_t count, const Mono monos[]);
 
+/**
+ * Oblicza kombinację liniową dwóch wielomianów, scalając je w jednym
+ * przejściu i skalując jednomiany w trakcie scalania, bez wielomianów
+ * tymczasowych. Na tej funkcji opierają się PolyAdd, PolySub, PolyNeg
+ * i PolyMulCoeff.
+ * @param[in] a : współczynnik @f$a@f$
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] b : współczynnik @f$b@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @return @f$a \cdot p + b \cdot q@f$
+ */
+Poly PolyLinComb(poly_coeff_t a, const Poly *p, poly_coeff_t b, const Poly *q);
+
 /**
  * Mnoży wielomian przez współczynnik.
  * @param[in] p : wielomian @f$p@f$
@@ -262,6 +374,180 @@ Poly PolyMulCoeff(const Poly *p, poly_coeff_t c);
  */
 Poly PolyMul(const Poly *p, const Poly *q);
 
+/** To jest typ wyliczeniowy reprezentujący algorytmy mnożenia wielomianów. */
+typedef enum PolyMulStrategy {
+  MUL_AUTO, ///< wybór algorytmu na podstawie progów konfiguracji
+  MUL_SORT, ///< sortowanie wszystkich iloczynów jednomianów
+  MUL_HEAP, ///< scalanie wierszy iloczynów jednomianów za pomocą kopca
+  MUL_HASH, ///< sumowanie iloczynów jednomianów w tablicy haszującej
+  MUL_DENSE ///< sumowanie iloczynów w gęstej tablicy (tylko jedna zmienna)
+} PolyMulStrategy;
+
+/**
+ * To jest struktura przechowująca progi, na podstawie których funkcja
+ * PolyMul wybiera algorytm osobno dla każdego wywołania i każdego poziomu
+ * zagłębienia wielomianu. Niech @f$n@f$ oznacza liczbę iloczynów jednomianów,
+ * a @f$s@f$ liczbę możliwych wykładników wyniku, czyli sumę rozpiętości
+ * wykładników czynników powiększoną o 1.
+ */
+typedef struct PolyMulConfig {
+  /** To jest algorytm narzucony dla wszystkich wywołań albo MUL_AUTO. */
+  PolyMulStrategy strategy;
+  /** Dla wielomianów jednej zmiennej MUL_DENSE, gdy @f$s \cdot denseRatio \leq n@f$. */
+  size_t denseRatio;
+  /** W pozostałych przypadkach MUL_HASH, gdy @f$s \cdot hashRatio \leq n@f$. */
+  size_t hashRatio;
+  /** W pozostałych przypadkach MUL_HEAP, gdy @f$n \geq heapMinProducts@f$. */
+  size_t heapMinProducts;
+  /** To jest maksymalna liczba wątków funkcji PolyMulMany. */
+  size_t threads;
+} PolyMulConfig;
+
+/** To jest domyślna konfiguracja wyboru algorytmu mnożenia. */
+#define POLY_MUL_CONFIG_DEFAULT \
+  {.strategy = MUL_AUTO, .denseRatio = 1, .hashRatio = 256, \
+      .heapMinProducts = 4, .threads = 1}
+
+/**
+ * Ustawia konfigurację wyboru algorytmu mnożenia.
+ * @param[in] config : konfiguracja
+ */
+void PolySetMulConfig(const PolyMulConfig *config);
+
+/**
+ * Zwraca bieżącą konfigurację wyboru algorytmu mnożenia.
+ * @return konfiguracja
+ */
+PolyMulConfig PolyGetMulConfig(void);
+
+/** To jest ograniczenie górne (wyłączne) modułu pierścienia współczynników. */
+#define POLY_MODULUS_LIMIT ((long long) 1 << 31)
+
+/**
+ * Ustawia arytmetykę współczynników modulo @p modulus albo, dla 0,
+ * przywraca zwykłą arytmetykę liczb całkowitych. W trybie modularnym
+ * funkcje biblioteki liczą współczynniki wyników modulo @p modulus
+ * i zwracają je jako reszty z przedziału @f$[0, modulus)@f$; jednomiany,
+ * których współczynnik zredukował się do zera, są pomijane. Argumenty
+ * muszą mieć współczynniki już zredukowane, np. funkcją PolyReduce.
+ * Wyjątkiem są argumenty liczbowe funkcji PolyAt, PolyMulCoeff
+ * i PolyLinComb oraz budowniczego, które są redukowane na wejściu.
+ * Ustawienie jest wspólne dla wszystkich wątków. Jeśli biblioteka została
+ * skompilowana ze stałym modułem POLY_COEFF_MODULUS, akceptowany jest
+ * tylko ten moduł.
+ * @param[in] modulus : moduł, @f$2 \leq modulus < @f$ POLY_MODULUS_LIMIT, albo 0
+ * @return czy moduł był poprawny; jeśli nie, tryb się nie zmienia
+ */
+bool PolySetModulus(poly_coeff_t modulus);
+
+/**
+ * Zwraca moduł pierścienia współczynników.
+ * @return moduł albo 0 dla zwykłej arytmetyki liczb całkowitych
+ */
+poly_coeff_t PolyGetModulus(void);
+
+/**
+ * Włącza lub wyłącza tryb dokładny zwykłej arytmetyki współczynników.
+ * Domyślnie współczynniki przepełniają się modulo @f$2^{64}@f$. W trybie
+ * dokładnym współczynniki o module mniejszym niż @f$2^{k-2}@f$, gdzie
+ * @f$k@f$ to liczba bitów typu poly_coeff_t, są liczone bezpośrednio
+ * z kontrolą przepełnienia, która kosztuje jeden przewidywalny skok na
+ * działanie. Wynik spoza tego zakresu jest zapisywany jako liczba dowolnej
+ * precyzji, a pole coeff przechowuje jej uchwyt (patrz PolyCoeffIsBig).
+ * Argumenty wielomianowe muszą mieć współczynniki o module mniejszym niż
+ * @f$2^{k-2}@f$ albo pochodzące z wyników biblioteki; inne należy
+ * przekształcić funkcją PolyReduce. Argumenty liczbowe funkcji PolyAt,
+ * PolyMulCoeff i PolyLinComb oraz budowniczego mogą mieć dowolną wartość.
+ * Tryb należy zmieniać tylko wtedy, gdy nie istnieją wielomiany
+ * utworzone w poprzednim trybie.
+ * @param[in] exact : czy liczyć dokładnie
+ */
+void PolySetExact(bool exact);
+
+/**
+ * Sprawdza, czy włączony jest tryb dokładny.
+ * @return czy współczynniki są liczone dokładnie
+ */
+bool PolyGetExact(void);
+
+/**
+ * Sprowadza liczbę całkowitą do współczynnika w bieżącym trybie: reszty
+ * modulo moduł w trybie modularnym, a w trybie dokładnym liczby
+ * przechowywanej bezpośrednio albo uchwytu liczby dowolnej precyzji.
+ * @param[in] c : liczba całkowita
+ * @return współczynnik równy @p c w bieżącym pierścieniu
+ */
+poly_coeff_t PolyCoeffReduce(poly_coeff_t c);
+
+/**
+ * Sprawdza, czy współczynnik jest uchwytem liczby dowolnej precyzji
+ * trybu dokładnego. Takiego współczynnika nie można odczytać wprost;
+ * jego wartość zapisuje funkcja PolyCoeffToString.
+ * @param[in] c : współczynnik
+ * @return czy @p c jest uchwytem
+ */
+bool PolyCoeffIsBig(poly_coeff_t c);
+
+/**
+ * Zapisuje współczynnik w systemie dziesiętnym, także jeśli jest
+ * uchwytem liczby dowolnej precyzji.
+ * @param[in] c : współczynnik
+ * @return napis zaalokowany funkcją malloc, który zwalnia wywołujący
+ */
+char *PolyCoeffToString(poly_coeff_t c);
+
+/**
+ * Zwalnia liczby dowolnej precyzji trybu dokładnego. Po wywołaniu nie mogą
+ * istnieć wielomiany, których współczynniki są uchwytami, ani nie mogą
+ * trwać obliczenia w innych wątkach.
+ */
+void PolyBigRelease(void);
+
+/**
+ * Sprowadza współczynniki wielomianu do reszt modulo bieżący moduł,
+ * pomijając jednomiany, których współczynnik stał się zerem.
+ * W trybie dokładnym zamienia duże współczynniki na uchwyty liczb dowolnej
+ * precyzji (patrz PolyCoeffReduce), a w zwykłym trybie zwraca kopię
+ * wielomianu.
+ * @param[in] p : wielomian
+ * @return wielomian o zredukowanych współczynnikach
+ */
+Poly PolyReduce(const Poly *p);
+
+/**
+ * Dodaje do akumulatora iloczyn dwóch wielomianów, nie tworząc tego
+ * iloczynu. Jednomiany iloczynu powstają w kolejności rosnących
+ * wykładników i są od razu scalane z jednomianami akumulatora, które
+ * są przenoszone do wyniku bez kopiowania. Wielomiany @p p i @p q mogą
+ * być równe @p acc, ale nie mogą być jego częściami.
+ * @param[in,out] acc : akumulator @f$acc@f$
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ */
+void PolyFmaInPlace(Poly *acc, const Poly *p, const Poly *q);
+
+/**
+ * Sumuje tablicę wielomianów. Na każdym poziomie zagłębienia scala
+ * za pomocą kopca jednomiany wszystkich składników naraz, więc każdy
+ * jednomian jest odwiedzany raz, a nie tworzone są sumy częściowe.
+ * @param[in] n : liczba wielomianów
+ * @param[in] ps : tablica wielomianów
+ * @return @f$ps_0 + ps_1 + \ldots + ps_{n - 1}@f$
+ */
+Poly PolyAddMany(size_t n, const Poly *ps[]);
+
+/**
+ * Mnoży tablicę wielomianów. Czynniki są mnożone w drzewie Huffmana
+ * ważonym liczbą jednomianów, czyli zawsze dwa najmniejsze iloczyny
+ * naraz, dzięki czemu duże wielomiany pośrednie powstają jak najpóźniej.
+ * Jeśli konfiguracja mnożenia pozwala na więcej niż jeden wątek,
+ * niezależne duże poddrzewa są liczone równolegle.
+ * @param[in] n : liczba wielomianów
+ * @param[in] ps : tablica wielomianów
+ * @return @f$ps_0 \cdot ps_1 \cdot \ldots \cdot ps_{n - 1}@f$
+ */
+Poly PolyMulMany(size_t n, const Poly *ps[]);
+
 /**
  * Zwraca przeciwny wielomian.
  * @param[in] p : wielomian @f$p@f$
@@ -277,6 +563,60 @@ Poly PolyNeg(const Poly *p);
  */
 Poly PolySub(const Poly *p, const Poly *q);
 
+/**
+ * Podnosi wielomian do potęgi @p n. Strategię obliczeń (wielokrotne mnożenie,
+ * podnoszenie do kwadratu lub rekurencja Millera dla wielomianów jednej
+ * zmiennej) wybiera na podstawie liczby jednomianów i rozpiętości wykładników
+ * podstawy.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] n : wykładnik potęgi @f$n \geq 0@f$
+ * @return @f$p^n@f$
+ */
+Poly PolyPow(const Poly *p, poly_exp_t n);
+
+/**
+ * To jest struktura opisująca ograniczenie stopni jednomianów wielu zmiennych
+ * używane przez funkcje obcinające. Jednomian spełnia ograniczenie, jeśli jego
+ * stopień całkowity nie przekracza @p totalDeg i dla każdego @f$i < vars@f$
+ * jego stopień ze względu na zmienną @f$x_i@f$ nie przekracza @f$varDeg[i]@f$.
+ * Wartość ujemna oznacza brak danego ograniczenia.
+ */
+typedef struct PolyDegBound {
+  poly_exp_t totalDeg; ///< ograniczenie stopnia całkowitego
+  size_t vars; ///< liczba ograniczeń stopni poszczególnych zmiennych
+  const poly_exp_t *varDeg; ///< ograniczenia stopni zmiennych @f$x_0, x_1, \ldots@f$
+} PolyDegBound;
+
+/**
+ * Obcina wielomian, zostawiając tylko jednomiany spełniające ograniczenie.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] bound : ograniczenie stopni
+ * @return wielomian @f$p@f$ bez jednomianów przekraczających ograniczenie
+ */
+Poly PolyTruncate(const Poly *p, const PolyDegBound *bound);
+
+/**
+ * Mnoży dwa wielomiany, pomijając jednomiany przekraczające ograniczenie.
+ * Iloczyny jednomianów, które przekroczyłyby ograniczenie, nie są w ogóle
+ * tworzone, a współczynniki są mnożone z ograniczeniem pomniejszonym
+ * o wykładnik bieżącej zmiennej.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @param[in] bound : ograniczenie stopni
+ * @return obcięty iloczyn @f$p * q@f$
+ */
+Poly PolyMulTrunc(const Poly *p, const Poly *q, const PolyDegBound *bound);
+
+/**
+ * Podnosi wielomian do potęgi @p n, obcinając każdy iloczyn pośredni
+ * funkcją PolyMulTrunc.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] n : wykładnik potęgi @f$n \geq 0@f$
+ * @param[in] bound : ograniczenie stopni
+ * @return obcięta potęga @f$p^n@f$
+ */
+Poly PolyPowTrunc(const Poly *p, poly_exp_t n, const PolyDegBound *bound);
+
 /**
  * Zwraca stopień wielomianu ze względu na zadaną zmienną (-1 dla wielomianu
  * tożsamościowo równego zeru). Zmienne indeksowane są od 0.
@@ -291,11 +631,29 @@ poly_exp_t PolyDegBy(const Poly *p, size_t varIdx);
 
 /**
  * Zwraca stopień wielomianu (-1 dla wielomianu tożsamościowo równego zeru).
+ * Działa w czasie stałym.
  * @param[in] p : wielomian
  * @return stopień wielomianu @p p
  */
 poly_exp_t PolyDeg(const Poly *p);
 
+/**
+ * Zwraca liczbę niezerowych współczynników liczbowych wielomianu, czyli
+ * liczbę jego jednomianów wielu zmiennych (0 dla wielomianu tożsamościowo
+ * równego zeru). Działa w czasie stałym.
+ * @param[in] p : wielomian
+ * @return liczba jednomianów wielu zmiennych wielomianu @p p
+ */
+size_t PolyTermCount(const Poly *p);
+
+/**
+ * Zwraca maksymalne zagłębienie wielomianu, czyli liczbę zmiennych, które
+ * mogą w nim występować (0 dla współczynnika). Działa w czasie stałym.
+ * @param[in] p : wielomian
+ * @return zagłębienie wielomianu @p p
+ */
+size_t PolyDepth(const Poly *p);
+
 /**
  * Sprawdza równość dwóch jednomianów.
  * @param[in] m : jednomian @f$m@f$
@@ -339,4 +697,8 @@ Poly PolyAt(const Poly *p, poly_coeff_t x);
  */
 Poly PolyCompose(const Poly *p, size_t k, const Poly q[]);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* __POLY_H__ */
@@ -0,0 +1,829 @@
+/** @file
+ * Nakładka C++ na bibliotekę wielomianów rzadkich wielu zmiennych
+ *
+ * Klasa poly::Polynomial jest właścicielem wielomianu i usuwa go
+ * w destruktorze, a przeniesienie obiektu przekazuje tablice jednomianów
+ * bez kopiowania. Operatory arytmetyczne nie liczą niczego od razu, tylko
+ * budują wyrażenie, które jest obliczane dopiero przy przypisaniu
+ * do obiektu klasy Polynomial. Wyrażenie jest wtedy sprowadzane do postaci
+ * @f$\sum_i p_i + \sum_j c_j q_j + \sum_k d_k \prod_l r_{kl}@f$
+ * i liczone funkcjami biblioteki, które nie tworzą wielomianów pośrednich:
+ * składniki @f$p_i@f$ są scalane naraz funkcją PolyAddMany, składniki
+ * @f$c_j q_j@f$ funkcją PolyLinComb, a iloczyny są dodawane do wyniku
+ * funkcją PolyFmaInPlace, więc np. `a * b + c - d` nie tworzy ani iloczynu
+ * @f$a \cdot b@f$, ani żadnej sumy częściowej.
+ *
+ * Wyrażenie przechowuje wskaźniki na wielomiany, z których powstało,
+ * więc nie może ich przeżyć; zwykle jest obliczane w tej samej instrukcji.
+ * Nakładka nie zmienia interfejsu poly.h i nie ma własnego pliku
+ * źródłowego.
+ *
+ * @author Filip Głębocki <fg429202@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2021
+ */
+
+#ifndef __POLY_HPP__
+#define __POLY_HPP__
+
+#include "poly.h"
+#include <deque>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/** To jest przestrzeń nazw nakładki C++ na bibliotekę wielomianów. */
+namespace poly {
+
+class Polynomial;
+
+/** To jest przestrzeń nazw szczegółów implementacji wyrażeń. */
+namespace detail {
+
+/**
+ * To jest klasa bazowa wszystkich wyrażeń, w tym samej klasy Polynomial.
+ * Parametrem jest typ wyrażenia, więc operatory znają je w czasie kompilacji.
+ */
+template <class E>
+struct Expr {
+  /**
+   * Daje wyrażenie jako obiekt właściwego typu.
+   * @return wyrażenie
+   */
+  const E &Self() const {
+    return static_cast<const E &>(*this);
+  }
+};
+
+template <class E>
+Poly Evaluate(const E &e);
+
+template <class E>
+void Accumulate(Poly &acc, const E &e, poly_coeff_t scale);
+
+} // namespace detail
+
+/**
+ * To jest klasa będąca właścicielem wielomianu. Kopiowanie robi głęboką
+ * kopię, a przenoszenie zostawia w źródle wielomian zerowy.
+ */
+class Polynomial : public detail::Expr<Polynomial> {
+public:
+  /** Tworzy wielomian tożsamościowo równy zeru. */
+  Polynomial() noexcept : p_(PolyZero()) {}
+
+  /**
+   * Tworzy wielomian stały. Współczynnik jest sprowadzany do bieżącego
+   * trybu funkcją PolyCoeffReduce: do reszty w trybie modularnym, a w trybie
+   * dokładnym duża wartość trafia do liczby dowolnej precyzji.
+   * @param[in] c : wartość współczynnika
+   */
+  Polynomial(poly_coeff_t c) : p_(PolyFromCoeff(PolyCoeffReduce(c))) {}
+
+  /**
+   * Przejmuje na własność wielomian utworzony funkcjami biblioteki.
+   * @param[in] p : wielomian
+   * @return obiekt będący właścicielem @p p
+   */
+  static Polynomial Adopt(Poly p) noexcept {
+    Polynomial result;
+    result.p_ = p;
+    return result;
+  }
+
+  /**
+   * Robi głęboką kopię wielomianu.
+   * @param[in] other : wielomian
+   */
+  Polynomial(const Polynomial &other) : p_(PolyClone(&other.p_)) {}
+
+  /**
+   * Przenosi wielomian bez kopiowania jednomianów.
+   * @param[in,out] other : wielomian; zostaje zerem
+   */
+  Polynomial(Polynomial &&other) noexcept : p_(other.p_) {
+    other.p_ = PolyZero();
+  }
+
+  /**
+   * Oblicza wyrażenie.
+   * @param[in] e : wyrażenie
+   */
+  template <class E>
+  Polynomial(const detail::Expr<E> &e) : p_(detail::Evaluate(e.Self())) {}
+
+  /** Usuwa wielomian. */
+  ~Polynomial() {
+    PolyDestroy(&p_);
+  }
+
+  /**
+   * Zastępuje wielomian kopią innego.
+   * @param[in] other : wielomian
+   * @return ten obiekt
+   */
+  Polynomial &operator=(const Polynomial &other) {
+    Polynomial copy(other);
+    std::swap(p_, copy.p_);
+    return *this;
+  }
+
+  /**
+   * Zastępuje wielomian innym bez kopiowania jednomianów.
+   * @param[in,out] other : wielomian; dostaje poprzednią wartość
+   * @return ten obiekt
+   */
+  Polynomial &operator=(Polynomial &&other) noexcept {
+    std::swap(p_, other.p_);
+    return *this;
+  }
+
+  /**
+   * Zastępuje wielomian wartością wyrażenia. Wyrażenie może zawierać
+   * ten obiekt, bo jest obliczane przed usunięciem poprzedniej wartości.
+   * @param[in] e : wyrażenie
+   * @return ten obiekt
+   */
+  template <class E>
+  Polynomial &operator=(const detail::Expr<E> &e) {
+    Poly result = detail::Evaluate(e.Self());
+    PolyDestroy(&p_);
+    p_ = result;
+    return *this;
+  }
+
+  /**
+   * Dodaje wyrażenie, scalając jego składniki bezpośrednio z tym
+   * wielomianem.
+   * @param[in] e : wyrażenie
+   * @return ten obiekt
+   */
+  template <class E>
+  Polynomial &operator+=(const detail::Expr<E> &e) {
+    detail::Accumulate(p_, e.Self(), 1);
+    return *this;
+  }
+
+  /**
+   * Odejmuje wyrażenie, scalając jego składniki bezpośrednio z tym
+   * wielomianem.
+   * @param[in] e : wyrażenie
+   * @return ten obiekt
+   */
+  template <class E>
+  Polynomial &operator-=(const detail::Expr<E> &e) {
+    detail::Accumulate(p_, e.Self(), -1);
+    return *this;
+  }
+
+  /**
+   * Mnoży przez wyrażenie.
+   * @param[in] e : wyrażenie
+   * @return ten obiekt
+   */
+  template <class E>
+  Polynomial &operator*=(const detail::Expr<E> &e);
+
+  /**
+   * Daje wielomian bez przekazywania własności.
+   * @return wielomian
+   */
+  const Poly &Get() const noexcept {
+    return p_;
+  }
+
+  /**
+   * Przekazuje wielomian wywołującemu, który musi go usunąć.
+   * Obiekt zostaje zerem.
+   * @return wielomian
+   */
+  Poly Release() noexcept {
+    Poly result = p_;
+    p_ = PolyZero();
+    return result;
+  }
+
+  /**
+   * Sprawdza, czy wielomian jest współczynnikiem.
+   * @return czy wielomian jest współczynnikiem
+   */
+  bool IsCoeff() const {
+    return PolyIsCoeff(&p_);
+  }
+
+  /**
+   * Sprawdza, czy wielomian jest tożsamościowo równy zeru.
+   * @return czy wielomian jest równy zeru
+   */
+  bool IsZero() const {
+    return PolyIsZero(&p_);
+  }
+
+  /**
+   * Zwraca stopień wielomianu.
+   * @return stopień wielomianu albo -1 dla zera
+   */
+  poly_exp_t Deg() const {
+    return PolyDeg(&p_);
+  }
+
+  /**
+   * Zwraca stopień wielomianu ze względu na zadaną zmienną.
+   * @param[in] varIdx : indeks zmiennej
+   * @return stopień wielomianu ze względu na zmienną @f$x_{varIdx}@f$
+   */
+  poly_exp_t DegBy(size_t varIdx) const {
+    return PolyDegBy(&p_, varIdx);
+  }
+
+  /**
+   * Zwraca liczbę jednomianów wielu zmiennych wielomianu.
+   * @return liczba jednomianów
+   */
+  size_t TermCount() const {
+    return PolyTermCount(&p_);
+  }
+
+  /**
+   * Wylicza wartość wielomianu w punkcie @p x.
+   * @param[in] x : wartość argumentu
+   * @return @f$p(x, x_0, x_1, \ldots)@f$
+   */
+  Polynomial At(poly_coeff_t x) const {
+    return Adopt(PolyAt(&p_, x));
+  }
+
+  /**
+   * Podnosi wielomian do potęgi.
+   * @param[in] n : wykładnik, @f$n \geq 0@f$
+   * @return @f$p^n@f$
+   */
+  Polynomial Pow(poly_exp_t n) const {
+    return Adopt(PolyPow(&p_, n));
+  }
+
+  /** Przenosi wielomian do jednego bloku pamięci (patrz PolyCompact). */
+  void Compact() {
+    PolyCompact(&p_);
+  }
+
+  /**
+   * Sprawdza równość dwóch wielomianów.
+   * @param[in] p : wielomian
+   * @param[in] q : wielomian
+   * @return @f$p = q@f$
+   */
+  friend bool operator==(const Polynomial &p, const Polynomial &q) {
+    return PolyIsEq(&p.p_, &q.p_);
+  }
+
+  /**
+   * Sprawdza nierówność dwóch wielomianów.
+   * @param[in] p : wielomian
+   * @param[in] q : wielomian
+   * @return @f$p \neq q@f$
+   */
+  friend bool operator!=(const Polynomial &p, const Polynomial &q) {
+    return !PolyIsEq(&p.p_, &q.p_);
+  }
+
+private:
+  Poly p_; ///< wielomian, którego właścicielem jest obiekt
+};
+
+namespace detail {
+
+/** To jest iloczyn czynników pomnożony przez współczynnik. */
+struct Product {
+  poly_coeff_t scale; ///< współczynnik iloczynu
+  std::vector<const Poly *> factors; ///< czynniki iloczynu
+};
+
+/**
+ * To jest wyrażenie sprowadzone do sumy składników, które biblioteka
+ * umie dodać do wyniku bez wielomianów pośrednich. Wielomiany, które
+ * trzeba było obliczyć, np. sumy będące czynnikami iloczynu, są usuwane
+ * razem z obiektem.
+ */
+struct Terms {
+  std::vector<const Poly *> sum; ///< składniki o współczynniku 1
+  /** To są składniki pomnożone przez współczynnik różny od 1. */
+  std::vector<std::pair<poly_coeff_t, const Poly *>> scaled;
+  std::vector<Product> products; ///< iloczyny
+  std::deque<Poly> owned; ///< obliczone wielomiany pomocnicze
+
+  Terms() = default;
+  Terms(const Terms &) = delete;
+  Terms &operator=(const Terms &) = delete;
+
+  /** Usuwa obliczone wielomiany pomocnicze. */
+  ~Terms() {
+    for (Poly &p : owned)
+      PolyDestroy(&p);
+  }
+
+  /**
+   * Przejmuje wielomian pomocniczy. Kolejka nie przenosi elementów,
+   * więc zwrócony wskaźnik jest ważny do usunięcia obiektu.
+   * @param[in] p : wielomian
+   * @return wskaźnik na przechowywany wielomian
+   */
+  const Poly *Keep(Poly p) {
+    owned.push_back(p);
+    return &owned.back();
+  }
+};
+
+/**
+ * Mnoży dwa współczynniki wyrażenia tak jak biblioteka. W trybie modularnym
+ * liczy modulo moduł, a w zwykłym przepełnia się jak arytmetyka biblioteki.
+ * W trybie dokładnym iloczyn, który nie mieści się w typie poly_coeff_t,
+ * nie jest liczony; wywołujący mnoży wtedy wielomian funkcją PolyMulCoeff.
+ * @param[in] a : współczynnik
+ * @param[in] b : współczynnik
+ * @param[out] result : @f$a \cdot b@f$
+ * @return czy iloczyn został policzony
+ */
+inline bool ScaleMul(poly_coeff_t a, poly_coeff_t b, poly_coeff_t *result) {
+  poly_coeff_t m = PolyGetModulus();
+  if (m != 0) {
+    *result = (poly_coeff_t) ((long long) (a % m) * (long long) (b % m) %
+                              (long long) m);
+    return true;
+  }
+  return !__builtin_mul_overflow(a, b, result) || !PolyGetExact();
+}
+
+/**
+ * Dodaje do składników wyrażenie pomnożone przez dwa współczynniki,
+ * których iloczynu nie da się zapisać jednym współczynnikiem. Wyrażenie
+ * jest obliczane i mnożone przez @p c funkcją PolyMulCoeff.
+ * @param[in,out] terms : składniki
+ * @param[in] scale : współczynnik
+ * @param[in] c : współczynnik
+ * @param[in] e : wyrażenie
+ */
+template <class E>
+void CollectApplied(Terms &terms, poly_coeff_t scale, poly_coeff_t c,
+                    const E &e) {
+  Poly value = Evaluate(e);
+  const Poly *scaled = terms.Keep(PolyMulCoeff(&value, c));
+  PolyDestroy(&value);
+  if (scale == 1)
+    terms.sum.push_back(scaled);
+  else
+    terms.scaled.emplace_back(scale, scaled);
+}
+
+/**
+ * Dodaje do akumulatora wielomian pomnożony przez współczynnik.
+ * @param[in,out] acc : akumulator
+ * @param[in] c : współczynnik
+ * @param[in] p : wielomian; może być równy @p acc
+ */
+inline void LinCombInto(Poly &acc, poly_coeff_t c, const Poly *p) {
+  Poly result = PolyLinComb(1, &acc, c, p);
+  PolyDestroy(&acc);
+  acc = result;
+}
+
+/**
+ * Mnoży czynniki iloczynu, większe zostawiając na koniec
+ * (patrz PolyMulMany).
+ * @param[in] factors : czynniki
+ * @return iloczyn czynników
+ */
+inline Poly MulFactors(std::vector<const Poly *> &factors) {
+  if (factors.size() == 2)
+    return PolyMul(factors[0], factors[1]);
+  return PolyMulMany(factors.size(), factors.data());
+}
+
+/**
+ * Dodaje do akumulatora iloczyn, nie tworząc go. Czynnik o największej
+ * liczbie jednomianów jest przekazywany funkcji PolyFmaInPlace
+ * bezpośrednio, a pozostałe są wcześniej mnożone i skalowane.
+ * @param[in,out] acc : akumulator
+ * @param[in,out] terms : składniki, które przechowają wielomiany pomocnicze
+ * @param[in,out] product : iloczyn
+ */
+inline void FmaInto(Poly &acc, Terms &terms, Product &product) {
+  std::vector<const Poly *> &f = product.factors;
+  if (product.scale == 0)
+    return;
+  if (f.size() == 1) {
+    LinCombInto(acc, product.scale, f[0]);
+    return;
+  }
+
+  size_t largest = 0;
+  for (size_t i = 1; i < f.size(); i++)
+    if (PolyTermCount(f[i]) > PolyTermCount(f[largest]))
+      largest = i;
+  std::swap(f[largest], f.back());
+  const Poly *q = f.back();
+  f.pop_back();
+
+  const Poly *p = f.size() == 1 ? f[0] : terms.Keep(MulFactors(f));
+  if (product.scale != 1)
+    p = terms.Keep(PolyMulCoeff(p, product.scale));
+  PolyFmaInPlace(&acc, p, q);
+}
+
+/**
+ * Dodaje do akumulatora wszystkie składniki wyrażenia.
+ * @param[in,out] acc : akumulator; nie może występować w @p terms
+ * @param[in,out] terms : składniki
+ */
+inline void AccumulateTerms(Poly &acc, Terms &terms) {
+  if (!terms.sum.empty()) {
+    if (!PolyIsZero(&acc))
+      terms.sum.push_back(&acc);
+    Poly result = PolyAddMany(terms.sum.size(), terms.sum.data());
+    PolyDestroy(&acc);
+    acc = result;
+  }
+  for (auto &term : terms.scaled)
+    LinCombInto(acc, term.first, term.second);
+  for (Product &product : terms.products)
+    FmaInto(acc, terms, product);
+}
+
+/**
+ * Oblicza wyrażenie sprowadzone do składników. Pojedynczy iloczyn
+ * jest liczony funkcją PolyMul albo PolyMulMany, które same wybierają
+ * algorytm.
+ * @param[in,out] terms : składniki
+ * @return wartość wyrażenia
+ */
+inline Poly EvaluateTerms(Terms &terms) {
+  if (terms.sum.empty() && terms.scaled.empty() &&
+      terms.products.size() == 1 && terms.products[0].scale == 1 &&
+      terms.products[0].factors.size() > 1)
+    return MulFactors(terms.products[0].factors);
+
+  Poly acc = PolyZero();
+  AccumulateTerms(acc, terms);
+  return acc;
+}
+
+/** To jest liść wyrażenia, czyli wielomian obiektu klasy Polynomial. */
+struct Leaf : Expr<Leaf> {
+  const Poly *p; ///< wielomian
+
+  /**
+   * Tworzy liść.
+   * @param[in] poly : obiekt, którego wielomian jest liściem
+   */
+  explicit Leaf(const Polynomial &poly) : p(&poly.Get()) {}
+
+  /**
+   * Dodaje wyrażenie pomnożone przez @p scale do składników.
+   * @param[in,out] terms : składniki
+   * @param[in] scale : współczynnik
+   */
+  void Collect(Terms &terms, poly_coeff_t scale) const {
+    if (scale == 1)
+      terms.sum.push_back(p);
+    else
+      terms.scaled.emplace_back(scale, p);
+  }
+
+  /**
+   * Dodaje wyrażenie do czynników iloczynu.
+   * @param[in,out] terms : składniki
+   * @param[in,out] product : iloczyn
+   */
+  void Factors(Terms &terms, Product &product) const {
+    (void) terms;
+    product.factors.push_back(p);
+  }
+
+  /**
+   * Sprawdza, czy wyrażenie zawiera wielomian.
+   * @param[in] q : wielomian
+   * @return czy @p q jest jednym z liści
+   */
+  bool Refers(const Poly *q) const {
+    return p == q;
+  }
+};
+
+/**
+ * Daje węzeł wyrażenia przechowywany w wyrażeniu nadrzędnym.
+ * Obiekty klasy Polynomial są zastępowane liśćmi, a pozostałe wyrażenia
+ * są kopiowane, bo zawierają tylko wskaźniki i współczynniki.
+ * @param[in] e : wyrażenie
+ * @return węzeł
+ */
+template <class E>
+const E &MakeNode(const E &e) {
+  return e;
+}
+
+/**
+ * Daje liść dla obiektu klasy Polynomial.
+ * @param[in] p : wielomian
+ * @return liść
+ */
+inline Leaf MakeNode(const Polynomial &p) {
+  return Leaf(p);
+}
+
+/** To jest typ węzła przechowywanego dla wyrażenia typu @p E. */
+template <class E>
+using Node = std::decay_t<decltype(MakeNode(std::declval<const E &>()))>;
+
+/** To jest suma dwóch wyrażeń. */
+template <class L, class R>
+struct Sum : Expr<Sum<L, R>> {
+  L l; ///< lewy składnik
+  R r; ///< prawy składnik
+
+  /**
+   * Tworzy sumę.
+   * @param[in] l : lewy składnik
+   * @param[in] r : prawy składnik
+   */
+  Sum(const L &l, const R &r) : l(l), r(r) {}
+
+  /**
+   * Dodaje wyrażenie pomnożone przez @p scale do składników.
+   * @param[in,out] terms : składniki
+   * @param[in] scale : współczynnik
+   */
+  void Collect(Terms &terms, poly_coeff_t scale) const {
+    l.Collect(terms, scale);
+    r.Collect(terms, scale);
+  }
+
+  /**
+   * Dodaje wyrażenie, obliczone osobno, do czynników iloczynu.
+   * @param[in,out] terms : składniki
+   * @param[in,out] product : iloczyn
+   */
+  void Factors(Terms &terms, Product &product) const {
+    product.factors.push_back(terms.Keep(Evaluate(*this)));
+  }
+
+  /**
+   * Sprawdza, czy wyrażenie zawiera wielomian.
+   * @param[in] q : wielomian
+   * @return czy @p q jest jednym z liści
+   */
+  bool Refers(const Poly *q) const {
+    return l.Refers(q) || r.Refers(q);
+  }
+};
+
+/** To jest różnica dwóch wyrażeń. */
+template <class L, class R>
+struct Diff : Expr<Diff<L, R>> {
+  L l; ///< odjemna
+  R r; ///< odjemnik
+
+  /**
+   * Tworzy różnicę.
+   * @param[in] l : odjemna
+   * @param[in] r : odjemnik
+   */
+  Diff(const L &l, const R &r) : l(l), r(r) {}
+
+  /**
+   * Dodaje wyrażenie pomnożone przez @p scale do składników.
+   * @param[in,out] terms : składniki
+   * @param[in] scale : współczynnik
+   */
+  void Collect(Terms &terms, poly_coeff_t scale) const {
+    l.Collect(terms, scale);
+    poly_coeff_t negated;
+    if (ScaleMul(scale, -1, &negated))
+      r.Collect(terms, negated);
+    else
+      CollectApplied(terms, scale, -1, r);
+  }
+
+  /**
+   * Dodaje wyrażenie, obliczone osobno, do czynników iloczynu.
+   * @param[in,out] terms : składniki
+   * @param[in,out] product : iloczyn
+   */
+  void Factors(Terms &terms, Product &product) const {
+    product.factors.push_back(terms.Keep(Evaluate(*this)));
+  }
+
+  /**
+   * Sprawdza, czy wyrażenie zawiera wielomian.
+   * @param[in] q : wielomian
+   * @return czy @p q jest jednym z liści
+   */
+  bool Refers(const Poly *q) const {
+    return l.Refers(q) || r.Refers(q);
+  }
+};
+
+/** To jest wyrażenie pomnożone przez współczynnik. */
+template <class E>
+struct Scaled : Expr<Scaled<E>> {
+  poly_coeff_t c; ///< współczynnik
+  E e; ///< wyrażenie
+
+  /**
+   * Tworzy wyrażenie pomnożone przez współczynnik.
+   * @param[in] c : współczynnik
+   * @param[in] e : wyrażenie
+   */
+  Scaled(poly_coeff_t c, const E &e) : c(c), e(e) {}
+
+  /**
+   * Dodaje wyrażenie pomnożone przez @p scale do składników.
+   * @param[in,out] terms : składniki
+   * @param[in] scale : współczynnik
+   */
+  void Collect(Terms &terms, poly_coeff_t scale) const {
+    poly_coeff_t folded;
+    if (ScaleMul(scale, c, &folded))
+      e.Collect(terms, folded);
+    else
+      CollectApplied(terms, scale, c, e);
+  }
+
+  /**
+   * Dodaje wyrażenie do czynników iloczynu, przenosząc współczynnik
+   * na cały iloczyn. Jeśli iloczyn współczynników nie mieści się w jednym
+   * współczynniku, wyrażenie jest obliczane osobno jako czynnik.
+   * @param[in,out] terms : składniki
+   * @param[in,out] product : iloczyn
+   */
+  void Factors(Terms &terms, Product &product) const {
+    poly_coeff_t folded;
+    if (ScaleMul(product.scale, c, &folded)) {
+      product.scale = folded;
+      e.Factors(terms, product);
+    } else {
+      product.factors.push_back(terms.Keep(Evaluate(*this)));
+    }
+  }
+
+  /**
+   * Sprawdza, czy wyrażenie zawiera wielomian.
+   * @param[in] q : wielomian
+   * @return czy @p q jest jednym z liści
+   */
+  bool Refers(const Poly *q) const {
+    return e.Refers(q);
+  }
+};
+
+/** To jest iloczyn dwóch wyrażeń. */
+template <class L, class R>
+struct Prod : Expr<Prod<L, R>> {
+  L l; ///< lewy czynnik
+  R r; ///< prawy czynnik
+
+  /**
+   * Tworzy iloczyn.
+   * @param[in] l : lewy czynnik
+   * @param[in] r : prawy czynnik
+   */
+  Prod(const L &l, const R &r) : l(l), r(r) {}
+
+  /**
+   * Dodaje wyrażenie pomnożone przez @p scale do składników jako jeden
+   * iloczyn wszystkich zagnieżdżonych czynników.
+   * @param[in,out] terms : składniki
+   * @param[in] scale : współczynnik
+   */
+  void Collect(Terms &terms, poly_coeff_t scale) const {
+    Product product = {scale, {}};
+    Factors(terms, product);
+    terms.products.push_back(std::move(product));
+  }
+
+  /**
+   * Dodaje oba czynniki do czynników iloczynu.
+   * @param[in,out] terms : składniki
+   * @param[in,out] product : iloczyn
+   */
+  void Factors(Terms &terms, Product &product) const {
+    l.Factors(terms, product);
+    r.Factors(terms, product);
+  }
+
+  /**
+   * Sprawdza, czy wyrażenie zawiera wielomian.
+   * @param[in] q : wielomian
+   * @return czy @p q jest jednym z liści
+   */
+  bool Refers(const Poly *q) const {
+    return l.Refers(q) || r.Refers(q);
+  }
+};
+
+/**
+ * Oblicza wyrażenie.
+ * @param[in] e : wyrażenie
+ * @return wartość wyrażenia
+ */
+template <class E>
+Poly Evaluate(const E &e) {
+  Terms terms;
+  MakeNode(e).Collect(terms, 1);
+  return EvaluateTerms(terms);
+}
+
+/**
+ * Dodaje do akumulatora wyrażenie pomnożone przez współczynnik. Jeśli
+ * wyrażenie zawiera akumulator, jest najpierw obliczane osobno, bo
+ * akumulator zmienia się w trakcie dodawania składników.
+ * @param[in,out] acc : akumulator
+ * @param[in] e : wyrażenie
+ * @param[in] scale : współczynnik
+ */
+template <class E>
+void Accumulate(Poly &acc, const E &e, poly_coeff_t scale) {
+  Terms terms;
+  if (MakeNode(e).Refers(&acc)) {
+    const Poly *value = terms.Keep(Evaluate(e));
+    LinCombInto(acc, scale, value);
+    return;
+  }
+  MakeNode(e).Collect(terms, scale);
+  AccumulateTerms(acc, terms);
+}
+
+/**
+ * Tworzy sumę wyrażeń.
+ * @param[in] l : wyrażenie
+ * @param[in] r : wyrażenie
+ * @return wyrażenie @f$l + r@f$
+ */
+template <class L, class R>
+Sum<Node<L>, Node<R>> operator+(const Expr<L> &l, const Expr<R> &r) {
+  return {MakeNode(l.Self()), MakeNode(r.Self())};
+}
+
+/**
+ * Tworzy różnicę wyrażeń.
+ * @param[in] l : wyrażenie
+ * @param[in] r : wyrażenie
+ * @return wyrażenie @f$l - r@f$
+ */
+template <class L, class R>
+Diff<Node<L>, Node<R>> operator-(const Expr<L> &l, const Expr<R> &r) {
+  return {MakeNode(l.Self()), MakeNode(r.Self())};
+}
+
+/**
+ * Tworzy iloczyn wyrażeń.
+ * @param[in] l : wyrażenie
+ * @param[in] r : wyrażenie
+ * @return wyrażenie @f$l \cdot r@f$
+ */
+template <class L, class R>
+Prod<Node<L>, Node<R>> operator*(const Expr<L> &l, const Expr<R> &r) {
+  return {MakeNode(l.Self()), MakeNode(r.Self())};
+}
+
+/**
+ * Tworzy wyrażenie pomnożone przez współczynnik.
+ * @param[in] c : współczynnik
+ * @param[in] e : wyrażenie
+ * @return wyrażenie @f$c \cdot e@f$
+ */
+template <class E>
+Scaled<Node<E>> operator*(poly_coeff_t c, const Expr<E> &e) {
+  return {c, MakeNode(e.Self())};
+}
+
+/**
+ * Tworzy wyrażenie pomnożone przez współczynnik.
+ * @param[in] e : wyrażenie
+ * @param[in] c : współczynnik
+ * @return wyrażenie @f$e \cdot c@f$
+ */
+template <class E>
+Scaled<Node<E>> operator*(const Expr<E> &e, poly_coeff_t c) {
+  return {c, MakeNode(e.Self())};
+}
+
+/**
+ * Tworzy wyrażenie przeciwne.
+ * @param[in] e : wyrażenie
+ * @return wyrażenie @f$-e@f$
+ */
+template <class E>
+Scaled<Node<E>> operator-(const Expr<E> &e) {
+  return {-1, MakeNode(e.Self())};
+}
+
+} // namespace detail
+
+template <class E>
+Polynomial &Polynomial::operator*=(const detail::Expr<E> &e) {
+  return *this = *this * e.Self();
+}
+
+} // namespace poly
+
+#endif /* __POLY_HPP__ */
@@ -0,0 +1,77 @@
+/** @file
+ * Test wydajności przejść po bardzo głęboko zagnieżdżonych wielomianach
+ *
+ * Tworzy łańcuch @f$x_0x_1\ldots x_{n-1}@f$ o zadanym zagłębieniu
+ * (domyślnie @f$10^6@f$) i mierzy czasy kopiowania, porównywania,
+ * obliczania stopnia i usuwania wielomianu. Przy rekurencyjnych
+ * przejściach takie zagłębienie przepełnia stos wywołań.
+ *
+ * @author Filip Głębocki <fg429202@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2021
+ */
+
+#include "poly.h"
+#include <stdio.h>
+#include <time.h>
+
+/** To jest domyślne zagłębienie łańcucha. */
+#define DEFAULT_DEPTH 1000000
+
+/**
+ * Daje czas procesora, który upłynął od chwili @p start.
+ * @param[in] start : chwila początkowa
+ * @return czas w sekundach
+ */
+static double Elapsed(clock_t start) {
+  return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+/**
+ * Tworzy wielomian @f$x_0x_1\ldots x_{depth-1}@f$.
+ * @param[in] depth : zagłębienie
+ * @return wielomian
+ */
+static Poly MakeChain(size_t depth) {
+  Poly p = PolyFromCoeff(1);
+  for (size_t i = 0; i < depth; i++) {
+    Mono m = MonoFromPoly(&p, 1);
+    p = PolyAddMonos(1, &m);
+  }
+  return p;
+}
+
+/**
+ * Główna funkcja testu wydajności.
+ * @param[in] argc : liczba argumentów
+ * @param[in] argv : argumenty; opcjonalnie zagłębienie łańcucha
+ * @return kod wyjścia programu
+ */
+int main(int argc, char *argv[]) {
+  size_t depth = DEFAULT_DEPTH;
+  if (argc > 1)
+    depth = strtoul(argv[1], NULL, 10);
+
+  clock_t start = clock();
+  Poly p = MakeChain(depth);
+  printf("build    %zu: %.3f s\n", depth, Elapsed(start));
+
+  start = clock();
+  Poly q = PolyClone(&p);
+  printf("clone    %zu: %.3f s\n", depth, Elapsed(start));
+
+  start = clock();
+  bool eq = PolyIsEq(&p, &q);
+  printf("is_eq    %zu: %.3f s\n", depth, Elapsed(start));
+
+  start = clock();
+  poly_exp_t deg = PolyDeg(&p);
+  printf("deg      %zu: %.3f s\n", depth, Elapsed(start));
+
+  start = clock();
+  PolyDestroy(&p);
+  PolyDestroy(&q);
+  printf("destroy  %zu: %.3f s\n", depth, Elapsed(start));
+
+  return (eq && (size_t) deg == depth) ? 0 : 1;
+}
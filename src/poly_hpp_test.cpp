@@ -0,0 +1,297 @@
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+
+#include "poly.hpp"
+#include "flat_poly.hpp"
+#include "builder.h"
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+using poly::FlatPoly;
+using poly::Polynomial;
+
+/** FUNKCJE POMOCNICZE **/
+
+static Polynomial RandomTerms(size_t count, size_t vars, poly_exp_t span,
+                              unsigned long *seed) {
+  PolyBuilder b = PolyBuilderInit();
+  poly_exp_t exps[8];
+  assert(vars <= 8);
+  for (size_t i = 0; i < count; ++i) {
+    for (size_t j = 0; j < vars; ++j) {
+      *seed = *seed * 6364136223846793005UL + 1442695040888963407UL;
+      exps[j] = (*seed >> 33) % span;
+    }
+    PolyBuilderAddTerm(&b, vars, exps, (poly_coeff_t) (*seed >> 40) % 7 - 3);
+  }
+  return Polynomial::Adopt(PolyBuilderFinish(&b));
+}
+
+static bool IsEq(const Polynomial &p, Poly q) {
+  bool res = PolyIsEq(&p.Get(), &q);
+  PolyDestroy(&q);
+  return res;
+}
+
+/** TESTY **/
+
+static bool RaiiTest(void) {
+  unsigned long seed = 44;
+  Polynomial p = RandomTerms(30, 3, 5, &seed);
+  const Mono *arr = p.Get().arr;
+
+  Polynomial moved = std::move(p);
+  bool res = moved.Get().arr == arr && p.IsZero();
+
+  Polynomial copy = moved;
+  res &= copy == moved && copy.Get().arr != arr;
+
+  p = std::move(copy);
+  res &= p == moved;
+  copy = p;
+  res &= copy == p;
+  copy = copy;
+  res &= copy == p;
+
+  Poly raw = moved.Release();
+  res &= raw.arr == arr && moved.IsZero();
+  Polynomial adopted = Polynomial::Adopt(raw);
+  res &= adopted == p;
+
+  Polynomial c = 5;
+  res &= c.IsCoeff() && c.Get().coeff == 5 && Polynomial().IsZero();
+  res &= p.Pow(2) == p * p && p.At(2).Deg() <= p.Deg();
+
+#ifndef POLY_COEFF_MODULUS
+  /* W trybie dokładnym wartość z zakresu uchwytów jest liczbą, a nie
+   * uchwytem, więc trafia do puli liczb dowolnej precyzji. */
+  PolySetExact(true);
+  {
+    Polynomial one = 1;
+    Polynomial low = POLY_COEFF_MIN + 5;
+    Polynomial expected =
+        Polynomial::Adopt(PolyMulCoeff(&one.Get(), POLY_COEFF_MIN + 5));
+    char *str = PolyCoeffToString(low.Get().coeff);
+    res &= PolyCoeffIsBig(low.Get().coeff) && low == expected && str[0] == '-';
+    free(str);
+  }
+  PolyBigRelease();
+  PolySetExact(false);
+#endif
+  return res;
+}
+
+static bool ExprTest(void) {
+  unsigned long seed = 45;
+  Polynomial a = RandomTerms(30, 3, 5, &seed);
+  Polynomial b = RandomTerms(20, 2, 5, &seed);
+  Polynomial c = RandomTerms(40, 3, 6, &seed);
+  Polynomial d = RandomTerms(10, 1, 9, &seed);
+  const Poly *pa = &a.Get(), *pb = &b.Get(), *pc = &c.Get(), *pd = &d.Get();
+
+  Poly ab = PolyMul(pa, pb);
+  Poly abc = PolyAdd(&ab, pc);
+  bool res = IsEq(a * b + c - d, PolySub(&abc, pd));
+
+  Poly sum = PolyAdd(pa, pb);
+  Poly sum2 = PolyAdd(&sum, pc);
+  res &= IsEq(a + b + c, PolyClone(&sum2));
+  res &= IsEq(-(a + b + c), PolyNeg(&sum2));
+  res &= IsEq(a + b + c + d, PolyAdd(&sum2, pd));
+
+  Poly cd = PolySub(pc, pd);
+  res &= IsEq((a + b) * (c - d), PolyMul(&sum, &cd));
+
+  Poly abcd = PolyMul(&ab, pc);
+  res &= IsEq(a * b * c, PolyClone(&abcd));
+  Poly scaled = PolyMulCoeff(&abcd, -6);
+  res &= IsEq(2 * a * (b * -3) * c, PolyClone(&scaled));
+  Poly lin = PolyLinComb(4, pa, -1, pd);
+  res &= IsEq(a * 4 - d, PolyClone(&lin));
+  res &= IsEq(a * 4 - d + 2 * a * (b * -3) * c, PolyAdd(&lin, &scaled));
+  res &= IsEq(a - a, PolyZero());
+
+  PolyDestroy(&ab);
+  PolyDestroy(&abc);
+  PolyDestroy(&sum);
+  PolyDestroy(&sum2);
+  PolyDestroy(&cd);
+  PolyDestroy(&abcd);
+  PolyDestroy(&scaled);
+  PolyDestroy(&lin);
+
+#ifndef POLY_COEFF_MODULUS
+  /* W trybie dokładnym iloczyny współczynników wyrażenia nie mieszczą się
+   * w typie poly_coeff_t, a mimo to wynik jest dokładny. */
+  PolySetExact(true);
+  {
+    poly_coeff_t k = (poly_coeff_t) 1 << (POLY_COEFF_BITS * 5 / 8);
+    Polynomial x = RandomTerms(8, 2, 4, &seed);
+    Polynomial y = RandomTerms(6, 2, 4, &seed);
+    Poly kx = PolyMulCoeff(&x.Get(), k);
+    Poly xy = PolyMul(&x.Get(), &y.Get());
+    Poly kxy = PolyMulCoeff(&xy, k);
+    Poly diff = PolySub(&x.Get(), &y.Get());
+
+    res &= IsEq(k * (k * x), PolyMulCoeff(&kx, k));
+    res &= IsEq((k * x) * (y * k), PolyMulCoeff(&kxy, k));
+    res &= IsEq(POLY_COEFF_MIN * (x - y), PolyMulCoeff(&diff, POLY_COEFF_MIN));
+    res &= !Polynomial(k * (k * x)).IsZero();
+
+    PolyDestroy(&kx);
+    PolyDestroy(&xy);
+    PolyDestroy(&kxy);
+    PolyDestroy(&diff);
+  }
+  PolyBigRelease();
+  PolySetExact(false);
+#endif
+  return res;
+}
+
+static bool AliasTest(void) {
+  unsigned long seed = 46;
+  Polynomial a = RandomTerms(30, 3, 5, &seed);
+  Polynomial b = RandomTerms(20, 2, 5, &seed);
+  Polynomial c = RandomTerms(25, 3, 4, &seed);
+
+  Polynomial expected = a * a + a;
+  a = a * a + a;
+  bool res = a == expected;
+
+  expected = a + b * c;
+  a += b * c;
+  res &= a == expected;
+
+  expected = a - a * b + 3 * c;
+  a -= a * b - 3 * c;
+  res &= a == expected;
+
+  expected = a * (b + c);
+  a *= b + c;
+  res &= a == expected;
+
+  expected = b + b;
+  b += b;
+  res &= b == expected;
+  return res;
+}
+
+template <size_t N>
+static bool FlatCase(const Polynomial &p, const Polynomial &q) {
+  using Flat = FlatPoly<N>;
+  Flat fp = Flat::FromPoly(p);
+  Flat fq = Flat::FromPoly(q);
+  bool res = fp.ToPoly() == p && fq.ToPoly() == q;
+  res &= fp.Terms().size() == p.TermCount();
+  res &= (fp * fq).ToPoly() == p * q && (fp + fq).ToPoly() == p + q;
+  res &= (fp - fq).ToPoly() == p - q && (-fp).ToPoly() == -p;
+  res &= (fp - fp).IsZero() && fp.Deg() == p.Deg();
+
+  typename Flat::Exps degs = fp.DegByAll();
+  for (size_t i = 0; i < N; ++i)
+    res &= degs[i] == p.DegBy(i);
+  res &= fp.template DegBy<N - 1>() == p.DegBy(N - 1);
+  return res;
+}
+
+static bool FlatPolyTest(void) {
+  unsigned long seed = 47;
+  Polynomial a = RandomTerms(40, 4, 6, &seed);
+  Polynomial b = RandomTerms(30, 3, 9, &seed);
+  Polynomial c = RandomTerms(20, 2, 5, &seed);
+  /* Wykładniki iloczynu nie mieszczą się w 16 bitach. */
+  Polynomial big = RandomTerms(15, 4, 40000, &seed);
+  Polynomial constant = 7;
+
+  bool res = FlatCase<4>(a, b) && FlatCase<4>(b, c) && FlatCase<4>(a, big);
+  res &= FlatCase<4>(big, big) && FlatCase<4>(constant, a);
+  res &= FlatCase<4>(Polynomial(), b) && FlatCase<3>(b, c);
+  res &= FlatCase<2>(c, c) && FlatCase<7>(a, b);
+  res &= FlatPoly<3>::Fits(b.Get()) && !FlatPoly<3>::Fits(a.Get());
+
+  /* Wielomian o zbyt wielu zmiennych jest odrzucany, a nie obcinany. */
+  bool thrown = false;
+  try {
+    FlatPoly<3>::FromPoly(a);
+  } catch (const std::invalid_argument &) {
+    thrown = true;
+  }
+  res &= thrown;
+
+  /* Składniki o równych wektorach wykładników są łączone. */
+  using Flat = FlatPoly<2, int>;
+  Flat f = Flat::FromTerms({{{1, 2}, 3}, {{0, 5}, 1}, {{1, 2}, -3},
+                            {{0, 5}, 1}, {{1, 0}, 4}});
+  Flat expected = Flat::FromTerms({{{0, 5}, 2}, {{1, 0}, 4}});
+  res &= f == expected && f.Terms().size() == 2 && f.Deg() == 5;
+  res &= f.Terms()[0].exps[1] == 5 && f.DegBy<0>() == 1;
+
+#ifndef POLY_COEFF_MODULUS
+  /* Współczynniki są liczone w pierścieniu ustawionym w czasie działania,
+   * a iloczyny reszt nie mieszczą się w 32 bitach. */
+  PolySetModulus(2147483647);
+  {
+    Polynomial ma = RandomTerms(25, 3, 5, &seed);
+    Polynomial mb = RandomTerms(20, 2, 7, &seed);
+    Polynomial cube = ma * ma * ma;
+    FlatPoly<3> fa = FlatPoly<3>::FromPoly(ma);
+    res &= FlatCase<3>(ma, mb) && FlatCase<3>(cube, mb);
+    res &= (fa * fa * fa).ToPoly() == cube;
+    FlatPoly<3> neg = FlatPoly<3>::FromTerms({{{0, 1, 0}, -1}});
+    res &= neg.Terms()[0].coeff == 2147483646;
+  }
+  PolySetModulus(0);
+
+  /* Współczynniki trybu dokładnego mogą być uchwytami, więc są odrzucane. */
+  PolySetExact(true);
+  thrown = false;
+  try {
+    FlatPoly<3>::FromPoly(b);
+  } catch (const std::domain_error &) {
+    thrown = true;
+  }
+  res &= thrown;
+  PolySetExact(false);
+#endif
+  return res;
+}
+
+/** URUCHAMIANIE TESTÓW **/
+
+// Możliwe wyniki testu
+#define TEST_PASS  0
+#define TEST_FAIL  125
+#define TEST_WRONG 2
+
+// Liczba elementów tablicy x
+#define SIZE(x) (sizeof (x) / sizeof (x)[0])
+
+typedef struct {
+  char const *name;
+  bool (*function)(void);
+} test_list_t;
+
+#define TEST(t) {#t, t}
+
+static const test_list_t test_list[] = {
+  TEST(RaiiTest),
+  TEST(ExprTest),
+  TEST(AliasTest),
+  TEST(FlatPolyTest),
+};
+
+int main(int argc, char *argv[]) {
+  if (argc != 2)
+    return TEST_WRONG;
+
+  for (size_t i = 0; i < SIZE(test_list); ++i)
+    if (strcmp(argv[1], test_list[i].name) == 0)
+      return test_list[i].function() ? TEST_PASS : TEST_FAIL;
+
+  return TEST_WRONG;
+}
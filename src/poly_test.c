@@ -3,10 +3,13 @@
 #endif
 
 #include "poly.h"
+#include "builder.h"
+#include "parsing.h"
 #include <assert.h>
 #include <limits.h>
 #include <stdbool.h>
 #include <stdarg.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -2831,7 +2834,13 @@ static poly_exp_t exp_arr2[] = {
 
 /** MAKRA I FUNKCJE SKRACAJĄCE ZAPIS TESTÓW **/
 
+#ifdef POLY_COEFF_MODULUS
+/* Biblioteka ze stałym modułem liczy na resztach, więc współczynniki
+ * argumentów i oczekiwanych wyników sprowadzamy do reszt. */
+#define C(c) PolyFromCoeff(PolyCoeffReduce(c))
+#else
 #define C PolyFromCoeff
+#endif
 
 static Mono M(Poly p, poly_exp_t n) {
   return MonoFromPoly(&p, n);
@@ -3120,7 +3129,11 @@ static bool SimpleIsEqTest(void) {
 static bool SimpleAtTest(void) {
   bool res = true;
   res &= TestAt(C(2), 1, C(2));
+#if POLY_COEFF_BITS >= 64
   res &= TestAt(P(C(1), 0, C(1), 18), 10, C(1000000000000000001L));
+#else
+  res &= TestAt(P(C(1), 0, C(1), 9), 10, C(1000000001));
+#endif
   res &= TestAt(P(C(3), 1, C(2), 3, C(1), 5), 10, C(102030));
   res &= TestAt(P(P(C(1), 4), 0, P(C(1), 2), 2, C(1), 3), 2,
                 P(C(8), 0, C(4), 2, C(1), 4));
@@ -3128,11 +3141,17 @@ static bool SimpleAtTest(void) {
 }
 
 static bool OverflowTest(void) {
+#ifdef POLY_COEFF_MODULUS
+  /* Ze stałym modułem współczynniki są resztami i się nie przepełniają. */
+  return true;
+#endif
+  /* Współczynniki przepełniają się modulo 2^k dla k-bitowego typu. */
+  poly_coeff_t half = (poly_coeff_t) 1 << (POLY_COEFF_BITS / 2);
   bool res = true;
-  res &= TestMul(P(C(1L << 32), 1), C(1L << 32), C(0));
-  res &= TestAt(P(C(1), 64), 2, C(0));
-  res &= TestAt(P(C(1), 0, C(1), 64), 2, C(1));
-  res &= TestAt(P(P(C(1), 1), 64), 2, C(0));
+  res &= TestMul(P(C(half), 1), C(half), C(0));
+  res &= TestAt(P(C(1), POLY_COEFF_BITS), 2, C(0));
+  res &= TestAt(P(C(1), 0, C(1), POLY_COEFF_BITS), 2, C(1));
+  res &= TestAt(P(P(C(1), 1), POLY_COEFF_BITS), 2, C(0));
   return res;
 }
 
@@ -3144,20 +3163,20 @@ static bool OverflowTest(void) {
  */
 static bool SimpleArithmeticTest(void) {
   for (poly_coeff_t i = -100; i < 100; ++i) {
-    Poly p1 = PolyFromCoeff(i);
+    Poly p1 = C(i);
     for (poly_coeff_t j = -100; j < 100; ++j) {
-      Poly p2 = PolyFromCoeff(j);
-      if (!TestOpPtr(&p1, &p2, PolyFromCoeff(i + j), PolyAdd))
+      Poly p2 = C(j);
+      if (!TestOpPtr(&p1, &p2, C(i + j), PolyAdd))
         return false;
-      if (!TestOpPtr(&p1, &p2, PolyFromCoeff(i - j), PolySub))
+      if (!TestOpPtr(&p1, &p2, C(i - j), PolySub))
         return false;
-      if (!TestOpPtr(&p1, &p2, PolyFromCoeff(i * j), PolyMul))
+      if (!TestOpPtr(&p1, &p2, C(i * j), PolyMul))
         return false;
-      if (TestOpPtr(&p1, &p2, PolyFromCoeff(i + j + 1), PolyAdd))
+      if (TestOpPtr(&p1, &p2, C(i + j + 1), PolyAdd))
         return false;
-      if (TestOpPtr(&p1, &p2, PolyFromCoeff(i - j - 1), PolySub))
+      if (TestOpPtr(&p1, &p2, C(i - j - 1), PolySub))
         return false;
-      if (TestOpPtr(&p1, &p2, PolyFromCoeff(i * j + 1), PolyMul))
+      if (TestOpPtr(&p1, &p2, C(i * j + 1), PolyMul))
         return false;
       PolyDestroy(&p2);
     }
@@ -3171,7 +3190,7 @@ static bool SimpleArithmeticTest(void) {
  */
 static bool LongPolynomialTest(void) {
   bool res = true;
-  Poly p = PolyFromCoeff(1);
+  Poly p = C(1);
   for (poly_exp_t poly_deg = 10; poly_deg < 90011 && res; poly_deg += 1000) {
     Mono *m = calloc((size_t)poly_deg + 1, sizeof (Mono)); // +1 bo wyraz wolny
     for (poly_exp_t i = 0; i <= poly_deg; ++i) {
@@ -3186,7 +3205,7 @@ static bool LongPolynomialTest(void) {
     Poly mono_sum = PolyAt(&long_p, 1);
     if (!PolyIsCoeff(&mono_sum))
       res = false;
-    Poly mono_sum_poly = PolyFromCoeff(poly_deg + 1);
+    Poly mono_sum_poly = C(poly_deg + 1);
     if (!PolyIsEq(&mono_sum, &mono_sum_poly))
       res = false;
     PolyDestroy(&mono_sum_poly);
@@ -3207,10 +3226,10 @@ static bool LongPolynomialTest(void) {
  * Zakładamy, że poly_coef_r jest typu long.
  */
 static bool AtTest1(void) {
-  Poly p_one = PolyFromCoeff(1);
-  Poly p_two = PolyFromCoeff(2);
+  Poly p_one = C(1);
+  Poly p_two = C(2);
   Poly p, p_res, p_expected_res;
-  p_expected_res = PolyFromCoeff(LONG_MAX);
+  p_expected_res = C(POLY_COEFF_MAX);
   const size_t bits_num = sizeof (poly_coeff_t) * CHAR_BIT - 1;
   Mono m[bits_num];
   for (size_t i = 0; i < bits_num; ++i) {
@@ -3224,7 +3243,7 @@ static bool AtTest1(void) {
   PolyDestroy(&p);
   PolyDestroy(&p_res);
   PolyDestroy(&p_expected_res);
-  p_expected_res = PolyFromCoeff(LONG_MAX - 1);
+  p_expected_res = C(POLY_COEFF_MAX - 1);
   for (size_t i = 0; i < bits_num - 1; ++i) {
     p = PolyClone(&p_two);
     m[i] = MonoFromPoly(&p, i);
@@ -3252,7 +3271,7 @@ static bool AtTest2(void) {
   const size_t poly_depth = 3;
   const size_t upper_size = 5;
   bool result = true;
-  Poly p = PolyFromCoeff(1);
+  Poly p = C(1);
   Mono *m = calloc(poly_size, sizeof (Mono));
   for (size_t j = 0; j < poly_depth; ++j) {
     for (size_t i = 0; i < poly_size; ++i) {
@@ -3263,7 +3282,7 @@ static bool AtTest2(void) {
     p = PolyAddMonos(poly_size, m);
     // p = p + px + ... + px^n
   }
-  Poly p_upper_size = PolyFromCoeff(upper_size);
+  Poly p_upper_size = C(upper_size);
   Poly p2 = PolyMul(&p_upper_size, &p);
   free(m);
   m = calloc(upper_size, sizeof (Mono));
@@ -3295,7 +3314,7 @@ static bool AtTest2(void) {
  * przy wykonywaniu operacji arytmetycznych.
  */
 static bool DegreeOpChangeTest(void) {
-  Poly p_one = PolyFromCoeff(1);
+  Poly p_one = C(1);
   Poly p_res = PolySub(&p_one, &p_one); // 1 - 1
   if (!PolyIsZero(&p_res))
     return false;
@@ -3373,7 +3392,7 @@ static Poly MakePoly(size_t count, const poly_coeff_t *val, poly_exp_t *exp) {
   Mono *tmp = calloc(count, sizeof (Mono));
   size_t shift = 0;
   for (size_t i = 0; i < count; i++) {
-    Poly p = PolyFromCoeff(val[i]);
+    Poly p = C(val[i]);
     if (val[i] == 0) {
       shift--;
       PolyDestroy(&p);
@@ -3415,7 +3434,7 @@ static Poly MakePolyFromPolynomials(size_t count, const Poly *val,
  */
 static Poly RecursiveBuild(int depth, int *exp_shift, int *coef_shift) {
   if (depth == 0) {
-    return PolyFromCoeff(coef_arr1[(*coef_shift)++]);
+    return C(coef_arr1[(*coef_shift)++]);
   }
   else {
     size_t size = exp_arr1[*exp_shift];
@@ -3425,7 +3444,7 @@ static Poly RecursiveBuild(int depth, int *exp_shift, int *coef_shift) {
       Poly p = RecursiveBuild(depth - 1, exp_shift, coef_shift);
       if (PolyIsZero(&p)) {
         PolyDestroy(&p);
-        Poly p2 = PolyFromCoeff(1);
+        Poly p2 = C(1);
         m[i] = MonoFromPoly(&p2, exp_arr2[*exp_shift]);
       }
       else {
@@ -3454,7 +3473,7 @@ static Poly RecursiveBuild2(int depth, int *exp_shift, int *coef_shift,
                             const poly_coeff_t *coef_arr,
                             const poly_exp_t *exp_arr) {
   if (depth == 0) {
-    return PolyFromCoeff(coef_arr[(*coef_shift)++]);
+    return C(coef_arr[(*coef_shift)++]);
   }
   else {
     size_t size = exp_arr[*exp_shift];
@@ -3464,7 +3483,7 @@ static Poly RecursiveBuild2(int depth, int *exp_shift, int *coef_shift,
       Poly p = RecursiveBuild2(depth - 1, exp_shift, coef_shift, coef_arr, exp_arr);
       if (PolyIsZero(&p)) {
         PolyDestroy(&p);
-        Poly p2 = PolyFromCoeff(1);
+        Poly p2 = C(1);
         m[i] = MonoFromPoly(&p2, exp_arr[*exp_shift]);
       }
       else {
@@ -3531,7 +3550,7 @@ static bool MulTest1(void) {
     PolyDestroy(&p2);
   }
   {
-    Poly p_two = PolyFromCoeff(2);
+    Poly p_two = C(2);
     poly_coeff_t val[] = {1, 1};
     poly_exp_t exp[] = {0, 1};
     Poly p1 = MakePoly(2, val, exp);
@@ -3577,7 +3596,7 @@ static Poly BuildRecursivePoly(const poly_coeff_t *coef_arr,
       }
       continue;
     }
-    Poly p = PolyFromCoeff(coef);
+    Poly p = C(coef);
     if (PolyIsZero(&res)) {
       Mono m = MonoFromPoly(&p, exp);
       PolyDestroy(&res);
@@ -3830,9 +3849,9 @@ static bool IsEqTest(void) {
   memcpy(coef_copy, coef_arr1, copy_size * sizeof (poly_coeff_t));
   coef_copy[90]++;
   {
-    Poly p1 = PolyFromCoeff(1);
-    Poly p2 = PolyFromCoeff(1);
-    Poly p3 = PolyFromCoeff(2);
+    Poly p1 = C(1);
+    Poly p2 = C(1);
+    Poly p3 = C(2);
     if (!PolyIsEq(&p1, &p2))
       result = false;
     if (PolyIsEq(&p1, &p3))
@@ -3903,7 +3922,7 @@ static bool RarePolynomialTest(void) {
     sum += coef_arr1[i];
   }
   Poly p = MakePoly(size, coef_arr1, rare_exp_arr);
-  Poly expected_res = PolyFromCoeff(sum);
+  Poly expected_res = C(sum);
   Poly res = PolyAt(&p, 1);
   if (!PolyIsEq(&expected_res, &res))
     result = false;
@@ -3923,7 +3942,7 @@ static bool RarePolynomialTest(void) {
 static bool MemoryThiefTest(void) {
   const size_t poly_size = 10;
   const size_t poly_depth = 3;
-  Poly p = PolyFromCoeff(1);
+  Poly p = C(1);
   Mono *m = calloc(poly_size, sizeof (Mono));
   for (size_t j = 0; j < poly_depth; ++j) {
     for (size_t i = 0; i < poly_size; ++i) {
@@ -3944,15 +3963,15 @@ static bool MemoryThiefTest(void) {
 
 static bool MemoryFreeTest(void) {
   Poly *p = malloc(sizeof (struct Poly));
-  *p = PolyFromCoeff(5);
+  *p = C(5);
   Mono m = MonoFromPoly(p, 4);
-  *p = PolyFromCoeff(3);
+  *p = C(3);
   PolyDestroy(p);
   // To nie jest PolyDestroy, to tylko zwalnia pamięć zaalokowaną przez malloc.
   free(p);
   Poly p2 = PolyAddMonos(1, &m);
   Poly p3 = PolyAt(&p2, 2);
-  Poly p4 = PolyFromCoeff(80);
+  Poly p4 = C(80);
   bool res = PolyIsEq(&p4, &p3);
   PolyDestroy(&p2);
   PolyDestroy(&p3);
@@ -3960,6 +3979,1169 @@ static bool MemoryFreeTest(void) {
   return res;
 }
 
+/** TESTY ROZSZERZEŃ BIBLIOTEKI **/
+
+/**
+ * Oblicza @f$p^n@f$ przez wielokrotne mnożenie, służy jako wzorzec.
+ * @param p wielomian
+ * @param n wykładnik
+ */
+static Poly NaivePow(const Poly *p, poly_exp_t n) {
+  Poly res = C(1);
+  for (poly_exp_t i = 0; i < n; ++i) {
+    Poly tmp = PolyMul(&res, p);
+    PolyDestroy(&res);
+    res = tmp;
+  }
+  return res;
+}
+
+static bool TestPow(Poly p, poly_exp_t n) {
+  Poly a = PolyPow(&p, n);
+  Poly b = NaivePow(&p, n);
+  bool is_eq = PolyIsEq(&a, &b);
+  PolyDestroy(&p);
+  PolyDestroy(&a);
+  PolyDestroy(&b);
+  return is_eq;
+}
+
+/* Zmienne o indeksach od k w górę są zastępowane zerem, więc tablica q
+ * ma dokładnie k elementów i jest alokowana na stercie. */
+static bool ComposeTest(void) {
+  Poly p = P(C(1), 2, P(C(1), 1), 4);
+  Poly *q = malloc(sizeof(Poly));
+  CHECK_PTR(q);
+  q[0] = C(1);
+  Poly one = PolyCompose(&p, 1, q);
+  bool res = PolyIsCoeff(&one) && one.coeff == 1;
+  Poly zero = PolyCompose(&p, 0, NULL);
+  res &= PolyIsZero(&zero);
+
+  q[0] = P(C(2), 1);
+  Poly deep = P(C(1), 0, P(C(3), 0, C(5), 2), 1);
+  Poly composed = PolyCompose(&deep, 1, q);
+  Poly expected = P(C(1), 0, C(6), 1);
+  res &= PolyIsEq(&composed, &expected);
+
+  PolyDestroy(&p);
+  PolyDestroy(&q[0]);
+  free(q);
+  PolyDestroy(&one);
+  PolyDestroy(&zero);
+  PolyDestroy(&deep);
+  PolyDestroy(&composed);
+  PolyDestroy(&expected);
+  return res;
+}
+
+/**
+ * Sprawdza potęgowanie wielomianów dla podstaw, przy których PolyPow wybiera
+ * różne strategie: rzadkie, gęste jednej zmiennej i wielu zmiennych.
+ */
+static bool PowTest(void) {
+  bool res = true;
+  res &= TestPow(C(3), 5);
+  res &= TestPow(P(C(2), 1), 0);
+  res &= TestPow(P(C(-2), 3), 7);
+  res &= TestPow(P(C(1), 0, C(1), 1), 20);
+  res &= TestPow(P(C(3), 2, C(-1), 3, C(2), 5), 9);
+  res &= TestPow(P(C(1), 0, C(1), 1000, C(1), 100000), 6);
+  res &= TestPow(P(C(7), 1, C(-5), 2, C(3), 4), 40);
+  res &= TestPow(P(P(C(1), 1), 0, P(C(1), 0, C(2), 2), 3), 8);
+  res &= TestPow(P(C(1L << 20), 1, C(1), 2), 10);
+  return res;
+}
+
+/**
+ * Sprawdza budowanie wielomianu ze składników podawanych w dowolnej
+ * kolejności, w tym łączenie i redukowanie się powtórzonych składników.
+ */
+static bool BuilderTest(void) {
+  bool res = true;
+
+  PolyBuilder b = PolyBuilderInit();
+  Poly p = PolyBuilderFinish(&b);
+  res &= PolyIsZero(&p);
+
+  b = PolyBuilderInit();
+  PolyBuilderAddTerm(&b, 2, (poly_exp_t[]) {1, 2}, 3);
+  PolyBuilderAddTerm(&b, 3, (poly_exp_t[]) {0, 0, 0}, 5);
+  PolyBuilderAddTerm(&b, 1, (poly_exp_t[]) {4}, 1);
+  PolyBuilderAddTerm(&b, 3, (poly_exp_t[]) {1, 2, 0}, -1);
+  PolyBuilderAddTerm(&b, 1, (poly_exp_t[]) {4}, -1);
+  PolyBuilderAddTerm(&b, 3, (poly_exp_t[]) {0, 0, 7}, 2);
+  p = PolyBuilderFinish(&b);
+  Poly expected = P(P(P(C(5), 0, C(2), 7), 0), 0, P(C(2), 2), 1);
+  res &= PolyIsEq(&p, &expected);
+  PolyDestroy(&expected);
+
+  b = PolyBuilderInit();
+  for (poly_exp_t i = 0; i < 1000; ++i)
+    PolyBuilderAddTerm(&b, 1, (poly_exp_t[]) {999 - i}, 1);
+  PolyBuilderAddScaled(&b, &p, 1);
+  PolyBuilderAddScaled(&b, &p, -1);
+  Poly q = PolyBuilderFinish(&b);
+  res &= PolyDeg(&q) == 999 && PolyDegBy(&q, 1) == 0;
+  PolyDestroy(&q);
+
+  b = PolyBuilderInit();
+  PolyBuilderAddPoly(&b, 0, &p);
+  PolyBuilderAddPoly(&b, 3, &p);
+  PolyBuilderAddPoly(&b, 0, &p);
+  q = PolyBuilderFinish(&b);
+  Poly r = P(PolyMulCoeff(&p, 2), 0, PolyClone(&p), 3);
+  res &= PolyIsEq(&q, &r);
+  PolyDestroy(&p);
+  PolyDestroy(&q);
+  PolyDestroy(&r);
+
+  return res;
+}
+
+/**
+ * Sprawdza mnożenie wielomianów, których iloczyn ma znacznie mniej
+ * jednomianów niż par jednomianów czynników.
+ */
+static bool MulDenseTest(void) {
+  const size_t size = 100;
+  poly_coeff_t coeffs[2 * size - 1];
+  poly_exp_t exps[2 * size - 1];
+  for (size_t i = 0; i < 2 * size - 1; ++i) {
+    coeffs[i] = i < size ? i + 1 : 2 * size - 1 - i;
+    exps[i] = i;
+  }
+  poly_coeff_t ones[size];
+  for (size_t i = 0; i < size; ++i)
+    ones[i] = 1;
+
+  Poly p = MakePoly(size, ones, exps);
+  Poly expected = MakePoly(2 * size - 1, coeffs, exps);
+  Poly pp = PolyMul(&p, &p);
+  bool res = PolyIsEq(&pp, &expected);
+
+  Poly q = P(P(C(1), 0, C(-1), 1), 0, P(C(1), 1), 1);
+  Poly r = P(P(C(1), 0, C(1), 1), 0, P(C(-1), 1), 1);
+  Poly qr = PolyMul(&q, &r);
+  Poly qrExpected = P(P(C(1), 0, C(-1), 2), 0, P(C(2), 2), 1,
+                      P(C(-1), 2), 2);
+  res &= PolyIsEq(&qr, &qrExpected);
+
+  PolyDestroy(&p);
+  PolyDestroy(&expected);
+  PolyDestroy(&pp);
+  PolyDestroy(&q);
+  PolyDestroy(&r);
+  PolyDestroy(&qr);
+  PolyDestroy(&qrExpected);
+  return res;
+}
+
+/**
+ * Sprawdza, czy wszystkie algorytmy mnożenia dają ten sam wynik,
+ * także dla wielomianów wielu zmiennych i przy redukcji jednomianów.
+ */
+static bool MulStrategyTest(void) {
+  const PolyMulStrategy strategies[] = {MUL_SORT, MUL_HEAP, MUL_HASH,
+                                        MUL_DENSE, MUL_AUTO};
+  PolyMulConfig config = POLY_MUL_CONFIG_DEFAULT;
+  int exp_shift = 0, coef_shift = 0;
+  Poly p = RecursiveBuild(3, &exp_shift, &coef_shift);
+  Poly q = RecursiveBuild(3, &exp_shift, &coef_shift);
+  Poly r = P(C(1), 0, C(-1), 1, C(2), 5);
+  Poly s = P(C(1), 0, C(1), 1, C(-2), 4, C(3), 7);
+
+  config.strategy = MUL_SORT;
+  PolySetMulConfig(&config);
+  Poly pq = PolyMul(&p, &q);
+  Poly rs = PolyMul(&r, &s);
+
+  bool res = true;
+  for (size_t i = 0; i < sizeof(strategies) / sizeof(strategies[0]); ++i) {
+    config.strategy = strategies[i];
+    PolySetMulConfig(&config);
+    Poly pq2 = PolyMul(&p, &q);
+    Poly rs2 = PolyMul(&r, &s);
+    res &= PolyIsEq(&pq, &pq2) && PolyIsEq(&rs, &rs2);
+    PolyDestroy(&pq2);
+    PolyDestroy(&rs2);
+  }
+
+  /* Narzucone mnożenie gęste rzadkich czynników nie może alokować tablicy
+   * o rozmiarze zakresu wykładników, czyli ok. 2^31 elementów. */
+  config.strategy = MUL_DENSE;
+  PolySetMulConfig(&config);
+  Poly sparse = P(C(1), 0, C(2), (1 << 30) - 1);
+  Poly square = PolyMul(&sparse, &sparse);
+  Poly squareExpected = P(C(1), 0, C(4), (1 << 30) - 1, C(4), INT_MAX - 1);
+  res &= PolyIsEq(&square, &squareExpected);
+  PolyDestroy(&sparse);
+  PolyDestroy(&square);
+  PolyDestroy(&squareExpected);
+
+  config.strategy = MUL_AUTO;
+  PolySetMulConfig(&config);
+  PolyDestroy(&p);
+  PolyDestroy(&q);
+  PolyDestroy(&r);
+  PolyDestroy(&s);
+  PolyDestroy(&pq);
+  PolyDestroy(&rs);
+  return res;
+}
+
+static bool MetaTest(void) {
+  Poly c = C(5);
+  Poly p = P(P(C(1), 0, P(C(2), 3), 2), 1, C(-1), 4);
+  Poly q = PolyClone(&p);
+  Poly pq = PolyAdd(&p, &q);
+  Poly r = PolySub(&p, &q);
+
+  bool res = PolyTermCount(&c) == 1 && PolyDepth(&c) == 0;
+  res &= PolyTermCount(&p) == 3 && PolyDepth(&p) == 3;
+  res &= PolyDeg(&p) == 6 && PolyDegBy(&p, 0) == 4;
+  res &= PolyDegBy(&p, 1) == 2 && PolyDegBy(&p, 2) == 3;
+  res &= PolyDegBy(&p, 3) == 0 && PolyDegBy(&p, 100) == 0;
+  res &= PolyTermCount(&pq) == 3 && PolyDeg(&pq) == 6;
+  res &= PolyIsZero(&r) && PolyTermCount(&r) == 0 && PolyDepth(&r) == 0;
+
+  Mono negMono = M(C(3), -1);
+  Poly negInner = PolyAddMonos(1, &negMono);
+  Poly neg = P(negInner, 1);
+  res &= !PolyIsCoeff(&neg) && PolyDepth(&neg) == 2;
+
+  PolyDestroy(&p);
+  PolyDestroy(&q);
+  PolyDestroy(&pq);
+  PolyDestroy(&neg);
+  return res;
+}
+
+static Poly MakeChain(size_t depth, poly_coeff_t c) {
+  Poly p = C(c);
+  for (size_t i = 0; i < depth; ++i) {
+    Mono m = M(p, 1);
+    p = PolyAddMonos(1, &m);
+  }
+  return p;
+}
+
+static bool DeepChainTest(void) {
+  const size_t depth = 1000000;
+  Poly p = MakeChain(depth, 1);
+  Poly q = PolyClone(&p);
+  Poly r = MakeChain(depth, 2);
+
+  bool res = PolyIsEq(&p, &q) && !PolyIsEq(&p, &r);
+  res &= PolyDeg(&q) == (poly_exp_t) depth && PolyDepth(&q) == depth;
+  res &= PolyTermCount(&q) == 1 && !PolyIsZero(&q);
+
+  PolyDestroy(&p);
+  PolyDestroy(&q);
+  PolyDestroy(&r);
+  return res;
+}
+
+static bool AddCoeffTest(void) {
+  Poly c = C(1);
+  Poly p = P(C(-1), 0, C(1), 1);
+  Poly q = P(P(C(-1), 0, C(1), 1), 0, C(2), 3);
+  Poly pc = PolyAdd(&p, &c);
+  Poly cq = PolyAdd(&c, &q);
+  Poly big = P(C((poly_coeff_t) 1 << (POLY_COEFF_BITS - 2)), 1);
+  Poly four = C(4);
+  Poly bigFour = PolyMul(&big, &four);
+
+  Poly pcExpected = P(C(1), 1);
+  Poly cqExpected = P(P(C(1), 1), 0, C(2), 3);
+  bool res = PolyIsEq(&pc, &pcExpected) && PolyIsEq(&cq, &cqExpected);
+#ifndef POLY_COEFF_MODULUS
+  /* Iloczyn przepełnia się do zera modulo 2^k. */
+  res &= PolyIsZero(&bigFour);
+#endif
+
+  PolyDestroy(&p);
+  PolyDestroy(&q);
+  PolyDestroy(&pc);
+  PolyDestroy(&cq);
+  PolyDestroy(&big);
+  PolyDestroy(&bigFour);
+  PolyDestroy(&pcExpected);
+  PolyDestroy(&cqExpected);
+  return res;
+}
+
+static bool CompactTest(void) {
+  Poly p = P(P(C(1), 0, P(C(2), 3), 2), 1, C(-1), 4, P(C(3), 1), 5);
+  Poly q = PolyClone(&p);
+  PolyCompact(&p);
+  PolyCompact(&p);
+
+  bool res = PolyIsEq(&p, &q);
+  Poly pp = PolyMul(&p, &p);
+  Poly qq = PolyMul(&q, &q);
+  res &= PolyIsEq(&pp, &qq);
+  PolyCompact(&qq);
+  Poly sum = PolyAdd(&pp, &qq);
+  Poly twice = PolyMulCoeff(&pp, 2);
+  res &= PolyIsEq(&sum, &twice);
+
+  /* Skompaktowany wielomian może stać się współczynnikiem jednomianu. */
+  Mono m = M(p, 3);
+  Poly r = PolyAddMonos(1, &m);
+  res &= PolyDeg(&r) == 9 && PolyTermCount(&r) == 4;
+
+  Poly chain = MakeChain(100000, 7);
+  Poly chainCopy = PolyClone(&chain);
+  PolyCompact(&chain);
+  res &= PolyIsEq(&chain, &chainCopy);
+
+  PolyDestroy(&q);
+  PolyDestroy(&pp);
+  PolyDestroy(&qq);
+  PolyDestroy(&sum);
+  PolyDestroy(&twice);
+  PolyDestroy(&r);
+  PolyDestroy(&chain);
+  PolyDestroy(&chainCopy);
+  return res;
+}
+
+static bool DeferredDestroyTest(void) {
+  Poly chain = MakeChain(10000, 3);
+  Poly p = P(P(C(1), 0, P(C(2), 3), 2), 1, C(-1), 4);
+  Poly q = PolyClone(&p);
+  Poly c = C(5);
+  PolyCompact(&q);
+
+  PolyDestroyDeferred(&chain);
+  PolyDestroyDeferred(&p);
+  PolyDestroyDeferred(&q);
+  PolyDestroyDeferred(&c);
+
+  /* Łańcuch ma 10000 węzłów, ale odłożono go od poprzedniego wywołania,
+   * więc jest zwalniany w całości niezależnie od budżetu. */
+  bool res = PolyReclaimPending() >= 10000;
+  res &= PolyReclaim(2) && PolyReclaimPending() == 0;
+  return res && PolyReclaim(0);
+}
+
+static Poly RandomTerms(size_t count, size_t vars, poly_exp_t span,
+                        unsigned long *seed) {
+  PolyBuilder b = PolyBuilderInit();
+  poly_exp_t exps[vars];
+  for (size_t i = 0; i < count; ++i) {
+    for (size_t j = 0; j < vars; ++j) {
+      *seed = *seed * 6364136223846793005UL + 1442695040888963407UL;
+      exps[j] = (*seed >> 33) % span;
+    }
+    PolyBuilderAddTerm(&b, vars, exps, (poly_coeff_t) (*seed >> 40) % 7 - 3);
+  }
+  return PolyBuilderFinish(&b);
+}
+
+static bool DeferredBoundTest(void) {
+  unsigned long seed = 34;
+  Poly p = RandomTerms(60, 2, 10, &seed);
+  PolyCompact(&p);
+
+  /* Powtarzamy CLONE, CLONE, MUL, POP tak jak kalkulator: każdy wynik
+   * trafia na stos jako kopia skompaktowana, a pierwotne drzewo jest
+   * odkładane do usunięcia. Odłożona pamięć nie może rosnąć. */
+  bool res = true;
+  size_t bound = 0;
+  for (size_t i = 0; i < 200; ++i) {
+    Poly a = PolyClone(&p);
+    PolyCompactDeferred(&a);
+    Poly b = PolyClone(&p);
+    PolyCompactDeferred(&b);
+    Poly r = PolyMul(&a, &b);
+    PolyDestroyDeferred(&a);
+    PolyDestroyDeferred(&b);
+    PolyCompactDeferred(&r);
+    PolyReclaim(4);
+    if (i == 0)
+      bound = PolyReclaimPending();
+    res &= PolyReclaimPending() <= bound;
+    PolyDestroyDeferred(&r);
+  }
+
+  PolyDestroy(&p);
+  return res && PolyReclaim(SIZE_MAX) && PolyReclaimPending() == 0;
+}
+
+static bool ScratchTest(void) {
+  /* Wielomiany są na tyle duże, że operacje przekraczają limit areny. */
+  unsigned long seed = 2021;
+  Poly q = RandomTerms(300, 3, 12, &seed);
+  Poly p = P(C(1), 1, C(1), 2);
+
+  Poly composed = PolyCompose(&p, 1, &q);
+  Poly qq = PolyMul(&q, &q);
+  Poly expected = PolyAdd(&qq, &q);
+  bool res = PolyIsEq(&composed, &expected);
+
+  Poly qqq = PolyMul(&qq, &q);
+  Poly cube = PolyPow(&q, 3);
+  res &= PolyIsEq(&qqq, &cube);
+
+  PolyDestroy(&q);
+  PolyDestroy(&p);
+  PolyDestroy(&composed);
+  PolyDestroy(&qq);
+  PolyDestroy(&expected);
+  PolyDestroy(&qqq);
+  PolyDestroy(&cube);
+  PolyScratchRelease();
+  return res;
+}
+
+static bool LinCombTest(void) {
+  Poly p = P(P(C(1), 0, C(2), 1), 0, C(3), 2);
+  Poly q = P(P(C(-1), 1), 0, C(1), 1);
+  Poly c = C(5);
+
+  Poly r1 = PolyLinComb(2, &p, 3, &q);
+  Poly e1 = P(P(C(2), 0, C(1), 1), 0, C(3), 1, C(6), 2);
+  Poly r2 = PolyLinComb(2, &p, -2, &p);
+  Poly r3 = PolyLinComb(-1, &c, 4, &p);
+  Poly e3 = P(P(C(-1), 0, C(8), 1), 0, C(12), 2);
+  Poly r4 = PolyLinComb(0, &p, 7, &c);
+  Poly big = P(P(C((poly_coeff_t) 1 << (POLY_COEFF_BITS - 2)), 1), 0,
+               C(1), 1);
+  Poly r5 = PolyLinComb(4, &big, 0, &q);
+  Poly e5 = P(C(4), 1);
+  Poly r6 = PolySub(&p, &q);
+  Poly e6 = P(P(C(1), 0, C(3), 1), 0, C(-1), 1, C(3), 2);
+
+  bool res = PolyIsEq(&r1, &e1) && PolyIsZero(&r2) && PolyIsEq(&r3, &e3);
+  res &= PolyIsCoeff(&r4) && r4.coeff == 35 && PolyIsEq(&r6, &e6);
+#ifndef POLY_COEFF_MODULUS
+  res &= PolyIsEq(&r5, &e5);
+#endif
+
+  PolyDestroy(&p);
+  PolyDestroy(&q);
+  PolyDestroy(&r1);
+  PolyDestroy(&e1);
+  PolyDestroy(&r3);
+  PolyDestroy(&e3);
+  PolyDestroy(&big);
+  PolyDestroy(&r5);
+  PolyDestroy(&e5);
+  PolyDestroy(&r6);
+  PolyDestroy(&e6);
+  return res;
+}
+
+static bool FmaCase(const Poly *acc, const Poly *p, const Poly *q,
+                    bool compact) {
+  Poly pq = PolyMul(p, q);
+  Poly expected = PolyAdd(acc, &pq);
+  Poly result = PolyClone(acc);
+  if (compact)
+    PolyCompact(&result);
+  PolyFmaInPlace(&result, p, q);
+  bool res = PolyIsEq(&result, &expected);
+  PolyDestroy(&pq);
+  PolyDestroy(&expected);
+  PolyDestroy(&result);
+  return res;
+}
+
+static bool FmaTest(void) {
+  unsigned long seed = 37;
+  Poly p = RandomTerms(40, 3, 5, &seed);
+  Poly q = RandomTerms(30, 2, 5, &seed);
+  Poly acc = RandomTerms(50, 3, 8, &seed);
+  Poly c = C(3);
+  Poly zero = C(0);
+
+  bool res = FmaCase(&acc, &p, &q, false) && FmaCase(&acc, &p, &q, true);
+  res &= FmaCase(&c, &p, &q, false) && FmaCase(&zero, &p, &q, false);
+  res &= FmaCase(&acc, &c, &q, false) && FmaCase(&p, &c, &c, true);
+  res &= FmaCase(&c, &c, &c, false) && FmaCase(&acc, &zero, &p, false);
+
+  /* Akumulator równy iloczynowi ze znakiem minus się zeruje. */
+  Poly pq = PolyMul(&p, &q);
+  Poly negPq = PolyNeg(&pq);
+  PolyFmaInPlace(&negPq, &p, &q);
+  res &= PolyIsZero(&negPq);
+
+  /* Argument może być aliasem akumulatora. */
+  Poly square = PolyMul(&acc, &acc);
+  Poly expected = PolyAdd(&acc, &square);
+  PolyFmaInPlace(&acc, &acc, &acc);
+  res &= PolyIsEq(&acc, &expected);
+
+  PolyDestroy(&p);
+  PolyDestroy(&q);
+  PolyDestroy(&acc);
+  PolyDestroy(&pq);
+  PolyDestroy(&square);
+  PolyDestroy(&expected);
+  return res;
+}
+
+static bool AddManyTest(void) {
+  unsigned long seed = 38;
+  Poly ps[8];
+  const Poly *ptrs[8];
+  for (size_t i = 0; i < 5; ++i)
+    ps[i] = RandomTerms(20 + 10 * i, 1 + i % 3, 6, &seed);
+  ps[5] = C(4);
+  ps[6] = C(0);
+  ps[7] = PolyNeg(&ps[0]);
+  for (size_t i = 0; i < 8; ++i)
+    ptrs[i] = &ps[i];
+
+  bool res = true;
+  for (size_t n = 0; n <= 8; ++n) {
+    Poly expected = C(0);
+    for (size_t i = 0; i < n; ++i) {
+      Poly sum = PolyAdd(&expected, &ps[i]);
+      PolyDestroy(&expected);
+      expected = sum;
+    }
+    Poly result = PolyAddMany(n, ptrs);
+    res &= PolyIsEq(&result, &expected);
+    PolyDestroy(&expected);
+    PolyDestroy(&result);
+  }
+
+  /* Same współczynniki i składniki znoszące się do stałej. */
+  const Poly *coeffs[] = {&ps[5], &ps[6], &ps[5]};
+  Poly r1 = PolyAddMany(3, coeffs);
+  res &= PolyIsCoeff(&r1) && r1.coeff == 8;
+  const Poly *cancel[] = {&ps[0], &ps[5], &ps[7]};
+  Poly r2 = PolyAddMany(3, cancel);
+  res &= PolyIsCoeff(&r2) && r2.coeff == 4;
+
+  for (size_t i = 0; i < 8; ++i)
+    PolyDestroy(&ps[i]);
+  return res;
+}
+
+static bool MulManyCase(size_t n, const Poly *ps[], size_t threads) {
+  PolyMulConfig config = POLY_MUL_CONFIG_DEFAULT;
+  config.threads = threads;
+  PolySetMulConfig(&config);
+
+  Poly expected = C(1);
+  for (size_t i = 0; i < n; ++i) {
+    Poly product = PolyMul(&expected, ps[i]);
+    PolyDestroy(&expected);
+    expected = product;
+  }
+  Poly result = PolyMulMany(n, ps);
+  bool res = PolyIsEq(&result, &expected);
+
+  PolyDestroy(&expected);
+  PolyDestroy(&result);
+  config.threads = 1;
+  PolySetMulConfig(&config);
+  return res;
+}
+
+static bool MulManyTest(void) {
+  /* Iloczyn 600 czynników liniowych ma dostatecznie duże poddrzewa,
+   * aby przy kilku wątkach były liczone równolegle. */
+  enum { FACTORS = 600 };
+  Poly ps[FACTORS];
+  const Poly *ptrs[FACTORS];
+  unsigned long seed = 39;
+  for (size_t i = 0; i < FACTORS; ++i) {
+    seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+    ps[i] = P(C(1), 0, C((long) (seed >> 62) - 2), 1);
+    ptrs[i] = &ps[i];
+  }
+  Poly multi[4] = {RandomTerms(10, 3, 4, &seed), C(-2),
+                   RandomTerms(6, 2, 5, &seed), RandomTerms(12, 3, 3, &seed)};
+  const Poly *multiPtrs[] = {&multi[0], &multi[1], &multi[2], &multi[3]};
+  Poly zero = C(0);
+  const Poly *withZero[] = {&ps[0], &zero, &ps[1]};
+
+  bool res = MulManyCase(FACTORS, ptrs, 1) && MulManyCase(FACTORS, ptrs, 4);
+  res &= MulManyCase(4, multiPtrs, 1) && MulManyCase(4, multiPtrs, 3);
+  res &= MulManyCase(0, ptrs, 1) && MulManyCase(1, ptrs, 1);
+  res &= MulManyCase(1, &multiPtrs[1], 2) && MulManyCase(3, withZero, 2);
+
+  for (size_t i = 0; i < FACTORS; ++i)
+    PolyDestroy(&ps[i]);
+  for (size_t i = 0; i < 4; ++i)
+    PolyDestroy(&multi[i]);
+  return res;
+}
+
+static bool TruncCase(const Poly *p, const Poly *q,
+                      const PolyDegBound *bound) {
+  Poly pq = PolyMul(p, q);
+  Poly expected = PolyTruncate(&pq, bound);
+  Poly result = PolyMulTrunc(p, q, bound);
+  bool res = PolyIsEq(&result, &expected);
+
+  Poly pCube = PolyPow(p, 3);
+  Poly expectedPow = PolyTruncate(&pCube, bound);
+  Poly resultPow = PolyPowTrunc(p, 3, bound);
+  res &= PolyIsEq(&resultPow, &expectedPow);
+
+  PolyDestroy(&pq);
+  PolyDestroy(&expected);
+  PolyDestroy(&result);
+  PolyDestroy(&pCube);
+  PolyDestroy(&expectedPow);
+  PolyDestroy(&resultPow);
+  return res;
+}
+
+static bool TruncTest(void) {
+  unsigned long seed = 40;
+  Poly p = RandomTerms(30, 3, 5, &seed);
+  Poly q = RandomTerms(25, 2, 6, &seed);
+  Poly c = C(3);
+
+  /* (1 + x_0 x_1 + x_1^2)(1 + x_0), obcięte do stopnia 2. */
+  Poly r = P(P(C(1), 0, C(1), 2), 0, P(C(1), 1), 1);
+  Poly s = P(C(1), 0, C(1), 1);
+  PolyDegBound total = {.totalDeg = 2, .vars = 0, .varDeg = NULL};
+  Poly rs = PolyMulTrunc(&r, &s, &total);
+  Poly expected = P(P(C(1), 0, C(1), 2), 0, P(C(1), 0, C(1), 1), 1);
+  bool res = PolyIsEq(&rs, &expected);
+
+  const poly_exp_t varDeg[] = {3, -1, 2};
+  PolyDegBound perVar = {.totalDeg = -1, .vars = 3, .varDeg = varDeg};
+  PolyDegBound both = {.totalDeg = 6, .vars = 3, .varDeg = varDeg};
+  PolyDegBound none = {.totalDeg = -1, .vars = 0, .varDeg = NULL};
+  PolyDegBound zero = {.totalDeg = 0, .vars = 0, .varDeg = NULL};
+  res &= TruncCase(&p, &q, &total) && TruncCase(&p, &q, &perVar);
+  res &= TruncCase(&p, &q, &both) && TruncCase(&q, &c, &both);
+  res &= TruncCase(&p, &q, &zero) && TruncCase(&c, &c, &total);
+
+  Poly full = PolyMul(&p, &q);
+  Poly untruncated = PolyMulTrunc(&p, &q, &none);
+  res &= PolyIsEq(&full, &untruncated);
+
+  PolyDestroy(&p);
+  PolyDestroy(&q);
+  PolyDestroy(&r);
+  PolyDestroy(&s);
+  PolyDestroy(&rs);
+  PolyDestroy(&expected);
+  PolyDestroy(&full);
+  PolyDestroy(&untruncated);
+  return res;
+}
+
+static bool ModularCase(poly_coeff_t modulus, PolyMulStrategy strategy,
+                        size_t vars, unsigned long *seed) {
+  PolyMulConfig config = POLY_MUL_CONFIG_DEFAULT;
+  config.strategy = strategy;
+  PolySetMulConfig(&config);
+
+  /* Wyniki w zwykłej arytmetyce, zredukowane na końcu. */
+  Poly p = RandomTerms(40, vars, 9, seed);
+  Poly q = RandomTerms(30, vars, 9, seed);
+  Poly sum = PolyAdd(&p, &q);
+  Poly diff = PolySub(&p, &q);
+  Poly product = PolyMul(&p, &q);
+  Poly power = PolyPow(&p, 3);
+  Poly at = PolyAt(&p, -5);
+
+  PolySetModulus(modulus);
+  Poly expected[] = {PolyReduce(&sum), PolyReduce(&diff),
+                     PolyReduce(&product), PolyReduce(&power),
+                     PolyReduce(&at)};
+  Poly pMod = PolyReduce(&p);
+  Poly qMod = PolyReduce(&q);
+  Poly result[] = {PolyAdd(&pMod, &qMod), PolySub(&pMod, &qMod),
+                   PolyMul(&pMod, &qMod), PolyPow(&pMod, 3),
+                   PolyAt(&pMod, -5)};
+  bool res = true;
+  for (size_t i = 0; i < 5; ++i) {
+    res &= PolyIsEq(&result[i], &expected[i]);
+    PolyDestroy(&expected[i]);
+    PolyDestroy(&result[i]);
+  }
+
+  /* Wielomian pomnożony przez moduł minus jeden i dodany do siebie
+   * daje zero. */
+  Poly neg = PolyMulCoeff(&pMod, modulus - 1);
+  Poly zero = PolyAdd(&neg, &pMod);
+  res &= PolyIsZero(&zero);
+
+  PolySetModulus(0);
+  config.strategy = MUL_AUTO;
+  PolySetMulConfig(&config);
+  PolyDestroy(&p);
+  PolyDestroy(&q);
+  PolyDestroy(&sum);
+  PolyDestroy(&diff);
+  PolyDestroy(&product);
+  PolyDestroy(&power);
+  PolyDestroy(&at);
+  PolyDestroy(&pMod);
+  PolyDestroy(&qMod);
+  PolyDestroy(&neg);
+  return res;
+}
+
+static bool ModularTest(void) {
+#ifdef POLY_COEFF_MODULUS
+  /* Ze stałym modułem nie da się policzyć wyników w zwykłej arytmetyce,
+   * więc sprawdzamy tylko, że inne moduły są odrzucane. */
+  return !PolySetModulus(0) && !PolySetModulus(POLY_COEFF_MODULUS - 1) &&
+         PolySetModulus(POLY_COEFF_MODULUS) &&
+         PolyGetModulus() == POLY_COEFF_MODULUS;
+#endif
+  unsigned long seed = 41;
+  bool res = ModularCase(7, MUL_AUTO, 2, &seed);
+  res &= ModularCase(1000003, MUL_DENSE, 1, &seed);
+  res &= ModularCase(1000003, MUL_HEAP, 3, &seed);
+  res &= ModularCase(POLY_MODULUS_LIMIT - 1, MUL_HASH, 2, &seed);
+  res &= ModularCase(POLY_MODULUS_LIMIT - 1, MUL_DENSE, 1, &seed);
+
+  /* Redukcja Barretta dla dużych reszt. */
+  poly_coeff_t m = POLY_MODULUS_LIMIT - 1;
+  PolySetModulus(m);
+  for (poly_coeff_t i = 1000; i > 0; i -= 37) {
+    poly_coeff_t a = m - i;
+    Poly p = C(a);
+    Poly r = PolyMulCoeff(&p, m - 3);
+    res &= PolyIsCoeff(&r) && r.coeff == (poly_coeff_t) ((__int128) a * (m - 3) % m);
+  }
+  res &= !PolySetModulus(1) && !PolySetModulus(POLY_MODULUS_LIMIT);
+  res &= PolyGetModulus() == m;
+  PolySetModulus(0);
+  return res && PolyGetModulus() == 0;
+}
+
+static bool DenseModularTest(void) {
+  /* Gęste mnożenie sumuje nieprzystające reszty bliskie modułowi; wynik
+   * porównujemy z mnożeniem kopcowym i ze współczynnikiem policzonym
+   * wprost. */
+#ifdef POLY_COEFF_MODULUS
+  poly_coeff_t m = POLY_COEFF_MODULUS;
+#else
+  poly_coeff_t m = POLY_MODULUS_LIMIT - 1;
+#endif
+  PolySetModulus(m);
+  size_t n = 64;
+  poly_coeff_t a[n], b[n];
+  Mono ma[n], mb[n];
+  unsigned long seed = 43;
+  for (size_t i = 0; i < n; ++i) {
+    seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+    a[i] = (poly_coeff_t) ((seed >> 16) % (unsigned long) m);
+    seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+    b[i] = (poly_coeff_t) ((seed >> 16) % (unsigned long) m);
+    ma[i] = M(C(a[i]), (poly_exp_t) i);
+    mb[i] = M(C(b[i]), (poly_exp_t) i);
+  }
+  Poly p = PolyAddMonos(n, ma);
+  Poly q = PolyAddMonos(n, mb);
+
+  PolyMulConfig config = POLY_MUL_CONFIG_DEFAULT;
+  config.strategy = MUL_DENSE;
+  PolySetMulConfig(&config);
+  Poly dense = PolyMul(&p, &q);
+  config.strategy = MUL_HEAP;
+  PolySetMulConfig(&config);
+  Poly heap = PolyMul(&p, &q);
+  config.strategy = MUL_AUTO;
+  PolySetMulConfig(&config);
+
+  unsigned long middle = 0;
+  for (size_t i = 0; i < n; ++i)
+    middle = (middle + (unsigned long) a[i] * (unsigned long) b[n - 1 - i]) %
+             (unsigned long) m;
+  Poly top = PolyAt(&dense, 0);
+  bool res = PolyIsEq(&dense, &heap) && PolyIsCoeff(&top) &&
+             top.coeff == (poly_coeff_t) ((unsigned long) a[0] * b[0] % m);
+  for (size_t i = 0; i < dense.size; ++i)
+    if (MonoGetExp(&dense.arr[i]) == (poly_exp_t) n - 1)
+      res &= dense.arr[i].p.coeff == (poly_coeff_t) middle;
+
+  PolySetModulus(0);
+  PolyDestroy(&p);
+  PolyDestroy(&q);
+  PolyDestroy(&dense);
+  PolyDestroy(&heap);
+  PolyDestroy(&top);
+  return res;
+}
+
+static bool WideCoeffTest(void) {
+  /* Współczynniki zajmujące górne bity typu: gęste mnożenie musi dać
+   * ten sam wynik co kopcowe. */
+  Poly p = P(C(POLY_COEFF_MAX / 3), 0, C(-(POLY_COEFF_MAX / 5)), 1,
+             C(POLY_COEFF_MAX / 7), 2);
+  Poly q = P(C(POLY_COEFF_MAX / 11), 0, C(3), 1, C(-(POLY_COEFF_MAX / 13)), 2);
+  PolyMulConfig config = POLY_MUL_CONFIG_DEFAULT;
+  config.strategy = MUL_DENSE;
+  PolySetMulConfig(&config);
+  Poly dense = PolyMul(&p, &q);
+  config.strategy = MUL_HEAP;
+  PolySetMulConfig(&config);
+  Poly heap = PolyMul(&p, &q);
+  config.strategy = MUL_AUTO;
+  PolySetMulConfig(&config);
+  bool res = PolyIsEq(&dense, &heap);
+
+#if POLY_COEFF_BITS == 128 && !defined(POLY_COEFF_MODULUS)
+  /* Iloczyny nie mieszczą się w 64 bitach. */
+  Poly big = P(C((poly_coeff_t) 1 << 64), 1);
+  Poly shift = C((poly_coeff_t) 1 << 60);
+  Poly product = PolyMul(&big, &shift);
+  char buffer[POLY_COEFF_CHARS + 1];
+  buffer[FormatCoeff(product.arr[0].p.coeff, buffer)] = '\0';
+  res &= strcmp(buffer, "21267647932558653966460912964485513216") == 0;
+  PolyDestroy(&big);
+  PolyDestroy(&product);
+#endif
+
+  PolyDestroy(&p);
+  PolyDestroy(&q);
+  PolyDestroy(&dense);
+  PolyDestroy(&heap);
+  return res;
+}
+
+static bool CoeffStringIs(poly_coeff_t c, const char *expected) {
+  char *str = PolyCoeffToString(c);
+  bool res = strcmp(str, expected) == 0;
+  free(str);
+  return res;
+}
+
+static bool ExactTest(void) {
+#ifdef POLY_COEFF_MODULUS
+  /* Ze stałym modułem tryb dokładny nie ma zastosowania. */
+  PolySetExact(true);
+  bool exact = PolyGetExact();
+  PolySetExact(false);
+  return !exact;
+#endif
+  unsigned long seed = 42;
+  Poly p = RandomTerms(40, 1, 30, &seed);
+  Poly q = RandomTerms(40, 2, 6, &seed);
+  Poly pp = PolyMul(&p, &p);
+  Poly pq = PolyMul(&p, &q);
+  PolySetExact(true);
+  Poly ppExact = PolyMul(&p, &p);
+  Poly pqExact = PolyMul(&p, &q);
+  bool res = PolyIsEq(&pp, &ppExact) && PolyIsEq(&pq, &pqExact);
+
+  /* Współczynniki (x + 1)^100 i jego wartości nie mieszczą się w 64 bitach. */
+  Poly xPlusOne = P(C(1), 0, C(1), 1);
+  Poly pow = PolyPow(&xPlusOne, 100);
+  Poly atOne = PolyAt(&pow, 1);
+  Poly atMinusOne = PolyAt(&pow, -1);
+  Poly two = C(2);
+  Poly twoPow = PolyPow(&two, 100);
+  Poly neg = PolyNeg(&atOne);
+  Poly diff = PolySub(&pow, &pow);
+  res &= pow.size == 101 &&
+         CoeffStringIs(pow.arr[50].p.coeff, "100891344545564193334812497256");
+  res &= CoeffStringIs(atOne.coeff, "1267650600228229401496703205376");
+  res &= CoeffStringIs(neg.coeff, "-1267650600228229401496703205376");
+  res &= PolyIsZero(&atMinusOne) && PolyIsZero(&diff);
+  res &= PolyIsEq(&atOne, &twoPow) &&
+         (POLY_COEFF_BITS == 128 || PolyCoeffIsBig(atOne.coeff));
+
+  /* Skrajne wartości typu trzeba sprowadzić do współczynników; równe
+   * wartości policzone na różne sposoby mają równe uchwyty. */
+  char max[POLY_COEFF_CHARS + 1], input[2 * POLY_COEFF_CHARS + 16];
+  max[FormatCoeff(POLY_COEFF_MAX, max)] = '\0';
+  Poly rawMax = P(C(POLY_COEFF_MAX), 1);
+  Poly big = PolyReduce(&rawMax);
+  Poly doubled = PolyMulCoeff(&big, 2);
+  Poly halved = PolySub(&doubled, &big);
+  snprintf(input, sizeof(input), "(%s,1)+(%s,1)", max, max);
+  Poly parsed = ParsePoly(input, strlen(input), NULL);
+  res &= CoeffStringIs(big.arr[0].p.coeff, max);
+  res &= PolyIsEq(&halved, &big) && PolyIsEq(&parsed, &doubled);
+
+  PolyDestroy(&pow);
+  PolyDestroy(&atOne);
+  PolyDestroy(&atMinusOne);
+  PolyDestroy(&twoPow);
+  PolyDestroy(&neg);
+  PolyDestroy(&diff);
+  PolyDestroy(&big);
+  PolyDestroy(&doubled);
+  PolyDestroy(&halved);
+  PolyDestroy(&parsed);
+  PolyBigRelease();
+  PolySetExact(false);
+
+  /* W trybie zwykłym współczynniki się zawijają. */
+  Poly quarter = P(C((poly_coeff_t) 1 << (POLY_COEFF_BITS - 2)), 1);
+  Poly four = C(4);
+  Poly wrapped = PolyMul(&quarter, &four);
+  res &= PolyIsZero(&wrapped);
+
+  PolyDestroy(&p);
+  PolyDestroy(&q);
+  PolyDestroy(&pp);
+  PolyDestroy(&pq);
+  PolyDestroy(&ppExact);
+  PolyDestroy(&pqExact);
+  PolyDestroy(&xPlusOne);
+  PolyDestroy(&rawMax);
+  PolyDestroy(&quarter);
+  return res;
+}
+
+static bool ParseCase(const char *str, Poly expected) {
+  char *copy = malloc(strlen(str) + 1);
+  CHECK_PTR(copy);
+  strcpy(copy, str);
+  size_t errOffset = SIZE_MAX;
+  Poly p = ParsePoly(copy, strlen(copy), &errOffset);
+  bool res = !PolyIsErr(&p) && PolyIsEq(&p, &expected);
+  res &= errOffset == SIZE_MAX && strcmp(copy, str) == 0;
+  if (!PolyIsErr(&p))
+    PolyDestroy(&p);
+  PolyDestroy(&expected);
+  free(copy);
+  return res;
+}
+
+static bool ParseErrCase(const char *str, size_t offset) {
+  size_t errOffset = SIZE_MAX;
+  Poly p = ParsePoly(str, strlen(str), &errOffset);
+  return PolyIsErr(&p) && errOffset == offset;
+}
+
+/* Zapis najmniejszego współczynnika i najmniejszej liczby większej od
+ * każdego współczynnika. */
+#if POLY_COEFF_BITS == 32
+#define COEFF_MIN_STR "-2147483648"
+#define COEFF_OVER_STR "2147483648"
+#elif POLY_COEFF_BITS == 64
+#define COEFF_MIN_STR "-9223372036854775808"
+#define COEFF_OVER_STR "9223372036854775808"
+#else
+#define COEFF_MIN_STR "-170141183460469231731687303715884105728"
+#define COEFF_OVER_STR "170141183460469231731687303715884105728"
+#endif
+
+static bool ParseTest(void) {
+  bool res = ParseCase("-5\n", C(-5)) && ParseCase("0", C(0));
+  res &= ParseCase("(1,2)+(2,3)\n", P(C(1), 2, C(2), 3));
+  res &= ParseCase("(2,3)+(1,2)+(0,4)+(3,3)", P(C(1), 2, C(5), 3));
+  res &= ParseCase("((1,2)+(1,3),4)+(2,0)",
+                   P(C(2), 0, P(C(1), 2, C(1), 3), 4));
+  res &= ParseCase("((7,0),0)", C(7)) && ParseCase("(1,1)+(-1,1)", C(0));
+  res &= ParseCase("(" COEFF_MIN_STR ",2147483647)",
+                   P(C(POLY_COEFF_MIN), INT_MAX));
+
+  /* Błąd jest zgłaszany na pierwszym znaku, który go przesądza. */
+  res &= ParseErrCase("", 0) && ParseErrCase("+1", 0);
+  res &= ParseErrCase("(1,2)+", 6) && ParseErrCase("(1,2)++(1,2)", 6);
+  res &= ParseErrCase("(1,)", 3) && ParseErrCase("(1,-0)", 3);
+  res &= ParseErrCase("(1,2147483648)", 3) && ParseErrCase("(1,2", 4);
+  res &= ParseErrCase(COEFF_OVER_STR, 0) && ParseErrCase("1,2", 1);
+  res &= ParseErrCase("(1,2)(1,3)", 5) && ParseErrCase("((1,2),(3),4)", 7);
+  res &= ParseErrCase("(1,2)\n\n", 5) && ParseErrCase("(1 ,2)", 2);
+
+  /* Zbyt głębokie zagnieżdżenie jest odrzucane bez rekurencji. */
+  size_t depth = POLY_MAX_DEPTH + 1;
+  char *deep = malloc(6 * depth + 1);
+  CHECK_PTR(deep);
+  size_t len = 0;
+  for (size_t i = 0; i < depth; ++i)
+    deep[len++] = '(';
+  deep[len++] = '1';
+  for (size_t i = 0; i < depth; ++i, len += 3)
+    memcpy(deep + len, ",1)", 3);
+  deep[len] = '\0';
+  res &= ParseErrCase(deep, POLY_MAX_DEPTH);
+  Poly ok = ParsePoly(deep + 1, len - 4, NULL);
+  res &= !PolyIsErr(&ok) && PolyDeg(&ok) == POLY_MAX_DEPTH;
+  PolyDestroy(&ok);
+  free(deep);
+  return res;
+}
+
+/* Parsuje napis podany kawałkami długości step, zaczynając od kawałka
+ * długości first, i porównuje wynik z wynikiem funkcji ParsePoly. */
+static bool StreamParseCase(const char *str, size_t first, size_t step) {
+  size_t len = strlen(str), expectedOffset = SIZE_MAX, errOffset = SIZE_MAX;
+  Poly expected = ParsePoly(str, len, &expectedOffset);
+
+  PolyParser parser = PolyParserInit();
+  for (size_t pos = 0, size = first; pos < len; pos += size, size = step) {
+    if (size > len - pos)
+      size = len - pos;
+    PolyParserFeed(&parser, str + pos, size);
+  }
+  Poly p;
+  bool ok = PolyParserFinish(&parser, &p, &errOffset);
+
+  bool res = ok != PolyIsErr(&expected) && errOffset == expectedOffset;
+  if (ok && !PolyIsErr(&expected))
+    res &= PolyIsEq(&p, &expected);
+  if (ok)
+    PolyDestroy(&p);
+  if (!PolyIsErr(&expected))
+    PolyDestroy(&expected);
+  return res;
+}
+
+static bool StreamParseTest(void) {
+  const char *cases[] = {
+    "-5", "0", "(1,2)+(2,3)", "((1,2)+(1,3),4)+(2,0)", "(1,1)+(-1,1)",
+    "(-9223372036854775808,2147483647)+(9223372036854775807,0)",
+    "((-12,345)+(6789,0),10)+((1,2),3)", "", "+1", "(1,2)+", "(1,)",
+    "(1,-0)", "(1,2147483648)", "(1,2", "9223372036854775808", "1,2",
+    "(1,2)(1,3)", "((1,2),(3),4)", "(1 ,2)", "-", "((1,2)+(3,4)"
+  };
+
+  bool res = true;
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+    size_t len = strlen(cases[i]);
+    for (size_t first = 1; first <= len; ++first)
+      res &= StreamParseCase(cases[i], first, len);
+    res &= StreamParseCase(cases[i], 1, 1) && StreamParseCase(cases[i], 2, 3);
+  }
+
+  /* Po błędzie kolejne kawałki są pomijane. */
+  PolyParser parser = PolyParserInit();
+  res &= !PolyParserFeed(&parser, "(1,x", 4);
+  res &= !PolyParserFeed(&parser, "2)", 2);
+  Poly p;
+  size_t errOffset = 0;
+  res &= !PolyParserFinish(&parser, &p, &errOffset) && errOffset == 3;
+  return res;
+}
+
+/* Porównuje wynik funkcji ParsePolyParallel z wynikiem ParsePoly. */
+static bool ParallelParseCase(const char *str, size_t size, size_t threads) {
+  size_t expectedOffset = SIZE_MAX, errOffset = SIZE_MAX;
+  Poly expected = ParsePoly(str, size, &expectedOffset);
+  Poly p = ParsePolyParallel(str, size, threads, &errOffset);
+  bool res = PolyIsErr(&p) == PolyIsErr(&expected);
+  res &= errOffset == expectedOffset;
+  if (!PolyIsErr(&p) && !PolyIsErr(&expected))
+    res &= PolyIsEq(&p, &expected);
+  if (!PolyIsErr(&p))
+    PolyDestroy(&p);
+  if (!PolyIsErr(&expected))
+    PolyDestroy(&expected);
+  return res;
+}
+
+static bool ParallelParseTest(void) {
+  /* Jednomiany zewnętrznej sumy powtarzają wykładniki, więc sumowanie
+   * łączy jednomiany sparsowane przez różne wątki. */
+  size_t capacity = (size_t) 3 << 20, len = 0;
+  char *str = malloc(capacity);
+  CHECK_PTR(str);
+  unsigned long seed = 48;
+  while (len < ((size_t) 5 << 19)) {
+    seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+    int a = (int) (seed >> 33) % 100 - 50, b = (int) (seed >> 45) % 9;
+    len += snprintf(str + len, capacity - len, "((%d,%d)+((1,2),%d),%d)+",
+                    a, b, b + 1, (int) (seed >> 53) % 300);
+  }
+  memcpy(str + len, "(-1,1)\n", 8);
+  len += 7;
+  str[len] = '\0';
+
+  bool res = ParallelParseCase(str, len, 4) && ParallelParseCase(str, len, 7);
+  res &= ParallelParseCase(str, len, 1) && ParallelParseCase(str, len - 1, 3);
+
+  /* Błędy w różnych fragmentach, także takie, których nie widać
+   * w żadnym fragmencie osobno. */
+  char saved = str[len / 2];
+  str[len / 2] = 'x';
+  res &= ParallelParseCase(str, len, 4);
+  str[len / 2] = saved;
+  res &= ParallelParseCase(str, len - 2, 4);
+  saved = str[len / 3];
+  str[len / 3] = '\xff';
+  res &= ParallelParseCase(str, len, 4);
+  str[len / 3] = '(';
+  res &= ParallelParseCase(str, len, 4);
+  str[len / 3] = saved;
+  str[0] = '5';
+  str[1] = '+';
+  res &= ParallelParseCase(str, len, 4);
+  str[0] = '(';
+  str[1] = '(';
+  for (size_t i = len / 3; i < len; i++) {
+    if (str[i] == '+' && str[i - 1] == ')' && str[i + 1] == '(' &&
+        str[i + 2] == '(') {
+      str[i + 1] = '7';
+      str[i + 2] = '+';
+      break;
+    }
+  }
+  res &= ParallelParseCase(str, len, 4);
+  free(str);
+
+  res &= ParallelParseCase("(1,2)+(3,4)", 11, 4);
+  res &= ParallelParseCase("(1,2)+", 6, 4) && ParallelParseCase("", 0, 4);
+  return res;
+}
+
+/* Zapisuje współczynnik funkcją FormatCoeff i sprawdza, że ParseCoeff
+ * odtwarza go z zapisu, a zapis jest taki sam jak zapis przez snprintf. */
+static bool FormatCase(poly_coeff_t c) {
+  char buffer[POLY_COEFF_CHARS + 1], expected[64];
+  size_t length = FormatCoeff(c, buffer);
+  buffer[length] = '\0';
+  char *endPtr = NULL;
+  errno = 0;
+  bool res = length <= POLY_COEFF_CHARS && ParseCoeff(buffer, &endPtr) == c;
+  res &= errno == 0 && endPtr == buffer + length;
+  if ((long long) c == c) {
+    snprintf(expected, sizeof(expected), "%lld", (long long) c);
+    res &= strcmp(buffer, expected) == 0;
+  }
+  return res;
+}
+
+static bool FormatTest(void) {
+  bool res = FormatCase(0) && FormatCase(-1) && FormatCase(9);
+  res &= FormatCase(10) && FormatCase(99) && FormatCase(-100);
+  res &= FormatCase(POLY_COEFF_MAX) && FormatCase(POLY_COEFF_MIN);
+  res &= FormatCase(POLY_COEFF_MAX / 10) && FormatCase(POLY_COEFF_MIN / 10);
+  for (poly_coeff_t c = 1; c < POLY_COEFF_MAX / 10; c *= 10)
+    res &= FormatCase(c) && FormatCase(c - 1) && FormatCase(-c - 1);
+  unsigned long seed = 50;
+  for (int i = 0; i < 1000; ++i) {
+    seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+    res &= FormatCase((poly_coeff_t) (seed >> (seed % 64)));
+  }
+
+  char buffer[POLY_EXP_CHARS + 1];
+  size_t length = FormatExp(INT_MAX, buffer);
+  buffer[length] = '\0';
+  res &= strcmp(buffer, "2147483647") == 0;
+  length = FormatExp(0, buffer);
+  res &= length == 1 && buffer[0] == '0';
+  length = FormatExp(INT_MIN, buffer);
+  buffer[length] = '\0';
+  res &= length == POLY_EXP_CHARS && strcmp(buffer, "-2147483648") == 0;
+  length = FormatExp(-2147483645, buffer);
+  buffer[length] = '\0';
+  res &= strcmp(buffer, "-2147483645") == 0;
+
+  /* Liczby dłuższe niż bezpieczna liczba cyfr są sprawdzane cyfra
+   * po cyfrze, także gdy zaczynają się od zer. */
+  char *endPtr = NULL;
+  errno = 0;
+  res &= ParseCoeff("-000000000000000000000000012,", &endPtr) == -12;
+  res &= errno == 0 && *endPtr == ',';
+  res &= ParseCoeff("123456789012345678901234567890123456789012", &endPtr) ==
+         POLY_COEFF_MAX && errno == ERANGE;
+  res &= ParseCase("(12345678,0000000003)+(-123456789,1234567890)",
+                   P(C(12345678), 3, C(-123456789), 1234567890));
+  return res;
+}
+
 /** GRUPY TESTÓW **/
 
 static bool SimpleNegGroup(void) {
@@ -4039,6 +5221,31 @@ static const test_list_t test_list[] = {
   TEST(MemoryThiefTest),
   TEST(MemoryFreeTest),
   TEST(MemoryGroup),
+  TEST(PowTest),
+  TEST(ComposeTest),
+  TEST(BuilderTest),
+  TEST(MulDenseTest),
+  TEST(MulStrategyTest),
+  TEST(MetaTest),
+  TEST(DeepChainTest),
+  TEST(AddCoeffTest),
+  TEST(CompactTest),
+  TEST(DeferredDestroyTest),
+  TEST(DeferredBoundTest),
+  TEST(ScratchTest),
+  TEST(LinCombTest),
+  TEST(FmaTest),
+  TEST(AddManyTest),
+  TEST(MulManyTest),
+  TEST(TruncTest),
+  TEST(ModularTest),
+  TEST(DenseModularTest),
+  TEST(WideCoeffTest),
+  TEST(ExactTest),
+  TEST(ParseTest),
+  TEST(StreamParseTest),
+  TEST(ParallelParseTest),
+  TEST(FormatTest),
 };
 
 int main(int argc, char *argv[]) {
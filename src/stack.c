@@ -34,6 +34,9 @@ Poly Pop(Stack *s) {
 }
 
 void Push(Stack *s, Poly *p) {
+    /* Wielomiany na stosie żyją długo, więc trzymamy je w jednym bloku.
+     * Pierwotny wielomian zwalniamy porcjami między poleceniami. */
+    PolyCompactDeferred(p);
     s->arr[s->top] = *p;
     (s->top)++;
     if (s->top == s->size)
@@ -63,7 +63,8 @@ void DestroyStack(Stack *s);
 Poly Pop(Stack *s);
 
 /**
- * Wkłada wielomian na wierzchołek stosu.
+ * Wkłada wielomian na wierzchołek stosu, przenosząc go przy tym
+ * do jednego ciągłego bloku pamięci (patrz PolyCompactDeferred).
  * @param[in] s : stos
  * @param[in] p : wielomian
  */